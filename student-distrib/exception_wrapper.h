@@ -8,4 +8,7 @@
 /* Declare external function wrapper for usage in wrapper and handler*/
 extern void exception_wrapper( uint32_t exception_id );
 
+/* Page fault linkage, passes CR2 and the error code to exception_handler_PF */
+extern void page_fault_linkage( void );
+
 #endif
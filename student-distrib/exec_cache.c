@@ -0,0 +1,234 @@
+/* exec_cache.c - Pages of executables shared by every process running them
+ * vim:ts=4 noexpandtab
+ */
+
+#include "exec_cache.h"
+#include "lib.h"
+#include "frame.h"
+#include "paging.h"
+#include "file_system.h"
+
+#define EXEC_CACHE_NONE         0xFFFF  /* End of a chain or of the free list   */
+#define EXEC_CACHE_HASH_MULT    31
+
+/* A page of a program held by the cache. The file system is read    */
+/* only, so a cached page never goes stale. The cache holds its own   */
+/* reference to the frame, and every process mapping it holds one     */
+/* more, so a frame with one reference is only kept for next time.   */
+typedef struct exec_page_t {
+    uint32_t inode;
+    uint32_t index;                     /* Page number within the file          */
+    uint32_t frame;                     /* 0 while the entry is unused          */
+    uint16_t next;                      /* Next entry in the bucket or free list */
+} exec_page_t;
+
+static exec_page_t exec_pages[ EXEC_CACHE_PAGES ];
+static uint16_t exec_cache_buckets[ EXEC_CACHE_BUCKETS ];
+static uint16_t exec_cache_free = EXEC_CACHE_NONE;
+static int32_t exec_cache_ready = 0;
+
+/* Where the search for a page to evict picks up from */
+static uint32_t exec_cache_hand = 0;
+
+static exec_cache_stats_t exec_cache_stats;
+
+/* static uint32_t exec_cache_hash(uint32_t inode, uint32_t index);
+ *   Inputs: inode, index - which page of which file
+ *   Return Value: its bucket */
+static inline uint32_t exec_cache_hash( uint32_t inode, uint32_t index )
+{
+    return ( inode * EXEC_CACHE_HASH_MULT + index ) & ( EXEC_CACHE_BUCKETS - 1 );
+}
+
+/* static void exec_cache_init();
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: Empties the buckets and puts every entry on the free
+ *             list. Done on first use, so nothing has to call it. */
+static void exec_cache_init( void )
+{
+    uint32_t i;
+
+    for( i = 0; i < EXEC_CACHE_BUCKETS; i++ )
+    {
+        exec_cache_buckets[ i ] = EXEC_CACHE_NONE;
+    }
+    for( i = 0; i < EXEC_CACHE_PAGES; i++ )
+    {
+        exec_pages[ i ].frame = 0;
+        exec_pages[ i ].next = ( i + 1 < EXEC_CACHE_PAGES ) ? i + 1 : EXEC_CACHE_NONE;
+    }
+    exec_cache_free = 0;
+    exec_cache_ready = 1;
+}
+
+/* static void exec_cache_remove(uint32_t entry);
+ *   Inputs: entry - entry holding a page
+ *   Return Value: none
+ *   Function: Takes the page out of its bucket, drops the cache's
+ *             reference to the frame and frees the entry. Interrupts
+ *             must be off. */
+static void exec_cache_remove( uint32_t entry )
+{
+    exec_page_t* page = &exec_pages[ entry ];
+    uint16_t* link = &exec_cache_buckets[ exec_cache_hash( page->inode, page->index ) ];
+
+    while( *link != entry )
+    {
+        link = &exec_pages[ *link ].next;
+    }
+    *link = page->next;
+
+    frame_put( page->frame );
+    page->frame = 0;
+    page->next = exec_cache_free;
+    exec_cache_free = entry;
+    exec_cache_stats.pages--;
+}
+
+/* static int32_t exec_cache_entry();
+ *   Inputs: none
+ *   Return Value: a free entry, -1 if every page is mapped somewhere
+ *   Function: Takes an entry off the free list, or else drops the next
+ *             page in turn that no process has mapped. Interrupts must
+ *             be off. */
+static int32_t exec_cache_entry( void )
+{
+    uint32_t entry;
+    uint32_t i;
+
+    if( exec_cache_free == EXEC_CACHE_NONE )
+    {
+        for( i = 0; i < EXEC_CACHE_PAGES; i++ )
+        {
+            entry = exec_cache_hand;
+            exec_cache_hand = ( exec_cache_hand + 1 ) % EXEC_CACHE_PAGES;
+            if( exec_pages[ entry ].frame && frame_refcount( exec_pages[ entry ].frame ) == 1 )
+            {
+                exec_cache_remove( entry );
+                exec_cache_stats.evictions++;
+                break;
+            }
+        }
+        if( exec_cache_free == EXEC_CACHE_NONE )
+        {
+            return -1;
+        }
+    }
+
+    entry = exec_cache_free;
+    exec_cache_free = exec_pages[ entry ].next;
+    return entry;
+}
+
+/* uint32_t exec_cache_get(uint32_t inode, uint32_t index);
+ *   Inputs: inode - the executable
+ *           index - which 4kB page of it
+ *   Return Value: the frame holding the page, 0 if out of memory
+ *   Function: Looks the page up, reading it from the file system into
+ *             a new frame if it isn't cached. The part of the last page
+ *             past the end of the file is zeroed. The caller gets a
+ *             reference to the frame. If the cache is full of pages in
+ *             use, the page is still read but isn't cached. */
+uint32_t exec_cache_get( uint32_t inode, uint32_t index )
+{
+    exec_page_t* page;
+    uint32_t flags;
+    uint32_t frame;
+    uint32_t entry;
+    int32_t slot;
+    int32_t bytes_read;
+    uint8_t* data;
+
+    cli_and_save( flags );
+    if( !exec_cache_ready )
+    {
+        exec_cache_init( );
+    }
+
+    for( entry = exec_cache_buckets[ exec_cache_hash( inode, index ) ];
+         entry != EXEC_CACHE_NONE; entry = exec_pages[ entry ].next )
+    {
+        page = &exec_pages[ entry ];
+        if( page->inode == inode && page->index == index )
+        {
+            frame_get( page->frame );
+            exec_cache_stats.hits++;
+            restore_flags( flags );
+            return page->frame;
+        }
+    }
+    exec_cache_stats.misses++;
+
+    frame = frame_alloc( 0 );
+    if( frame == 0 && exec_cache_reclaim( ) )
+    {
+        frame = frame_alloc( 0 );
+    }
+    if( frame == 0 )
+    {
+        restore_flags( flags );
+        return 0;
+    }
+
+    data = kmap_window( frame );
+    bytes_read = read_data( inode, index * FRAME_SIZE, data, FRAME_SIZE );
+    if( bytes_read < 0 )
+    {
+        bytes_read = 0;
+    }
+    memset( data + bytes_read, 0, FRAME_SIZE - bytes_read );
+    kunmap_window( );
+
+    slot = exec_cache_entry( );
+    if( slot >= 0 )
+    {
+        page = &exec_pages[ slot ];
+        page->inode = inode;
+        page->index = index;
+        page->frame = frame;
+        page->next = exec_cache_buckets[ exec_cache_hash( inode, index ) ];
+        exec_cache_buckets[ exec_cache_hash( inode, index ) ] = slot;
+        frame_get( frame );
+        exec_cache_stats.pages++;
+    }
+    restore_flags( flags );
+    return frame;
+}
+
+/* uint32_t exec_cache_reclaim();
+ *   Inputs: none
+ *   Return Value: number of frames freed
+ *   Function: Gives back every cached page that no process is running,
+ *             for when the frame allocator has run dry */
+uint32_t exec_cache_reclaim( void )
+{
+    uint32_t flags;
+    uint32_t freed = 0;
+    uint32_t entry;
+
+    cli_and_save( flags );
+    for( entry = 0; entry < EXEC_CACHE_PAGES; entry++ )
+    {
+        if( exec_pages[ entry ].frame && frame_refcount( exec_pages[ entry ].frame ) == 1 )
+        {
+            exec_cache_remove( entry );
+            exec_cache_stats.evictions++;
+            freed++;
+        }
+    }
+    restore_flags( flags );
+    return freed;
+}
+
+/* void exec_cache_get_stats(exec_cache_stats_t* stats);
+ *   Inputs: stats - where to copy the counters
+ *   Return Value: none */
+void exec_cache_get_stats( exec_cache_stats_t* stats )
+{
+    uint32_t flags;
+
+    cli_and_save( flags );
+    *stats = exec_cache_stats;
+    restore_flags( flags );
+}
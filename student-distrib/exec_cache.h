@@ -0,0 +1,33 @@
+/* exec_cache.h - Pages of executables shared by every process running them
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _EXEC_CACHE_H
+#define _EXEC_CACHE_H
+
+#include "types.h"
+
+#define EXEC_CACHE_PAGES        512     /* Most program pages kept at once     */
+#define EXEC_CACHE_BUCKETS      128     /* Hash buckets. Must be a power of 2. */
+
+/* Counters for watching the cache */
+typedef struct exec_cache_stats_t {
+    uint32_t pages;                     /* Pages held right now                 */
+    uint32_t hits;                      /* Lookups that found the page          */
+    uint32_t misses;                    /* Lookups that read it from the file   */
+    uint32_t evictions;                 /* Pages dropped to make room           */
+} exec_cache_stats_t;
+
+/* The frame holding page `index` of an executable, read in from the   */
+/* file system the first time it is asked for. The caller gets its own */
+/* reference to the frame and has to map it read-only, since other     */
+/* processes may share it. 0 if there is no memory for it.             */
+extern uint32_t exec_cache_get( uint32_t inode, uint32_t index );
+
+/* Frees every cached page no process has mapped. Returns how many.    */
+extern uint32_t exec_cache_reclaim( void );
+
+/* Copies the cache's counters */
+extern void exec_cache_get_stats( exec_cache_stats_t* stats );
+
+#endif /* _EXEC_CACHE_H */
@@ -12,6 +12,20 @@
 /* Initialize global array of file descriptors */
 open_file_t file_array[FILE_ARRAY_SIZE];
 
+/* Directory hash index, filled in by dentry_index_init. Each slot holds  */
+/* a dentry index + 1 so that 0 can mark an empty slot. The length and    */
+/* hash of every name are cached so lookups don't need to recompute them. */
+static uint8_t  dentry_hash_table[DENTRY_HASH_SIZE];
+static uint32_t dentry_name_len[DIR_ENTRIES_SIZE];
+static uint32_t dentry_name_hashes[DIR_ENTRIES_SIZE];
+
+/* Bit (n - 1) is set if some file name has length n. Lets us reject most */
+/* misses without hashing anything.                                       */
+static uint32_t dentry_length_mask;
+
+/* Lookup counters */
+fs_lookup_stats_t fs_lookup_stats;
+
 /* void fileArray_init();
  *   Inputs: None
  *   Return Value: None
@@ -49,112 +63,162 @@ void fileSystem_init(uint32_t* fs_start) {
     num_inodes = p_boot_block_addr->num_inodes;
     p_inode_addr = (inode_t*) p_boot_block_addr + 1;
     p_data_block_addr = (data_block_t*) p_inode_addr + num_inodes;
+    dentry_index_init();
     fileArray_init();
     return;
 }
 
+/* uint32_t dentry_name_length(const uint8_t* name);
+ *   Inputs: const uint8_t* name --> A file name, not necessarily NULL-terminated
+ *   Return Value: The length of the name, capped at MAX_FILE_NAME_LENGTH
+ *   Function: Bounded strlen. Names stored in the boot block fill all 32 bytes
+ *             without a terminator, so we never read past MAX_FILE_NAME_LENGTH */
+static uint32_t dentry_name_length(const uint8_t* name) {
+    uint32_t length = 0;
+    while (length < MAX_FILE_NAME_LENGTH && name[length] != '\0') {
+        length++;
+    }
+    return length;
+}
+
+/* uint32_t dentry_name_hash(const uint8_t* name, uint32_t length);
+ *   Inputs: const uint8_t* name --> The file name to hash
+ *           uint32_t length --> The number of characters of the name to hash
+ *   Return Value: 32-bit FNV-1a hash of the name
+ *   Function: Hashes a file name for the directory hash index */
+static uint32_t dentry_name_hash(const uint8_t* name, uint32_t length) {
+    uint32_t hash = FNV_OFFSET_BASIS;
+    uint32_t i;
+    for (i = 0; i < length; i++) {
+        hash ^= name[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/* void dentry_index_init(void);
+ *   Inputs: None
+ *   Return Value: None
+ *   Function: Builds the open-addressed hash index that maps file names to their
+ *             dentry index. The file system is read-only, so this only runs once
+ *             at mount and read_dentry_by_name never has to walk the boot block. */
+void dentry_index_init(void) {
+    unsigned int num_dentries = p_boot_block_addr->num_dir_entries;
+    dentry_t* directories = p_boot_block_addr->dir_entries;
+    uint32_t i, slot, length, hash, other;
+
+    if (num_dentries > DIR_ENTRIES_SIZE) {
+        num_dentries = DIR_ENTRIES_SIZE;
+    }
+
+    memset(dentry_hash_table, DENTRY_HASH_EMPTY, sizeof(dentry_hash_table));
+    dentry_length_mask = 0;
+
+    for (i = 0; i < num_dentries; i++) {
+        length = dentry_name_length((uint8_t*) directories[i].file_name);
+        hash = dentry_name_hash((uint8_t*) directories[i].file_name, length);
+        dentry_name_len[i] = length;
+        dentry_name_hashes[i] = hash;
+
+        /* Empty names can never be looked up, so leave them out */
+        if (length == 0) {
+            continue;
+        }
+
+        /* Linear probing. If an earlier entry already has the same name we keep */
+        /* that one, which matches the old front-to-back linear search.          */
+        slot = hash & DENTRY_HASH_MASK;
+        while (dentry_hash_table[slot] != DENTRY_HASH_EMPTY) {
+            other = dentry_hash_table[slot] - 1;
+            if (dentry_name_hashes[other] == hash && dentry_name_len[other] == length &&
+                strncmp(directories[other].file_name, directories[i].file_name, length) == 0) {
+                break;
+            }
+            slot = (slot + 1) & DENTRY_HASH_MASK;
+        }
+        if (dentry_hash_table[slot] == DENTRY_HASH_EMPTY) {
+            dentry_hash_table[slot] = i + 1;
+            dentry_length_mask |= 1 << (length - 1);
+        }
+    }
+}
+
 /* int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry);
  *   Inputs: const uint8_t* fname --> A pointer to the file name to search for
  *           dentry_t* dentry --> A pointer to the directory entry to pass back
  *   Return Value: 0 --> Success
  *                -1 --> Failure
- *   Function: Searches all directory entries via a given file name and passes back the
- *             corresponding directory entry if found */
+ *   Function: Looks the file name up in the directory hash index built at mount and
+ *             passes back the corresponding directory entry if found */
 int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry) 
 {
+    dentry_t* directories;
+    uint64_t start_cycles;
+    uint32_t length, hash, slot, index, cycles;
+    int32_t result = -1;
+
     /* Check if passed in pointer to the file name is empty. */
-    if( fname == NULL )
+    if( fname == NULL || dentry == NULL )
     {
         return -1;
     }
 
-    /* Get the length of the passed in file name. Truncate to   */
-    /* maximum file length if needed.                           */
-    unsigned int file_name_length = strlen( (int8_t*)fname );
-    if( file_name_length > MAX_FILE_NAME_LENGTH )
+    start_cycles = rdtsc( );
+    fs_lookup_stats.lookups++;
+
+    /* Get the length of the passed in file name, truncated to  */
+    /* the maximum file length. Remove a trailing '\n' so that  */
+    /* names typed into the shell still match.                  */
+    length = dentry_name_length( fname );
+    if( length > 0 && fname[ length - 1 ] == '\n' )
     {
-        file_name_length = MAX_FILE_NAME_LENGTH;
+        length--;
     }
 
-    /* Remove the '\n' from the file name if included in the    */
-    /* string passed in, to prevent confusion in matching.      */
-    if( fname[ file_name_length - 1 ] == '\n' )
+    /* Negative lookup fast path: if no file in the directory   */
+    /* has a name of this length, don't bother hashing it.      */
+    if( length == 0 || !( dentry_length_mask & ( 1 << ( length - 1 ) ) ) )
     {
-        file_name_length = file_name_length - 1;
+        fs_lookup_stats.fast_misses++;
+        goto done;
     }
 
-    /* Get the total number of directory entries (dentries) to  */
-    /* search through, and the actual array of dentries to      */
-    /* search through. We will loop through the array and check */
-    /* if any matches arise.                                    */
-    unsigned int num_dentries = p_boot_block_addr->num_dir_entries;
-    dentry_t* directories = p_boot_block_addr->dir_entries;
-
-    /* Loop through all of the directory entries and search for */
-    /* the passed in file name. We will check if the file name  */
-    /* sizes match up first - by doing this, we can prevent     */
-    /* substrings from coming up with matches. Aftewards, we    */
-    /* will use strcmp to compare the filenames and decide      */
-    /* matching filenames.                                      */
-    dentry_t curr_directory;
-    char* curr_file_name;
-    unsigned int i;
-    unsigned int curr_file_name_length;
-    int result;
-    for( i = 0; i < num_dentries; i++ )
+    /* Probe the index. Only compare the strings once both the  */
+    /* full hash and the length match, so a hit costs a single  */
+    /* strncmp and a miss usually costs none.                   */
+    directories = p_boot_block_addr->dir_entries;
+    hash = dentry_name_hash( fname, length );
+    slot = hash & DENTRY_HASH_MASK;
+    while( dentry_hash_table[ slot ] != DENTRY_HASH_EMPTY )
     {
-        /* Get the current dentry we are looking at stored in the   */
-        /* directories array. Also get the corresponding filename   */
-        /* for comparison.                                          */
-        curr_directory = directories[ i ];
-        curr_file_name = curr_directory.file_name;
-
-        /* Also limit the curr_file_name_length if needed. If not   */
-        /* limited/truncated, then the string may become too long   */
-        /* and bugs may occur.                                      */
-        curr_file_name_length = strlen( (int8_t*)curr_file_name );
-        if( curr_file_name_length > MAX_FILE_NAME_LENGTH )
-        {
-            curr_file_name_length  = MAX_FILE_NAME_LENGTH;
-        }
-
-        /* Compare the lengths of the filenames. If they are not of */
-        /* the same length, then they cannot be the same string.    */
-        /* Keep looping if they are not of the same length.         */
-        if( file_name_length != curr_file_name_length )
+        fs_lookup_stats.probes++;
+        index = dentry_hash_table[ slot ] - 1;
+        if( dentry_name_hashes[ index ] == hash && dentry_name_len[ index ] == length &&
+            strncmp( (int8_t*)fname, directories[ index ].file_name, length ) == 0 )
         {
-            continue;
-        }
-
-        /* We have possibly found a matching string, but need to    */
-        /* actually compare the contents of the two strings to      */
-        /* determine if they are the same.                          */
-        if( strncmp( (int8_t*)fname, (int8_t*)curr_file_name, file_name_length ) == 0 )
-        {
-            /* We have determined the file name and the directory   */
-            /* file name are the same. Read the dentry into our     */
-            /* passed in argument dentry using read_dentry_by_index */
-            /* and check if the read failed or not. Return the      */
-            /* corresponding completion status.                     */
-            result = read_dentry_by_index( i, dentry );
-            if( result == -1 )
-            {
-                /* Return FAILURE. */
-                return -1;
-            }
-            else
-            {
-                /* Return SUCCESS. */
-                return 0;
-            }
+            result = read_dentry_by_index( index, dentry );
+            break;
         }
-
+        slot = ( slot + 1 ) & DENTRY_HASH_MASK;
     }
 
-    /* After loooping through the entire directory, we did not find */
-    /* a corresponding directory entry for the filename passed in.  */
-    /* Return FAILURE.                                              */
-    return -1;
+done:
+    if( result == 0 )
+    {
+        fs_lookup_stats.hits++;
+    }
+    else
+    {
+        fs_lookup_stats.misses++;
+    }
+    cycles = (uint32_t)( rdtsc( ) - start_cycles );
+    fs_lookup_stats.last_cycles = cycles;
+    fs_lookup_stats.total_cycles += cycles;
+    if( cycles > fs_lookup_stats.max_cycles )
+    {
+        fs_lookup_stats.max_cycles = cycles;
+    }
+    return result;
 }
 
 /* int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry);
@@ -165,31 +229,16 @@ int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry)
  *   Function: Copies the data of a given directory based on the corresponding passed in directory index */
 int32_t read_dentry_by_index(uint32_t index, dentry_t* dentry) {
 
-    /* Gets the total number of inodes */
-    unsigned int num_inodes = p_boot_block_addr->num_inodes;
-
-    /* Gets the actual array of directories */
-    dentry_t* directories = p_boot_block_addr->dir_entries;
-
-    /* Declare other local variables */
-    dentry_t curr_directory;
-    unsigned int i;    
+    /* Gets the total number of directory entries */
+    unsigned int num_dentries = p_boot_block_addr->num_dir_entries;
 
-    /* Checks if the passed in index is out of boundsn*/
-    if (index < 0 || index >= num_inodes) {
+    /* Checks if the passed in index is out of bounds */
+    if (index >= num_dentries || index >= DIR_ENTRIES_SIZE || dentry == NULL) {
         return -1;
     }
 
-    /* Gets the current directory based on the passed in index */
-    curr_directory = directories[index];
-
-    /* Copies over all fields of the dentry_t struct */
-    strcpy((int8_t*) dentry->file_name, (int8_t*) curr_directory.file_name);
-    dentry->file_type = curr_directory.file_type;
-    dentry->index_node_num = curr_directory.index_node_num;
-    for (i = 0; i < RESERVED_D_SIZE; i++) {
-        dentry->reserved[i] = curr_directory.reserved[i];
-    }
+    /* Copies the whole entry straight out of the boot block */
+    memcpy(dentry, &p_boot_block_addr->dir_entries[index], sizeof(dentry_t));
     
     /* Returns 0 if everything is successful */
     return 0;
@@ -206,86 +255,77 @@ int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length
     /* Gets the address of the inode to read from */
     inode_t* curr_inode = p_inode_addr + inode;
 
-    /* Gets the file size of the corresponding inode to read from */
-    unsigned int file_size = curr_inode->file_size;
-
-    /* Gets an array of the data blocks for the corresponding inode to read from */
-    unsigned int* data_blocks = curr_inode->data_blocks;
-
-    /* Gets the total number of inodes */
+    /* Gets the total number of inodes and data blocks */
     unsigned int num_inodes = p_boot_block_addr->num_inodes;
-    
+    unsigned int num_data_blocks = p_boot_block_addr->num_data_blocks;
+
     /* Declare other local variables */
+    unsigned int file_size;
+    unsigned int* data_blocks;
+    unsigned int curr_data_block_num;
+    unsigned int curr_byte_index;
+    unsigned int first_data_block_index;
+    unsigned int span_blocks;
+    unsigned int span_bytes;
     unsigned int num_bytes_read_total = 0;
-    unsigned int curr_data_block_num = 0;
-    unsigned int curr_byte_index = 0;
-    unsigned int curr_data_block_index;
-    data_block_t* curr_data_block;
-    unsigned int i;
 
     /* Checks if the given inode index number is out of bounds */
-    if (inode < 0 || inode >= num_inodes) {
+    if (inode >= num_inodes || buf == NULL) {
         return 0;
     }
 
-    /* Checks if the given offset value is out of bounds */
-    if (offset < 0 || offset >= file_size ) {
-        return 0;
-    }
+    /* Gets the file size and data block list of the inode to read from */
+    file_size = curr_inode->file_size;
+    data_blocks = curr_inode->data_blocks;
 
-    /* Edge case: whenever the offset is really big it  */
-    /* breaks for some weird reason (specifically in    */
-    /* the very large text file) so we'll just treat    */
-    /* that as an edge case and add the offset.         */
-    if( offset > 4096 && ( offset + FILE_SYS_OFFSET ) >= file_size )
-    {
+    /* Checks if the given offset value is out of bounds */
+    if (offset >= file_size) {
         return 0;
     }
 
-    /* If the number of bytes to read is greater than the file size, */
-    /* set the number of bytes to read to just be equal to the file size */
-    if (length > file_size) {
-        length = file_size;
-    }
-
-    /* If the offset + number of bytes to read is greater than the file size, */
-    /* set the number of bytes to read to be the difference between the file size and offset value */
-    if (offset + length > file_size) {
+    /* Clamp the number of bytes to read to what is left in the file */
+    if (length > file_size - offset) {
         length = file_size - offset;
-    }  
-
-    /* Set the current byte to start reading from to be equal to the offset value */
-    curr_byte_index = offset;
-
-    /* If the current byte to read from is greater than the size of a data block, reset it back to 0 */
-    /* Do this both before AND after reading the data in case our offset passed in is too large.     */
-    if (curr_byte_index >= SIZE_DATA_BLOCK) {
-        curr_byte_index = 0;
-
-        /* Update the current data block we are reading from */
-        curr_data_block_num++;
     }
 
-    /* Loop through all bytes to read and copy them to the passed in buffer */
-    for (i = 0; i < length; i++) {        
-        /* Gets the corresponding data block to read from */
-        curr_data_block_index = data_blocks[curr_data_block_num];
-        curr_data_block = (data_block_t*) p_data_block_addr + curr_data_block_index;
+    /* Work out which data block the offset lands in and where in */
+    /* that block to start, so a seek costs the same at any offset */
+    curr_data_block_num = offset / SIZE_DATA_BLOCK;
+    curr_byte_index = offset % SIZE_DATA_BLOCK;
+
+    while (num_bytes_read_total < length) {
+        first_data_block_index = data_blocks[curr_data_block_num];
 
-        /* Copies over a byte of data from the corresponding data block to the buffer */
-        buf[i] = curr_data_block->data[curr_byte_index];
-        curr_byte_index++;
+        /* Stop on a corrupt inode instead of reading past the image */
+        if (first_data_block_index >= num_data_blocks) {
+            break;
+        }
 
-        /* If the current byte to read from is greater than the size of a data block, reset it back to 0 */
-        if (curr_byte_index >= SIZE_DATA_BLOCK) {
-            curr_byte_index = 0;
+        /* Files are usually laid out in consecutive data blocks, so */
+        /* grow the span for as long as the next block follows on    */
+        span_blocks = 1;
+        span_bytes = SIZE_DATA_BLOCK - curr_byte_index;
+        while (span_bytes < length - num_bytes_read_total &&
+               data_blocks[curr_data_block_num + span_blocks] == first_data_block_index + span_blocks &&
+               first_data_block_index + span_blocks < num_data_blocks) {
+            span_blocks++;
+            span_bytes += SIZE_DATA_BLOCK;
+        }
 
-            /* Update the current data block we are reading from */
-            curr_data_block_num++;
+        /* The last span may end partway through a block */
+        if (span_bytes > length - num_bytes_read_total) {
+            span_bytes = length - num_bytes_read_total;
         }
 
-        /* Update the total number of bytes read */
-        num_bytes_read_total++;
+        /* Copies the whole span over to the buffer in one go */
+        memcpy(buf + num_bytes_read_total,
+               ((data_block_t*) p_data_block_addr + first_data_block_index)->data + curr_byte_index,
+               span_bytes);
+
+        /* Every span after the first starts at the top of a block */
+        num_bytes_read_total += span_bytes;
+        curr_data_block_num += span_blocks;
+        curr_byte_index = 0;
     }
 
     return num_bytes_read_total;
@@ -298,35 +338,26 @@ int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length
  *   Return Value: The amount of bytes read
  *   Function: Reads the data of a given open file and writes it to a passed in buffer pointer */
 int32_t file_read(int32_t fd, void* buf, int32_t nbytes) {
-    /* Checks if fd is out of bounds */
-    if (fd < 0 || fd > 7) {
-        return 0;
-    }
+    /* Gets the open file corresponding to the passed in file descriptor to read from */
+    open_file_t* curr_file = get_open_file(fd);
 
     /* Declare local variables */
     unsigned int num_bytes_read;
-    unsigned int curr_file_position;
-    unsigned int curr_inode_index;
+
+    /* Checks if fd is out of bounds */
+    if (curr_file == NULL) {
+        return 0;
+    }
 
     /* Initialize the contents of our buffer up to nbytes to '\0' so that   */
     /* we don't have to worry about the buffer ending at the wrong place.   */
     memset( buf, '\0', nbytes );    
 
-    /* Gets the open file corresponding to the passed in file descriptor to read from */
-    open_file_t curr_file = file_array[fd];  
-
-    /* Gets the inode of the corresponding current open file */
-    curr_inode_index = curr_file.index_node_num;
-
-    /* Gets the file position offset of current open file */
-    curr_file_position = curr_file.file_position;
-
-    /* Reads nbytes of data from the current open file and copies it into the passed in buffer */
-    num_bytes_read = read_data(curr_inode_index, curr_file_position, buf, nbytes);
+    /* Reads nbytes of data from the current open file's position and copies it into the passed in buffer */
+    num_bytes_read = read_data(curr_file->index_node_num, curr_file->file_position, buf, nbytes);
 
     /* Increments and updates the current file position for the open file */
-    curr_file_position += num_bytes_read;
-    file_array[fd].file_position = curr_file_position;
+    curr_file->file_position += num_bytes_read;
 
     return num_bytes_read;
 }
@@ -381,7 +412,7 @@ int32_t file_open(const uint8_t* filename) {
 int32_t file_close(int32_t fd) {
     if (fd < 2 || fd > FILE_ARRAY_SIZE - 1) return -1;  /*User cannot close the default descriptors 0 or 1*/
 
-    file_array[fd].flags = 0;
+    get_open_file(fd)->flags = 0;
     return 0;
 }
 
@@ -392,16 +423,16 @@ int32_t file_close(int32_t fd) {
  *   Return Value: The amount of bytes read
  *   Function: Reads the file name of a given directory and writes it to a passed in buffer pointer */
 int32_t dir_read(int32_t fd, void* buf, int32_t nbytes) {
+    /* Gets the open directory corresponding to the passed in file descriptor to read from */
+    open_file_t* curr_file = get_open_file(fd);
+
     /* Checks if fd is out of bounds */
-    if (fd < 0 || fd > 7) {
+    if (curr_file == NULL) {
         return 0;
     }
 
-    /* Gets the open directory corresponding to the passed in file descriptor to read from */
-    open_file_t curr_file = file_array[fd];
-
     /* Gets the file position to determine which directory entry to read from */
-    unsigned int curr_position = curr_file.file_position;
+    unsigned int curr_position = curr_file->file_position;
 
     /* Declare other local variables */
     dentry_t curr_dentry;
@@ -424,7 +455,7 @@ int32_t dir_read(int32_t fd, void* buf, int32_t nbytes) {
 
     /* Increments and updates the file position */
     curr_position += 1;
-    file_array[fd].file_position = curr_position;
+    curr_file->file_position = curr_position;
 
     /* Gets the current directory's file name and length */
     file_name = curr_dentry.file_name;
@@ -516,7 +547,7 @@ int32_t dir_open(const uint8_t* filename) {
 int32_t dir_close(int32_t fd) {
     if (fd < 2 || fd > FILE_ARRAY_SIZE - 1) return -1;  /*User cannot close the default descriptors 0 or 1*/
 
-    file_array[fd].flags = 0;
+    get_open_file(fd)->flags = 0;
     return 0;
 }
 
@@ -17,10 +17,15 @@
 #define DIRECTORY_TYPE       1
 #define REG_FILE_TYPE        2
 #define TERMINAL_FILE_TYPE   3
+#define DEVICE_FILE_TYPE     4       /* Opened by name through get_device_table  */
 #define INIT_FILE_POSITION   0
 #define FD_FREE              0
 #define FD_IN_USE            1
-#define FILE_SYS_OFFSET     157
+#define DENTRY_HASH_SIZE     128     /* Power of two, about twice DIR_ENTRIES_SIZE   */
+#define DENTRY_HASH_MASK     ( DENTRY_HASH_SIZE - 1 )
+#define DENTRY_HASH_EMPTY    0       /* Slots hold dentry index + 1, 0 means empty   */
+#define FNV_OFFSET_BASIS     0x811C9DC5
+#define FNV_PRIME            0x01000193
 
 /* Struct Definitions */
 typedef struct dentry_t {
@@ -52,8 +57,23 @@ typedef struct open_file_t {
     unsigned int index_node_num;
     unsigned int file_position;
     unsigned int flags;
+    unsigned int rtc_divider;       /* RTC only: 1024ths of a second per tick, 0 for the 2 Hz default */
+    unsigned int rtc_next_tick;     /* RTC only: virtual time of the tick rtc_read is waiting for     */
 } open_file_t;
 
+/* Counters for read_dentry_by_name so that we can see how much time */
+/* shells spend looking up names on every open and execute.          */
+typedef struct fs_lookup_stats_t {
+    uint32_t lookups;           /* Total calls to read_dentry_by_name               */
+    uint32_t hits;              /* Lookups that found a directory entry             */
+    uint32_t misses;            /* Lookups that found nothing                       */
+    uint32_t fast_misses;       /* Misses rejected by the name length filter        */
+    uint32_t probes;            /* Hash slots inspected across all lookups          */
+    uint32_t last_cycles;       /* TSC cycles taken by the most recent lookup       */
+    uint32_t max_cycles;        /* Slowest lookup seen so far                       */
+    uint64_t total_cycles;      /* Sum of all lookup times, for averaging           */
+} fs_lookup_stats_t;
+
 /* Declares global pointers to boot_block, inode, and data_block*/
 boot_block_t* p_boot_block_addr;
 inode_t* p_inode_addr;
@@ -63,10 +83,20 @@ data_block_t* p_data_block_addr;
 /* with each individual process's file array.               */
 extern open_file_t file_array[FILE_ARRAY_SIZE];
 
+/* Gets the open file for a descriptor, from the running process's PCB */
+/* or from file_array if no process is running yet (syscall.c)         */
+extern open_file_t* get_open_file(int32_t fd);
+
+/* Lookup counters, updated by read_dentry_by_name */
+extern fs_lookup_stats_t fs_lookup_stats;
+
 /* Function Declarations */
 /* Initializes the file system and the corresponding global pointers */
 extern void fileSystem_init(uint32_t* fs_start);
 
+/* Builds the name to dentry hash index, called once from fileSystem_init */
+extern void dentry_index_init(void);
+
 /* Searches for a directory based on a passed in file name */
 extern int32_t read_dentry_by_name(const uint8_t* fname, dentry_t* dentry);
 
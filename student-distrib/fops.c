@@ -2,78 +2,93 @@
 #include "file_system.h"
 #include "rtc.h"
 #include "terminal.h"
+#include "serial.h"
+#include "klog.h"
+#include "frame.h"
+#include "lib.h"
 
-/* Global table with address to return in the get_[specific]_table functions. */
-fops_table_t table;
+/* One constant table per file type. An open file keeps a pointer to */
+/* its table from open until close, so the tables are never changed. */
+static fops_table_t rtc_table      = { rtc_open,      rtc_read,      rtc_write,      rtc_close,      NULL           };
+static fops_table_t dir_table      = { dir_open,      dir_read,      dir_write,      dir_close,      NULL           };
+static fops_table_t file_table     = { file_open,     file_read,     file_write,     file_close,     NULL           };
+static fops_table_t terminal_table = { terminal_open, terminal_read, terminal_write, terminal_close, terminal_ioctl };
+static fops_table_t stdin_table    = { terminal_open, terminal_read, NULL,           terminal_close, terminal_ioctl };
+static fops_table_t stdout_table   = { terminal_open, NULL,          terminal_write, terminal_close, terminal_ioctl };
+static fops_table_t serial_table   = { serial_open,   serial_read,   serial_write,   serial_close,   NULL           };
+static fops_table_t dmesg_table    = { dmesg_open,    dmesg_read,    dmesg_write,    dmesg_close,    NULL           };
+static fops_table_t meminfo_table  = { meminfo_open,  meminfo_read,  meminfo_write,  meminfo_close,  NULL           };
+
+/* Devices that open by name without being in the file system image */
+static const struct {
+    const int8_t* name;
+    fops_table_t* fops;
+} device_files[] = {
+    { "serial",  &serial_table  },
+    { "dmesg",   &dmesg_table   },
+    { "meminfo", &meminfo_table },
+};
 
 /* fops_table_t get_RTC_table;
  *   Inputs: None
  *   Return Value: fops_table_t
- *   Function: Assemble the open, read, write, and close functions for RTC in a table and return the address */
+ *   Function: Returns the address of the open, read, write, and close table for RTC */
 fops_table_t* get_RTC_table (void) {
-    table.open = rtc_open;
-    table.read = rtc_read;
-    table.write = rtc_write;
-    table.close = rtc_close;
-    return &table;
+    return &rtc_table;
 }
 
 /* fops_table_t get_dir_table;
  *   Inputs: None
  *   Return Value: fops_table_t
- *   Function: Assemble the open, read, write, and close functions for directory in a table and return the address */
+ *   Function: Returns the address of the open, read, write, and close table for directory */
 fops_table_t* get_dir_table (void) {
-    table.open = dir_open;
-    table.read = dir_read;
-    table.write = dir_write;
-    table.close = dir_close;
-    return &table;
+    return &dir_table;
 }
 
 /* fops_table_t get_file_table;
  *   Inputs: None
  *   Return Value: fops_table_t
- *   Function: Assemble the open, read, write, and close functions for file in a table and return the address */
+ *   Function: Returns the address of the open, read, write, and close table for file */
 fops_table_t* get_file_table (void) {
-    table.open = file_open;
-    table.read = file_read;
-    table.write = file_write;
-    table.close = file_close;
-    return &table;
+    return &file_table;
 }
 
 /* fops_table_t get_terminal_table;
  *   Inputs: None
  *   Return Value: fops_table_t
- *   Function: Assemble the open, read, write, and close functions for terminal in a table and return the address */
+ *   Function: Returns the address of the open, read, write, and close table for terminal */
 fops_table_t* get_terminal_table (void) {
-    table.open = terminal_open;
-    table.read = terminal_read;
-    table.write = terminal_write;
-    table.close = terminal_close;
-    return &table;
+    return &terminal_table;
 }
 
 /* fops_table_t get_stdin_table;
  *   Inputs: None
  *   Return Value: fops_table_t
- *   Function: Assemble the open, read, write, and close functions for stdin in a table and return the address */
+ *   Function: Returns the address of the open, read, write, and close table for stdin */
 fops_table_t* get_stdin_table (void) {
-    table.open = terminal_open;
-    table.read = terminal_read;
-    table.write = NULL;
-    table.close = terminal_close;
-    return &table;
+    return &stdin_table;
 }
 
 /* fops_table_t get_stdout_table;
  *   Inputs: None
  *   Return Value: fops_table_t
- *   Function: Assemble the open, read, write, and close functions for stdout in a table and return the address */
+ *   Function: Returns the address of the open, read, write, and close table for stdout */
 fops_table_t* get_stdout_table (void) {
-    table.open = terminal_open;
-    table.read = NULL;
-    table.write = terminal_write;
-    table.close = terminal_close;
-    return &table;
+    return &stdout_table;
+}
+
+/* fops_table_t get_device_table;
+ *   Inputs: filename - name being opened
+ *   Return Value: fops_table_t, or NULL if it isn't a device
+ *   Function: Returns the table of the device opened as filename,
+ *             for devices that don't have a file system entry */
+fops_table_t* get_device_table (const uint8_t* filename) {
+    uint32_t i;
+
+    for (i = 0; i < sizeof(device_files) / sizeof(device_files[0]); i++) {
+        if (strncmp((const int8_t*)filename, device_files[i].name, strlen(device_files[i].name) + 1) == 0) {
+            return device_files[i].fops;
+        }
+    }
+    return NULL;
 }
@@ -9,6 +9,7 @@ typedef struct fops_table_t {
     int32_t (*read)(int32_t fd, void* buf, int32_t nbytes);
     int32_t (*write)(int32_t fd, const void* buf, int32_t nbytes);
     int32_t (*close)(int32_t fd);
+    int32_t (*ioctl)(int32_t fd, uint32_t cmd, uint32_t arg);
 } fops_table_t;
 
 /* Functions to get specific file operations tables */
@@ -18,5 +19,6 @@ extern fops_table_t* get_dir_table(void);
 extern fops_table_t* get_terminal_table(void);
 extern fops_table_t* get_stdout_table(void);
 extern fops_table_t* get_stdin_table(void);
+extern fops_table_t* get_device_table(const uint8_t* filename);
 
 #endif
@@ -0,0 +1,491 @@
+/* frame.c - Buddy allocator for physical page frames
+ * vim:ts=4 noexpandtab
+ */
+
+#include "frame.h"
+#include "lib.h"
+#include "klog.h"
+#include "file_system.h"
+#include "process.h"
+#include "exec_cache.h"
+
+#define FRAME_NONE              0xFFFF  /* End of a free list                       */
+
+/* frame_state holds one of these for each frame. Only the first frame */
+/* of a block says anything about the block; the rest are INSIDE.      */
+#define FRAME_FREE              0x80    /* ORed with the order of a free block      */
+#define FRAME_INSIDE            0x40    /* Not the first frame of its block         */
+#define FRAME_RESERVED          0x7F    /* Not RAM, or not ours to hand out         */
+#define FRAME_ORDER_MASK        0x0F
+
+#define MEMINFO_TEXT_SIZE       512
+#define ONE_MB                  0x00100000
+#define ONE_KB                  0x400
+#define PERCENT                 100
+
+/* Frames are numbered from FRAME_MEM_START, which is 4MB aligned, so */
+/* a block's buddy is found by flipping one bit of its number. Free   */
+/* blocks of each order are kept on a doubly linked list threaded     */
+/* through frame_next and frame_prev, so a buddy can be taken off its */
+/* list without walking it. The tables live in the kernel rather than */
+/* in the free frames, which the kernel has no mapping for.           */
+static uint8_t  frame_state[ FRAME_MAX_FRAMES ];
+static uint16_t frame_next[ FRAME_MAX_FRAMES ];
+static uint16_t frame_prev[ FRAME_MAX_FRAMES ];
+static uint16_t frame_free_head[ FRAME_NUM_ORDERS ];
+
+/* References to each allocated single frame: one for every page     */
+/* table mapping it, and one for the exec cache if it holds it.      */
+/* frame_alloc hands a frame out with one reference.                 */
+static uint16_t frame_refs[ FRAME_MAX_FRAMES ];
+
+static frame_stats_t frame_stats;
+
+/* Text of the "meminfo" file as it is built */
+typedef struct meminfo_text_t {
+    int32_t len;
+    uint8_t buf[ MEMINFO_TEXT_SIZE ];
+} meminfo_text_t;
+
+/* static void frame_list_add(uint32_t frame, uint32_t order);
+ *   Inputs: frame - first frame of a free block
+ *           order - size of the block
+ *   Return Value: none
+ *   Function: Puts a block on the free list for its order */
+static void frame_list_add( uint32_t frame, uint32_t order )
+{
+    frame_state[ frame ] = FRAME_FREE | order;
+    frame_prev[ frame ] = FRAME_NONE;
+    frame_next[ frame ] = frame_free_head[ order ];
+    if( frame_free_head[ order ] != FRAME_NONE )
+    {
+        frame_prev[ frame_free_head[ order ] ] = frame;
+    }
+    frame_free_head[ order ] = frame;
+
+    frame_stats.free_blocks[ order ]++;
+    frame_stats.free_frames += 1 << order;
+}
+
+/* static void frame_list_remove(uint32_t frame, uint32_t order);
+ *   Inputs: frame - first frame of a free block
+ *           order - size of the block
+ *   Return Value: none
+ *   Function: Takes a block off the free list for its order */
+static void frame_list_remove( uint32_t frame, uint32_t order )
+{
+    if( frame_prev[ frame ] != FRAME_NONE )
+    {
+        frame_next[ frame_prev[ frame ] ] = frame_next[ frame ];
+    }
+    else
+    {
+        frame_free_head[ order ] = frame_next[ frame ];
+    }
+    if( frame_next[ frame ] != FRAME_NONE )
+    {
+        frame_prev[ frame_next[ frame ] ] = frame_prev[ frame ];
+    }
+
+    frame_stats.free_blocks[ order ]--;
+    frame_stats.free_frames -= 1 << order;
+}
+
+/* static void frame_free_block(uint32_t frame, uint32_t order);
+ *   Inputs: frame - first frame of the block
+ *           order - size of the block
+ *   Return Value: none
+ *   Function: Frees a block, merging it with its buddy for as long as
+ *             the buddy is free and the same size. */
+static void frame_free_block( uint32_t frame, uint32_t order )
+{
+    uint32_t buddy;
+
+    while( order < FRAME_MAX_ORDER )
+    {
+        buddy = frame ^ ( 1 << order );
+        if( buddy >= FRAME_MAX_FRAMES || frame_state[ buddy ] != ( FRAME_FREE | order ) )
+        {
+            break;
+        }
+        frame_list_remove( buddy, order );
+        frame_state[ buddy ] = FRAME_INSIDE;
+        frame_state[ frame ] = FRAME_INSIDE;
+        frame = frame & buddy;
+        order++;
+    }
+    frame_list_add( frame, order );
+}
+
+/* static void frame_add_range(uint32_t start, uint32_t end, multiboot_info_t* mbi);
+ *   Inputs: start, end - physical range of usable RAM
+ *           mbi - multiboot info, for the modules in memory
+ *   Return Value: none
+ *   Function: Frees every whole frame of the range that is above
+ *             FRAME_MEM_START and not under a boot module. Frames
+ *             already added are skipped, in case map entries overlap. */
+static void frame_add_range( uint32_t start, uint32_t end, multiboot_info_t* mbi )
+{
+    module_t* mod;
+    uint32_t addr;
+    uint32_t frame;
+    uint32_t i;
+
+    if( start < FRAME_MEM_START )
+    {
+        start = FRAME_MEM_START;
+    }
+    if( end > FRAME_MEM_END || end < start )
+    {
+        end = FRAME_MEM_END;
+    }
+    start = ( start + FRAME_SIZE - 1 ) & ~( FRAME_SIZE - 1 );
+
+    for( addr = start; addr + FRAME_SIZE <= end && addr >= start; addr += FRAME_SIZE )
+    {
+        mod = (module_t*)mbi->mods_addr;
+        for( i = 0; i < mbi->mods_count; i++, mod++ )
+        {
+            if( addr < mod->mod_end && addr + FRAME_SIZE > mod->mod_start )
+            {
+                break;
+            }
+        }
+        frame = ( addr - FRAME_MEM_START ) >> FRAME_SHIFT;
+        if( i < mbi->mods_count || frame_state[ frame ] != FRAME_RESERVED )
+        {
+            continue;
+        }
+
+        frame_stats.total_frames++;
+        frame_free_block( frame, 0 );
+    }
+}
+
+/* void frame_init(multiboot_info_t* mbi);
+ *   Inputs: mbi - multiboot info from the boot loader
+ *   Return Value: none
+ *   Function: Gives the allocator the RAM the memory map says is
+ *             usable. Without a map, everything mem_upper covers
+ *             is used. Has to run before paging is turned on, while
+ *             the boot loader's tables can still be read. */
+void frame_init( multiboot_info_t* mbi )
+{
+    memory_map_t* mmap;
+    uint32_t i;
+
+    for( i = 0; i < FRAME_MAX_FRAMES; i++ )
+    {
+        frame_state[ i ] = FRAME_RESERVED;
+    }
+    for( i = 0; i < FRAME_NUM_ORDERS; i++ )
+    {
+        frame_free_head[ i ] = FRAME_NONE;
+    }
+
+    if( mbi->flags & MULTIBOOT_INFO_MEM_MAP )
+    {
+        for( mmap = (memory_map_t*)mbi->mmap_addr;
+             (uint32_t)mmap < mbi->mmap_addr + mbi->mmap_length;
+             mmap = (memory_map_t*)( (uint32_t)mmap + mmap->size + sizeof( mmap->size ) ) )
+        {
+            /* Nothing above 4GB is reachable without PAE */
+            if( mmap->type != MULTIBOOT_MMAP_AVAILABLE || mmap->base_addr_high != 0 )
+            {
+                continue;
+            }
+            frame_add_range( mmap->base_addr_low,
+                             mmap->length_high ? FRAME_MEM_END : mmap->base_addr_low + mmap->length_low,
+                             mbi );
+        }
+    }
+    else if( mbi->flags & MULTIBOOT_INFO_MEMORY )
+    {
+        frame_add_range( ONE_MB, ONE_MB + mbi->mem_upper * ONE_KB, mbi );
+    }
+}
+
+/* uint32_t frame_alloc(uint32_t order);
+ *   Inputs: order - allocate 2^order frames
+ *   Return Value: physical address of the block, 0 if none is free
+ *   Function: Takes the smallest free block big enough, splitting it
+ *             in halves until it is the right size. The block is
+ *             aligned to its own size. */
+uint32_t frame_alloc( uint32_t order )
+{
+    uint32_t flags;
+    uint32_t frame;
+    uint32_t k;
+
+    if( order > FRAME_MAX_ORDER )
+    {
+        return 0;
+    }
+
+    cli_and_save( flags );
+    for( k = order; k <= FRAME_MAX_ORDER && frame_free_head[ k ] == FRAME_NONE; k++ );
+    if( k > FRAME_MAX_ORDER )
+    {
+        frame_stats.failures++;
+        restore_flags( flags );
+        return 0;
+    }
+
+    frame = frame_free_head[ k ];
+    frame_list_remove( frame, k );
+    while( k > order )
+    {
+        k--;
+        frame_list_add( frame + ( 1 << k ), k );
+    }
+    frame_state[ frame ] = order;
+    frame_refs[ frame ] = 1;
+    frame_stats.allocs++;
+    restore_flags( flags );
+
+    return FRAME_MEM_START + ( frame << FRAME_SHIFT );
+}
+
+/* void frame_free(uint32_t addr, uint32_t order);
+ *   Inputs: addr - address frame_alloc returned
+ *           order - order it was allocated with
+ *   Return Value: none
+ *   Function: Gives a block back. A block that isn't allocated with
+ *             that order is logged and left alone, rather than
+ *             putting it on a free list twice. */
+void frame_free( uint32_t addr, uint32_t order )
+{
+    uint32_t flags;
+    uint32_t frame = ( addr - FRAME_MEM_START ) >> FRAME_SHIFT;
+
+    cli_and_save( flags );
+    if( addr < FRAME_MEM_START || frame >= FRAME_MAX_FRAMES ||
+        ( addr & ( ( FRAME_SIZE << order ) - 1 ) ) || frame_state[ frame ] != order )
+    {
+        restore_flags( flags );
+        klog( "frame_free: 0x%x isn't an allocated block of order %u\n", addr, order );
+        return;
+    }
+    frame_free_block( frame, order );
+    frame_stats.frees++;
+    restore_flags( flags );
+}
+
+/* static int32_t frame_ref_index(uint32_t addr);
+ *   Inputs: addr - address of a single frame from frame_alloc
+ *   Return Value: its frame number, -1 if it isn't an allocated frame */
+static int32_t frame_ref_index( uint32_t addr )
+{
+    uint32_t frame = ( addr - FRAME_MEM_START ) >> FRAME_SHIFT;
+
+    if( addr < FRAME_MEM_START || frame >= FRAME_MAX_FRAMES ||
+        ( addr & ( FRAME_SIZE - 1 ) ) || frame_state[ frame ] != 0 )
+    {
+        return -1;
+    }
+    return frame;
+}
+
+/* void frame_get(uint32_t addr);
+ *   Inputs: addr - address of a single frame from frame_alloc
+ *   Return Value: none
+ *   Function: Adds a reference to a frame that is being shared */
+void frame_get( uint32_t addr )
+{
+    uint32_t flags;
+    int32_t frame;
+
+    cli_and_save( flags );
+    frame = frame_ref_index( addr );
+    if( frame >= 0 )
+    {
+        frame_refs[ frame ]++;
+    }
+    restore_flags( flags );
+}
+
+/* void frame_put(uint32_t addr);
+ *   Inputs: addr - address of a single frame from frame_alloc
+ *   Return Value: none
+ *   Function: Drops a reference, freeing the frame with the last one */
+void frame_put( uint32_t addr )
+{
+    uint32_t flags;
+    int32_t frame;
+
+    cli_and_save( flags );
+    frame = frame_ref_index( addr );
+    if( frame < 0 )
+    {
+        restore_flags( flags );
+        klog( "frame_put: 0x%x isn't an allocated frame\n", addr );
+        return;
+    }
+    if( --frame_refs[ frame ] == 0 )
+    {
+        frame_free_block( frame, 0 );
+        frame_stats.frees++;
+    }
+    restore_flags( flags );
+}
+
+/* uint32_t frame_refcount(uint32_t addr);
+ *   Inputs: addr - address of a single frame from frame_alloc
+ *   Return Value: references to it, 0 if it isn't allocated */
+uint32_t frame_refcount( uint32_t addr )
+{
+    int32_t frame = frame_ref_index( addr );
+
+    return ( frame < 0 ) ? 0 : frame_refs[ frame ];
+}
+
+/* void frame_get_stats(frame_stats_t* stats);
+ *   Inputs: stats - where to copy the counters
+ *   Return Value: none
+ *   Function: Takes a consistent copy of the allocator's counters */
+void frame_get_stats( frame_stats_t* stats )
+{
+    uint32_t flags;
+
+    cli_and_save( flags );
+    *stats = frame_stats;
+    restore_flags( flags );
+}
+
+/* uint32_t frame_fragmentation();
+ *   Inputs: none
+ *   Return Value: 0 to 100
+ *   Function: How much of the free memory can't be had in one piece.
+ *             0 means all of it is in the largest free block, and it
+ *             goes toward 100 as free memory breaks into small blocks. */
+uint32_t frame_fragmentation( void )
+{
+    frame_stats_t stats;
+    int32_t k;
+
+    frame_get_stats( &stats );
+    for( k = FRAME_MAX_ORDER; k >= 0 && stats.free_blocks[ k ] == 0; k-- );
+    if( k < 0 )
+    {
+        return 0;
+    }
+
+    /* Once there's a free 4MB block, the most any allocation can */
+    /* ask for, free memory isn't fragmented for anyone.          */
+    if( k == FRAME_MAX_ORDER )
+    {
+        return 0;
+    }
+    return PERCENT - ( PERCENT << k ) / stats.free_frames;
+}
+
+/* static void meminfo_out(uint8_t c, void* arg);
+ *   Inputs: c - next character of the text
+ *           arg - the meminfo_text_t being built
+ *   Return Value: none
+ *   Function: Adds to the text, dropping what doesn't fit */
+static void meminfo_out( uint8_t c, void* arg )
+{
+    meminfo_text_t* text = arg;
+
+    if( text->len < MEMINFO_TEXT_SIZE )
+    {
+        text->buf[ text->len++ ] = c;
+    }
+}
+
+/* static void meminfo_printf(meminfo_text_t* text, int8_t* format, ...);
+ *   Inputs: text - text being built
+ *           format - printf format string, then its arguments
+ *   Return Value: none
+ *   Function: printf into the text */
+static void meminfo_printf( meminfo_text_t* text, int8_t* format, ... )
+{
+    int32_t* esp = (void *)&format;
+
+    esp++;
+    format_to( meminfo_out, text, format, esp );
+}
+
+/* int32_t meminfo_open(const uint8_t* filename);
+ *   Inputs: filename - unused
+ *   Return Value: 0
+ *   Function: Opens the allocator's counters as a text file */
+int32_t meminfo_open( const uint8_t* filename )
+{
+    return 0;
+}
+
+/* int32_t meminfo_close(int32_t fd);
+ *   Inputs: fd - unused
+ *   Return Value: 0
+ *   Function: Closes the file */
+int32_t meminfo_close( int32_t fd )
+{
+    return 0;
+}
+
+/* int32_t meminfo_read(int32_t fd, void* buf, int32_t nbytes);
+ *   Inputs: fd - open "meminfo" file
+ *           buf - buffer to fill
+ *           nbytes - most bytes to read
+ *   Return Value: number of bytes read, 0 at the end
+ *   Function: Writes out the counters as text and reads it from the
+ *             file's position. */
+int32_t meminfo_read( int32_t fd, void* buf, int32_t nbytes )
+{
+    open_file_t* file = get_open_file( fd );
+    meminfo_text_t text;
+    frame_stats_t stats;
+    proc_stats_t procs;
+    exec_cache_stats_t cache;
+    int32_t count;
+    int32_t k;
+
+    if( file == NULL || buf == NULL || nbytes < 0 )
+    {
+        return -1;
+    }
+
+    frame_get_stats( &stats );
+    text.len = 0;
+    meminfo_printf( &text, "Frames:   %u total, %u free (%u kB)\n",
+                    stats.total_frames, stats.free_frames, stats.free_frames * ( FRAME_SIZE / ONE_KB ) );
+    meminfo_printf( &text, "Free blocks by order:\n" );
+    for( k = 0; k <= FRAME_MAX_ORDER; k++ )
+    {
+        meminfo_printf( &text, "  %d: %u\n", k, stats.free_blocks[ k ] );
+    }
+    meminfo_printf( &text, "Fragmentation: %u%%\n", frame_fragmentation( ) );
+    meminfo_printf( &text, "Allocs: %u  Frees: %u  Failures: %u\n",
+                    stats.allocs, stats.frees, stats.failures );
+
+    proc_get_stats( &procs );
+    meminfo_printf( &text, "Processes: %u running, %u peak, %u slots pooled\n",
+                    procs.in_use, procs.peak, procs.pooled );
+    exec_cache_get_stats( &cache );
+    meminfo_printf( &text, "Exec cache: %u pages, %u hits, %u misses, %u evicted\n",
+                    cache.pages, cache.hits, cache.misses, cache.evictions );
+
+    if( file->file_position >= text.len )
+    {
+        return 0;
+    }
+    count = text.len - file->file_position;
+    if( count > nbytes )
+    {
+        count = nbytes;
+    }
+    memcpy( buf, text.buf + file->file_position, count );
+    file->file_position += count;
+    return count;
+}
+
+/* int32_t meminfo_write(int32_t fd, const void* buf, int32_t nbytes);
+ *   Inputs: ignored
+ *   Return Value: -1
+ *   Function: The counters can't be written */
+int32_t meminfo_write( int32_t fd, const void* buf, int32_t nbytes )
+{
+    return -1;
+}
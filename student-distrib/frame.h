@@ -0,0 +1,70 @@
+/* frame.h - Buddy allocator for physical page frames
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _FRAME_H
+#define _FRAME_H
+
+#include "types.h"
+#include "multiboot.h"
+
+#define FRAME_SIZE              0x1000
+#define FRAME_SHIFT             12
+
+/* Everything below 8MB is the kernel's: low memory and video, and the */
+/* kernel 4MB page. PCBs and kernel stacks come from here like any     */
+/* other memory. Frames are handed out from 8MB up to the end of RAM,  */
+/* but no further than FRAME_MEM_END, which sets the size of the       */
+/* tables below.                                                       */
+#define FRAME_MEM_START         0x00800000
+#define FRAME_MEM_END           0x10000000      /* 256MB */
+#define FRAME_MAX_FRAMES        ( ( FRAME_MEM_END - FRAME_MEM_START ) >> FRAME_SHIFT )
+
+/* Blocks are 2^order frames, from one 4kB frame up to a 4MB block */
+#define FRAME_MAX_ORDER         10
+#define FRAME_NUM_ORDERS        ( FRAME_MAX_ORDER + 1 )
+
+/* Multiboot info flags and the memory map type for usable RAM */
+#define MULTIBOOT_INFO_MEMORY   0x00000001      /* mem_lower and mem_upper are valid    */
+#define MULTIBOOT_INFO_MEM_MAP  0x00000040      /* mmap_addr and mmap_length are valid  */
+#define MULTIBOOT_MMAP_AVAILABLE 1
+
+/* Counters for watching the allocator. free_blocks[k] is the number   */
+/* of free blocks of 2^k frames.                                       */
+typedef struct frame_stats_t {
+    uint32_t total_frames;                      /* Frames found in the memory map       */
+    uint32_t free_frames;                       /* Frames free right now                */
+    uint32_t free_blocks[ FRAME_NUM_ORDERS ];
+    uint32_t allocs;                            /* Successful frame_alloc calls         */
+    uint32_t frees;                             /* frame_free calls                     */
+    uint32_t failures;                          /* frame_alloc calls with nothing free  */
+} frame_stats_t;
+
+/* Hands the usable RAM in the multiboot memory map to the allocator */
+extern void frame_init( multiboot_info_t* mbi );
+
+/* Allocates 2^order frames, aligned to their size. 0 if none are free. */
+extern uint32_t frame_alloc( uint32_t order );
+
+/* Gives back a block from frame_alloc */
+extern void frame_free( uint32_t addr, uint32_t order );
+
+/* Reference counts for single frames mapped in more than one place.  */
+/* frame_put frees the frame when the last reference goes.            */
+extern void frame_get( uint32_t addr );
+extern void frame_put( uint32_t addr );
+extern uint32_t frame_refcount( uint32_t addr );
+
+/* Copies the allocator's counters */
+extern void frame_get_stats( frame_stats_t* stats );
+
+/* Percent of free memory that isn't in the largest free block */
+extern uint32_t frame_fragmentation( void );
+
+/* Device file operations for "meminfo" */
+extern int32_t meminfo_open( const uint8_t* filename );
+extern int32_t meminfo_close( int32_t fd );
+extern int32_t meminfo_read( int32_t fd, void* buf, int32_t nbytes );
+extern int32_t meminfo_write( int32_t fd, const void* buf, int32_t nbytes );
+
+#endif /* _FRAME_H */
@@ -183,3 +183,30 @@ void send_eoi(uint32_t irq_num) {
         outb(EOI + SLAVE_CONNECTION, MASTER_8259_PORT_C);
     }
 }
+
+/* int32_t irq_pending(uint32_t irq_num);
+ *   Inputs: uint32_t irq_num --> the IRQ number to check
+ *   Return Value: 1 if the IRQ has been raised but not yet taken, 0 if not
+ *   Function: Reads the Interrupt Request Register of the PIC the IRQ is on */
+int32_t irq_pending(uint32_t irq_num) {
+    uint8_t irr;
+
+    /* Checks whether the given irq_num is valid */
+    if (irq_num > 15) {
+        return 0;
+    }
+
+    /* Master PIC (IRQs 0-7) */
+    if (irq_num < 8) {
+        outb(OCW3_READ_IRR, MASTER_8259_PORT_C);
+        irr = inb(MASTER_8259_PORT_C);
+    }
+    /* Slave PIC (IRQs 8-15) */
+    else {
+        irq_num = irq_num - 8;
+        outb(OCW3_READ_IRR, SLAVE_8259_PORT_C);
+        irr = inb(SLAVE_8259_PORT_C);
+    }
+
+    return (irr >> irq_num) & 0x1;
+}
@@ -30,6 +30,10 @@
  * to declare the interrupt finished */
 #define EOI                 0x60
 
+/* Operation control word 3 that makes the next read of
+ * the command port return the Interrupt Request Register */
+#define OCW3_READ_IRR       0x0A
+
 /* Other defined constants */
 #define INITIALIZE_MASK     0xFF
 #define MASK_ALL            0xFF
@@ -45,5 +49,7 @@ void enable_irq(uint32_t irq_num);
 void disable_irq(uint32_t irq_num);
 /* Send end-of-interrupt signal for the specified IRQ */
 void send_eoi(uint32_t irq_num);
+/* Check whether the specified IRQ is raised but not yet taken */
+int32_t irq_pending(uint32_t irq_num);
 
 #endif /* _I8259_H */
@@ -78,7 +78,7 @@ void init_idt( )
     SET_IDT_ENTRY( idt[ EXCEPTION_VECTOR_NP  ],  exception_handler_NP  );
     SET_IDT_ENTRY( idt[ EXCEPTION_VECTOR_SS  ],  exception_handler_SS  );
     SET_IDT_ENTRY( idt[ EXCEPTION_VECTOR_GP  ],  exception_handler_GP  );
-    SET_IDT_ENTRY( idt[ EXCEPTION_VECTOR_PF  ],  exception_handler_PF  );
+    SET_IDT_ENTRY( idt[ EXCEPTION_VECTOR_PF  ],  page_fault_linkage    );
     SET_IDT_ENTRY( idt[ EXCEPTION_VECTOR_15  ],  exception_handler_15  );
     SET_IDT_ENTRY( idt[ EXCEPTION_VECTOR_MF  ],  exception_handler_MF  );
     SET_IDT_ENTRY( idt[ EXCEPTION_VECTOR_AC  ],  exception_handler_AC  );
@@ -93,6 +93,9 @@ void init_idt( )
 
     /* Set PIT interrupt handler */
     SET_IDT_ENTRY( idt[PIT_VECTOR], pit_handler_linkage);
+
+    /* Set COM1 interrupt handler */
+    SET_IDT_ENTRY( idt[SERIAL_VECTOR], serial_handler_linkage);
 }
 
 
@@ -218,8 +221,17 @@ void exception_handler_GP( )
     while(1){ }
 }
 
-void exception_handler_PF( )
+/* Page faults come in through page_fault_linkage with the faulting    */
+/* address and error code. A fault on a user page that hasn't been      */
+/* loaded yet is filled in and the instruction is retried, anything     */
+/* else is a real fault and quashes the program like other exceptions.  */
+void exception_handler_PF( uint32_t fault_addr, uint32_t error_code )
 {
+    if( demand_page_in( fault_addr, error_code ) == 0 )
+    {
+        return;
+    }
+
     exception_wrapper( EXCEPTION_VECTOR_PF );
     printf("Exception 14 (#PF) (Page Fault) invoked. Looping...\n");
 
@@ -16,6 +16,7 @@
 /* Defining interrupt vectors for devices */
 #define PIT_VECTOR               0x20
 #define KEYBOARD_VECTOR          0x21
+#define SERIAL_VECTOR            0x24
 #define RTC_VECTOR               0x28
 
 /* Vectors nums for exceptions */
@@ -55,7 +56,7 @@ void exception_handler_TS( );
 void exception_handler_NP( );
 void exception_handler_SS( );
 void exception_handler_GP( );
-void exception_handler_PF( );
+void exception_handler_PF( uint32_t fault_addr, uint32_t error_code );
 void exception_handler_15( );
 void exception_handler_MF( );
 void exception_handler_AC( );
@@ -8,4 +8,7 @@ extern void rtc_handler_linkage();
 /* Links the PIT interrupt handler funciton through assembly linkage */
 extern void pit_handler_linkage();
 
+/* Links the COM1 interrupt handler function through assembly linkage */
+extern void serial_handler_linkage();
+
 #endif
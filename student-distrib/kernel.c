@@ -11,9 +11,12 @@
 #include "paging.h"
 #include "keyboard.h"
 #include "rtc.h"
+#include "serial.h"
 #include "file_system.h"
 #include "syscall.h"
 #include "scheduling.h"
+#include "ktime.h"
+#include "frame.h"
 
 /* Set to 1 to run all test cases */
 #define RUN_TESTS 0
@@ -60,8 +63,11 @@ void entry(unsigned long magic, unsigned long addr) {
         printf("boot_device = 0x%#x\n", (unsigned)mbi->boot_device);
 
     /* Is the command line passed? */
-    if (CHECK_FLAG(mbi->flags, 2))
+    if (CHECK_FLAG(mbi->flags, 2)) {
         printf("cmdline = %s\n", (char *)mbi->cmdline);
+        /* Pick up the timer options before the PIT is set up */
+        PIT_parse_cmdline((int8_t *)mbi->cmdline);
+    }
 
     if (CHECK_FLAG(mbi->flags, 3)) {
         int mod_count = 0;
@@ -151,17 +157,35 @@ void entry(unsigned long magic, unsigned long addr) {
         ltr(KERNEL_TSS);
     }
 
+    /* Set up the SYSENTER/SYSEXIT fast system call path */
+    sysenter_init();
+
     /* Initialize devices, memory, filesystem, enable device interrupts on the
      * PIC, any other initialization stuff... */
 
     /* Initialize PIC */
     i8259_init();
 
+    /* Initialize COM1 first, so everything printed after this */
+    /* can be mirrored out of it                               */
+    if (serial_init()) {
+        printf("COM1 was initialized\n");
+    }
+
     /* Initialize file system */
     module_t* module_addr = (module_t*) mbi->mods_addr;
     uint32_t* file_system_start_addr = (uint32_t*) (module_addr->mod_start);
     fileSystem_init(file_system_start_addr);
 
+    /* Hand the RAM in the memory map to the frame allocator while */
+    /* the boot loader's tables are still mapped                   */
+    frame_init(mbi);
+    {
+        frame_stats_t stats;
+        frame_get_stats(&stats);
+        printf("%u kB of memory free for processes\n", stats.free_frames * (FRAME_SIZE / 1024));
+    }
+
     /* Initialize paging */
     page_init();
 
@@ -181,6 +205,15 @@ void entry(unsigned long magic, unsigned long addr) {
     }
     #endif
 
+    /* Calibrate the TSC against the PIT for ktime_ns */
+    ktime_init();
+    if (tsc_khz) {
+        printf("TSC runs at %u kHz\n", tsc_khz);
+    }
+    else {
+        printf("TSC was not calibrated, timing with the PIT\n");
+    }
+
     #if !RUN_TESTS
     /* Initialize PIT */
     PIT_init();    
@@ -2,6 +2,7 @@
 #include "lib.h"
 #include "i8259.h"
 #include "syscall.h"
+#include "scheduling.h"
 
 #define TESTMODE 1
 
@@ -19,19 +20,52 @@ char*   terminal_video_mem;
 int     word_count[ NUM_TERMINALS ];
 
 /* Also keep track of keyboard buffer. That is, keep track of   */
-/* the characters passed into the keyboard so that we can pass  */
-/* the values to the terminal later on. The maximum number of   */
-/* characters in the buffer is 128. Initialize to '0' on start  */
+/* the characters of the line being typed, which go to the      */
+/* terminal's input ring when ENTER is pressed. The maximum     */
+/* number of characters in the buffer is 128. Initialize to '0' */
+/* on start.                                                    */
 uint8_t  keyboard_buffer[ NUM_TERMINALS ][ BUFFER_SIZE ];
 
-/* Keep track of the last character in the line printed for     */
-/* backspace support, initialized to zero at start.             */
-static int  end_of_line[ NUM_ROWS ] = { 0, 0, 0, 0, 0,
-                                        0, 0, 0, 0, 0,
-                                        0, 0, 0, 0, 0,
-                                        0, 0, 0, 0, 0,
-                                        0, 0, 0, 0, 0
-};
+/* Keep track of the last character in each line printed for  */
+/* backspace support, one set per terminal. Zero at start.      */
+static int  end_of_line[ NUM_TERMINALS ][ NUM_ROWS ];
+
+/* Each terminal draws into a shadow copy of its screen in      */
+/* normal RAM, and only rows marked dirty get copied out to     */
+/* video memory when terminal_flush runs. Video memory is slow  */
+/* to write, so a big write only touches it once per row.       */
+static uint16_t shadow_screen[ NUM_TERMINALS ][ NUM_ROWS * NUM_COLS ];
+static uint32_t shadow_dirty[ NUM_TERMINALS ];
+
+/* Rows each shadow screen has scrolled by since its last flush */
+static uint32_t shadow_scrolled[ NUM_TERMINALS ];
+
+/* Row of the VGA text window the displayed screen starts at.   */
+/* Scrolling the displayed terminal moves this down instead of  */
+/* copying the screen, until it runs out of window.             */
+static int  vga_origin = 0;
+
+/* Where the hardware cursor was last put, so a flush that      */
+/* didn't move it doesn't need any port I/O.                    */
+static int  cursor_shown = -1;
+
+/* Rows that scrolled off the top of each terminal, in a ring.  */
+/* scrollback_head is the slot the next row goes in, so the     */
+/* newest row sits just before it. Scrolling only appends rows; */
+/* the history already there never moves.                       */
+static uint16_t scrollback[ NUM_TERMINALS ][ SCROLLBACK_ROWS * NUM_COLS ];
+static uint32_t scrollback_head[ NUM_TERMINALS ];
+static uint32_t scrollback_count[ NUM_TERMINALS ];
+
+/* How many rows back each terminal is being viewed, 0 if live. */
+/* While the displayed terminal is scrolled back, its output    */
+/* still goes to the shadow screen but isn't flushed.           */
+static uint32_t scrollback_view[ NUM_TERMINALS ];
+
+/* Set once an 0xE0 prefix arrives, for the key after it */
+static uint8_t  extended_key = 0;
+
+static void clear_line_buffer( int32_t term );
 
 
 
@@ -127,10 +161,21 @@ void keyboard_init( void ) {
     }
     terminal_video_mem = (char *)VIDEO_MEM_LOC;
 
+    /* Start every shadow screen out blank */
+    for( i = 0; i < NUM_TERMINALS; i++ )
+    {
+        memset_word( shadow_screen[ i ], SHADOW_CELL( ' ' ), NUM_ROWS * NUM_COLS );
+        shadow_dirty[ i ] = 0;
+        shadow_scrolled[ i ] = 0;
+        scrollback_head[ i ] = 0;
+        scrollback_count[ i ] = 0;
+        scrollback_view[ i ] = 0;
+    }
+
     /* Also initialize the keyboard buffer and word_count */
     reset_keyboard_buffer( );
 
-    memset( terminal_vid_mem, 0, TERMINAL_MEMORY_SIZE );
+    memset_word( terminal_vid_mem, SHADOW_CELL( ' ' ), NUM_TERMINALS * TERMINAL_MEMORY_SIZE / sizeof( uint16_t ) );
 
 
 }
@@ -144,6 +189,36 @@ void keyboard_handler( void ) {
     unsigned int scancode = inb(KEYBOARD_PORT_IO);
     int scancode_flag = 0;
 
+    /* PageUp and PageDown come as an 0xE0 prefix and then the  */
+    /* key. With shift held they move the displayed terminal    */
+    /* through its scrollback. Other prefixed keys carry on as  */
+    /* their unprefixed twins.                                  */
+    if( scancode == EXTENDED_PREFIX )
+    {
+        extended_key = 1;
+        send_eoi( KEYBOARD_IRQ_NUM );
+        return;
+    }
+    if( extended_key )
+    {
+        extended_key = 0;
+
+        /* Keyboards wrap these keys in fake shift presses and  */
+        /* releases, which aren't the real shift key.           */
+        if( scancode == LEFT_SHIFT_PRESSED || scancode == LEFT_SHIFT_RELEASED )
+        {
+            send_eoi( KEYBOARD_IRQ_NUM );
+            return;
+        }
+        if( shift && ( scancode == PAGE_UP_PRESSED || scancode == PAGE_DOWN_PRESSED ) )
+        {
+            scrollback_scroll( display_terminal,
+                               ( scancode == PAGE_UP_PRESSED ) ? SCROLLBACK_STEP : -SCROLLBACK_STEP );
+            send_eoi( KEYBOARD_IRQ_NUM );
+            return;
+        }
+    }
+
     /* Update the special characters. Function also tells us if */
     /* the scancode falls outside the acceptable bounds.        */
     scancode_flag = process_type_of_character( scancode );
@@ -246,12 +321,26 @@ void keyboard_handler( void ) {
     if( scancode <= MAX_ACCEPTED_SCANCODE )
     {
         /* ONLY print on keypress, NOT release.                    */
-        keyboard_putc( keycode );
+        if( terminals[ display_terminal ].mode == TERM_MODE_RAW )
+        {
+            /* Raw mode hands over each key as is, without echo */
+            if( keycode != 0 )
+            {
+                input_ring_put( &terminals[ display_terminal ].input, &keycode, 1 );
+            }
+        }
+        else
+        {
+            keyboard_putc( keycode );
+        }
     }
 
 
     /* Sends end-of-interrupt signal to PIC to notify that we are done handling keyboard interrupt */
     send_eoi( KEYBOARD_IRQ_NUM );
+
+    /* If ENTER woke up a reader, let it run now */
+    scheduler_preempt( );
 }
 
 /*            process_type_of_character             */
@@ -370,12 +459,13 @@ int process_type_of_character( unsigned int scancode )
 void clear_and_reset_screen( void )
 {
     int32_t i;
-    /* Clear video memory by setting all to ' ' and ATTRIB.     */
-    for( i = 0; i < NUM_ROWS * NUM_COLS; i++ )
-    {
-        *(uint8_t *)(VIDEO_MEM_LOC + (i << 1)) = ' ';
-        *(uint8_t *)(VIDEO_MEM_LOC + (i << 1) + 1) = ATTRIB;
-    }
+
+    /* Clearing is done on the live screen */
+    scrollback_scroll( display_terminal, -SCROLLBACK_ROWS );
+
+    /* Clear the screen by setting all to ' ' and ATTRIB.       */
+    memset_word( shadow_screen[ display_terminal ], SHADOW_CELL( ' ' ), NUM_ROWS * NUM_COLS );
+    shadow_dirty[ display_terminal ] = SHADOW_ALL_ROWS;
 
     /* Reset x and y values so that we can print to the         */
     /* right place.                                             */
@@ -385,79 +475,276 @@ void clear_and_reset_screen( void )
     /* Also set end_of_line tracker */
     for( i = 0; i < NUM_ROWS; i++ )
     {
-        end_of_line[ i ] = 0;
+        end_of_line[ display_terminal ][ i ] = 0;
     }
 
-    /* Finally, reset the cursor. */
-    terminal_print_cursor( terminal_y[ display_terminal ], terminal_x[ display_terminal ] );
+    /* Finally, put it on screen and reset the cursor. */
+    terminal_flush( display_terminal );
 
     return;
 }
 
-/*           void terminal_putc( uint8_t c )            */
-/* Description: prints the character to the console.    */
-/* Customized to handle newlines, backspace, line       */
-/* overflow.                                            */
-/* Will support terminal buffer in the future...        */
-/* Inputs: c -> character to be printed                 */
+/*           char* terminal_video_page( term )          */
+/* Description: finds the text memory that terminal     */
+/* term should draw into. The displayed terminal draws  */
+/* straight into video memory, while the others draw    */
+/* into their saved page, which switch_terminal copies  */
+/* onto the screen when the terminal is brought up.     */
+/* Inputs: term -> terminal being drawn to              */
+/* Outputs: pointer to the start of the text memory     */
+/* Side Effects: None.                                  */
+char* terminal_video_page( int32_t term )
+{
+    if( term == display_terminal )
+    {
+        return (char *)( VIDEO_MEM_LOC + vga_origin * NUM_COLS * sizeof( uint16_t ) );
+    }
+    return (char *)terminal_vid_mem[ term ];
+}
+
+/*          void vga_set_origin( int32_t row )          */
+/* Description: shows the screen starting at row of the */
+/* VGA text window, by setting the CRTC start address.  */
+/* printf follows it there.                             */
+/* Inputs: row -> first row of the window to show       */
 /* Outputs: None.                                       */
-/* Side Effects: prints given character to screen, or   */
-/* deletes a character from the screen, or scrolls the  */
-/* screen, depending on what is passsed in, and the     */
-/* current x and y location.                            */
-void keyboard_putc( uint8_t c )
-{    
-    /* First, check if the buffer is full. If so, then  */
-    /* do NOT allow more printing to occur. However, we */
-    /* want to allow '\n' and BACKSPACE, since we want  */
-    /* to be able to remove characters from the buffer, */
-    /* and use '\n' to "enter" the command to the       */
-    /* terminal.                                        */
-    if( ( word_count[ display_terminal ] >= BUFFER_SIZE - 1 ) && ( c != '\n' && c != BACKSPACE ) )
+/* Side Effects: Writes the VGA start address registers */
+void vga_set_origin( int32_t row )
+{
+    uint16_t start = row * NUM_COLS;
+
+    vga_origin = row;
+    outb( VGA_HIGH_BYTE_OFF, VGA_BASE1 );
+    outb( ( start >> HIGH_BYTE_SHIFT ) & BYTE_0_MASK, VGA_BASE2 );
+    outb( VGA_LOW_BYTE_OFF, VGA_BASE1 );
+    outb( start & BYTE_0_MASK, VGA_BASE2 );
+    set_video_mem( (char *)VIDEO_MEM_LOC + start * sizeof( uint16_t ) );
+
+    /* The cursor position counts from the start of the window, */
+    /* so it has to be written again.                           */
+    cursor_shown = -1;
+}
+
+/*     int32_t terminal_uses_vidmap( int32_t term )     */
+/* Description: checks whether the program running in   */
+/* a terminal called vidmap. It draws straight into the */
+/* terminal's video page, so that page holds things the */
+/* shadow screen doesn't, and on screen it is the top   */
+/* page of the VGA window, so the terminal can't be     */
+/* scrolled by moving the start address.                */
+/* Inputs: term -> terminal to check                    */
+/* Outputs: 1 if it did, 0 if not                       */
+/* Side Effects: None.                                  */
+int32_t terminal_uses_vidmap( int32_t term )
+{
+    int32_t pid = ( term == sched_terminal ) ? curr_pid : terminals[ term ].pid;
+
+    return pid >= 0 && get_pcb( pid )->vidmap;
+}
+
+/*         void terminal_redraw( int32_t term )         */
+/* Description: writes the whole shadow screen of a     */
+/* terminal out to its video page, whatever was there.  */
+/* Inputs: term -> terminal to redraw                   */
+/* Outputs: None.                                       */
+/* Side Effects: Writes video memory and the cursor.    */
+void terminal_redraw( int32_t term )
+{
+    uint32_t flags;
+
+    cli_and_save( flags );
+    shadow_dirty[ term ] = SHADOW_ALL_ROWS;
+    terminal_flush( term );
+    restore_flags( flags );
+}
+
+/*  static uint16_t* scrollback_slot( term, back )      */
+/* Description: finds the ring slot of the row back     */
+/* rows above the top of terminal term's screen, 1      */
+/* being the newest. The caller keeps back within       */
+/* 1..SCROLLBACK_ROWS.                                  */
+/* Inputs: term -> terminal whose history to look in    */
+/*         back -> how many rows above the screen       */
+/* Outputs: pointer to the row's cells                  */
+/* Side Effects: None.                                  */
+static uint16_t* scrollback_slot( int32_t term, int32_t back )
+{
+    uint32_t slot = ( scrollback_head[ term ] + SCROLLBACK_ROWS - back ) % SCROLLBACK_ROWS;
+
+    return scrollback[ term ] + NUM_COLS * slot;
+}
+
+/* static void scrollback_append( term, rows, count )   */
+/* Description: appends count rows to the scrollback of */
+/* terminal term, copying them from rows, or blank if   */
+/* rows is NULL. Once the ring is full the oldest rows  */
+/* are written over. Blank rows beyond what the ring    */
+/* holds are skipped rather than written.               */
+/* Inputs: term -> terminal whose history to add to     */
+/*         rows -> cells to copy, or NULL               */
+/*         count -> number of rows                      */
+/* Outputs: None.                                       */
+/* Side Effects: Moves the ring head along.             */
+static void scrollback_append( int32_t term, const uint16_t* rows, int32_t count )
+{
+    uint16_t* slot;
+
+    if( count > SCROLLBACK_ROWS )
     {
-        /* Do not nothing if buffer full. Since the last character  */
-        /* in the buffer must be '\n', we want to reserve the very  */
-        /* last index of the buffer for such.                       */
-        
-        /* Update the cursor */
-        terminal_print_cursor( terminal_y[ display_terminal ], terminal_x[ display_terminal ] );
+        scrollback_head[ term ] = ( scrollback_head[ term ] + count - SCROLLBACK_ROWS ) % SCROLLBACK_ROWS;
+        count = SCROLLBACK_ROWS;
+    }
 
-        return;
+    scrollback_count[ term ] += count;
+    if( scrollback_count[ term ] > SCROLLBACK_ROWS )
+    {
+        scrollback_count[ term ] = SCROLLBACK_ROWS;
     }
 
-    /* Also don't allow printing if the buffer is empty and we      */
-    /* attempt to delete a character.                               */
-    if( ( word_count[ display_terminal ] == 0 ) && ( c == BACKSPACE ) )
+    for( ; count > 0; count-- )
     {
-        terminal_print_cursor( terminal_y[ display_terminal ], terminal_x[ display_terminal ] );
+        slot = scrollback[ term ] + NUM_COLS * scrollback_head[ term ];
+        if( rows != NULL )
+        {
+            memcpy( slot, rows, NUM_COLS * sizeof( uint16_t ) );
+            rows += NUM_COLS;
+        }
+        else
+        {
+            memset_word( slot, SHADOW_CELL( ' ' ), NUM_COLS );
+        }
+        scrollback_head[ term ] = ( scrollback_head[ term ] + 1 ) % SCROLLBACK_ROWS;
+    }
+}
 
+/* const uint16_t* scrollback_row( term, back )         */
+/* Description: gets a row of terminal term's history.  */
+/* Inputs: term -> terminal whose history to look in    */
+/*         back -> how many rows above the top of the   */
+/*                 screen, 1 being the newest           */
+/* Outputs: pointer to the row's cells, or NULL if the  */
+/*          terminal doesn't have that much history     */
+/* Side Effects: None.                                  */
+const uint16_t* scrollback_row( int32_t term, int32_t back )
+{
+    if( back < 1 || back > (int32_t)scrollback_count[ term ] )
+    {
+        return NULL;
+    }
+    return scrollback_slot( term, back );
+}
+
+/*    void scrollback_scroll( int32_t term, int32_t rows )  */
+/* Description: moves the view of terminal term rows    */
+/* further back into its history, or forward towards    */
+/* the live screen if rows is negative, stopping at     */
+/* either end. If the terminal is displayed, the view   */
+/* is drawn at the top of the VGA window with the       */
+/* cursor hidden, and the program in it carries on      */
+/* writing to the shadow screen unseen. Back at the     */
+/* live screen, the shadow is redrawn. Terminals whose  */
+/* program drew with vidmap have nothing to scroll.     */
+/* Inputs: term -> terminal to scroll                   */
+/*         rows -> rows to move back by                 */
+/* Outputs: None.                                       */
+/* Side Effects: Writes video memory and the cursor.    */
+void scrollback_scroll( int32_t term, int32_t rows )
+{
+    uint32_t flags;
+    int32_t view, r;
+    const uint16_t* row;
+
+    if( terminal_uses_vidmap( term ) )
+    {
         return;
     }
-    
+
+    cli_and_save( flags );
+    view = (int32_t)scrollback_view[ term ] + rows;
+    if( view > (int32_t)scrollback_count[ term ] )
+    {
+        view = scrollback_count[ term ];
+    }
+    if( view < 0 )
+    {
+        view = 0;
+    }
+    if( view == (int32_t)scrollback_view[ term ] )
+    {
+        restore_flags( flags );
+        return;
+    }
+    scrollback_view[ term ] = view;
+
+    if( term == display_terminal )
+    {
+        if( view == 0 )
+        {
+            terminal_redraw( term );
+        }
+        else
+        {
+            /* The top rows come from the history, the rest are */
+            /* the top of the shadow screen.                    */
+            vga_set_origin( 0 );
+            for( r = 0; r < NUM_ROWS; r++ )
+            {
+                row = ( r >= view ) ? shadow_screen[ term ] + NUM_COLS * ( r - view )
+                                    : scrollback_row( term, view - r );
+                memcpy( (uint16_t *)VIDEO_MEM_LOC + NUM_COLS * r, row, NUM_COLS * sizeof( uint16_t ) );
+            }
+
+            /* Park the cursor just below the screen, out of sight */
+            terminal_print_cursor( NUM_ROWS, 0 );
+        }
+    }
+    restore_flags( flags );
+}
+
+/*       void terminal_putc( int32_t term, uint8_t c )  */
+/* Description: prints the character to the screen of   */
+/* terminal term, whether or not it is the one being    */
+/* displayed. Customized to handle newlines, backspace, */
+/* line overflow. Leaves the keyboard buffer alone, so  */
+/* program output goes through here directly.           */
+/* The character goes into the terminal's shadow       */
+/* screen, and shows up once terminal_flush is called.  */
+/* Inputs: term -> terminal to print to                 */
+/*         c -> character to be printed                 */
+/* Outputs: None.                                       */
+/* Side Effects: prints given character to the shadow   */
+/* screen, or deletes a character from it, or scrolls   */
+/* it, depending on what is passsed in, and the current */
+/* x and y location of the terminal.                    */
+void terminal_putc( int32_t term, uint8_t c )
+{
+    uint32_t flags;
+    uint16_t* shadow = shadow_screen[ term ];
+
+    /* The keyboard handler prints to the same terminal, so     */
+    /* keep it out while the position is being updated.         */
+    cli_and_save( flags );
 
     /* First, check if newline passed through. If so,   */
     /* move characters to new line and reset x value.   */
     /* Additionally, if printing causes the line to run */
     /* out, then go to the next line if available.      */
-    /* NOTE: Currently configured NOT to support new    */
-    /* rows, i.e. if at bottom of screen, remain at     */
-    /* bottom.                                          */
     if( c == '\n' || c == '\r' )
     {
         /* If NOT at bottom of screen, go to new line.  */
-        if( terminal_y[ display_terminal ] != NUM_ROWS - 1 )
+        if( terminal_y[ term ] != NUM_ROWS - 1 )
         {
             /* Set end of line to terminal_x - 1, since */
             /* terminal_x and terminal_y represent the  */
             /* next printable space.                    */
-            if( terminal_x[ display_terminal ] != 0 )
+            if( terminal_x[ term ] != 0 )
             {
-                end_of_line[ terminal_y[ display_terminal ] ] = terminal_x[ display_terminal ] - 1;
+                end_of_line[ term ][ terminal_y[ term ] ] = terminal_x[ term ] - 1;
             }
             /* Set y row to next row and x to start of  */
             /* row.                                     */
-            terminal_y[ display_terminal ] = ( terminal_y[ display_terminal ] + 1 ) % NUM_ROWS;
-            terminal_x[ display_terminal ] = 0;
+            terminal_y[ term ] = ( terminal_y[ term ] + 1 ) % NUM_ROWS;
+            terminal_x[ term ] = 0;
         }
         else
         {
@@ -465,28 +752,17 @@ void keyboard_putc( uint8_t c )
             /* Add a newline by scrolling the screen down   */
             /* and resetting the terminal_x value.          */
             /* Also, update end of line tracker.            */
-            if( terminal_x[ display_terminal ] != 0 )
+            if( terminal_x[ term ] != 0 )
             {
-                end_of_line[ terminal_y[ display_terminal ] ] = terminal_x[ display_terminal ] - 1;
+                end_of_line[ term ][ terminal_y[ term ] ] = terminal_x[ term ] - 1;
             }
             else
             {
-                end_of_line[ terminal_y[ display_terminal ] ] = terminal_x[ display_terminal ];
+                end_of_line[ term ][ terminal_y[ term ] ] = terminal_x[ term ];
             }
             /* Scroll screen.                               */
-            scroll_screen( );
+            scroll_screen( term );
         }
-
-        /* Update the keyboard buffer by passing in the character   */
-        /* into the buffer. Also update the word_count. These two   */
-        /* operations will go towards the terminal support.         */
-        keyboard_buffer[ display_terminal ][ word_count[ display_terminal ] ] = c;
-        word_count[ display_terminal ]++;
-
-        /* Set the read_ready flag to indicate that the enter key   */
-        /* has been pressed.                                        */
-        read_ready = 1;
-
     }
     /* Check if BACKSPACE was passed through.       */
     /* If so, then replace last char with ' '. We   */
@@ -494,118 +770,379 @@ void keyboard_putc( uint8_t c )
     /* line as well.                                */
     else if( c == BACKSPACE )
     {
-        /* Check if backspace will move into previous   */
-        /* line. If so, change x and y accordingly.     */
-
         /* If terminal_x is at zero, then the last char */
         /* printed was on the previous line. Check if   */
         /* at top of screen. If so, do nothing. Else,   */
         /* delete from end of last line.                */
-        if( terminal_x[ display_terminal ] == 0 )
+        if( terminal_x[ term ] == 0 )
         {
             /* Do nothing if at top-left corner of screen. */
-            if( terminal_y[ display_terminal ] == 0 )
+            if( terminal_y[ term ] == 0 )
             {
                 /* Update end of line tracker to be beginning of line */
-                end_of_line[ terminal_y[ display_terminal ] ] = 0;
+                end_of_line[ term ][ terminal_y[ term ] ] = 0;
+                restore_flags( flags );
                 return;
             }
-            /* Else, get location of last printed character. */
+            /* Update end of line for current line */
+            end_of_line[ term ][ terminal_y[ term ] ] = 0;
+
+            /* Update terminal_x to print to the right space, and   */
+            /* terminal_y to the previous line.                     */
+            terminal_x[ term ] = end_of_line[ term ][ terminal_y[ term ] - 1 ];
+            terminal_y[ term ]--;
+        }
+        else
+        {
+            terminal_x[ term ]--;
+            end_of_line[ term ][ terminal_y[ term ] ] = terminal_x[ term ];
+        }
+        /* Print ' ' over the character pointed to by terminal_y    */
+        /* and terminal_x to figuratively "delete" it.              */
+        shadow[ NUM_COLS * terminal_y[ term ] + terminal_x[ term ] ] = SHADOW_CELL( ' ' );
+        shadow_dirty[ term ] |= 1 << terminal_y[ term ];
+    }
+    else
+    {
+        /* Check if printing a character at the current terminal_x  */
+        /* value prints outside of the allowed bounds. If so, move  */
+        /* to the next line, scrolling the screen if necessary.     */
+        if( terminal_x[ term ] >= NUM_COLS )
+        {
+            /* The row we're leaving is full, so backspacing into it */
+            /* lands on its last column.                             */
+            end_of_line[ term ][ terminal_y[ term ] ] = NUM_COLS - 1;
+            if( terminal_y[ term ] != NUM_ROWS - 1 )
+            {
+                terminal_y[ term ] = ( terminal_y[ term ] + 1 ) % NUM_ROWS;
+            }
             else
             {
-                /* Update end of line for current line */
-                end_of_line[ terminal_y[ display_terminal ] ] = 0;
+                scroll_screen( term );
+            }
+            terminal_x[ term ] = 0;
+        }
+
+        /* Update the end of line tracker, then print the character */
+        /* at the current location and move terminal_x along.       */
+        end_of_line[ term ][ terminal_y[ term ] ] = terminal_x[ term ];
+        shadow[ NUM_COLS * terminal_y[ term ] + terminal_x[ term ] ] = SHADOW_CELL( c );
+        shadow_dirty[ term ] |= 1 << terminal_y[ term ];
+        terminal_x[ term ]++;
+    }
+
+    restore_flags( flags );
+}
+
+/* static void terminal_puts_chunk( int32_t term, const uint8_t* buf, int32_t len ) */
+/* Description: prints len characters of program output */
+/* to the shadow screen of terminal term. Rather than   */
+/* going through terminal_putc one character at a time, */
+/* it works out how many lines the output moves down    */
+/* first, scrolls that many in one go, and then copies  */
+/* each run of printable characters straight into the   */
+/* rows. Output that would scroll right off the top is  */
+/* written into the scrollback instead. The line-editing*/
+/* state of the keyboard echo is left alone.            */
+/* Inputs: term -> terminal to print to                 */
+/*         buf -> characters to print, no '\0'          */
+/*         len -> number of characters                  */
+/* Outputs: None.                                       */
+/* Side Effects: Updates the shadow screen and the      */
+/* terminal's x and y, with interrupts off throughout.  */
+static void terminal_puts_chunk( int32_t term, const uint8_t* buf, int32_t len )
+{
+    uint32_t flags;
+    uint16_t* shadow = shadow_screen[ term ];
+    uint16_t* row;
+    int32_t start, end, run, lines, x, y, i;
+
+    cli_and_save( flags );
+    for( start = 0; start < len; start = end )
+    {
+        /* A backspace in output rubs out the character before  */
+        /* the cursor, but like a real terminal it stops at the */
+        /* start of the row. Going back a row would need the    */
+        /* keyboard echo's idea of where lines end.             */
+        if( buf[ start ] == BACKSPACE )
+        {
+            x = terminal_x[ term ];
+            y = terminal_y[ term ];
+            if( x > 0 )
+            {
+                x--;
+                shadow[ NUM_COLS * y + x ] = SHADOW_CELL( ' ' );
+                shadow_dirty[ term ] |= 1 << y;
+                terminal_x[ term ] = x;
+            }
+            end = start + 1;
+            continue;
+        }
 
-                /* Update terminal_x to print to the right space. */
-                terminal_x[ display_terminal ] = end_of_line[ terminal_y[ display_terminal ] - 1 ];
-                /* Also update terminal_y to prev line. */
-                terminal_y[ display_terminal ]--;
+        /* Count how many lines the output up to the next       */
+        /* backspace moves down, wrapping the same way          */
+        /* terminal_putc does.                                  */
+        x = terminal_x[ term ];
+        lines = 0;
+        for( end = start; end < len && buf[ end ] != BACKSPACE; end++ )
+        {
+            if( buf[ end ] == '\n' || buf[ end ] == '\r' )
+            {
+                lines++;
+                x = 0;
+                continue;
+            }
+            if( x >= NUM_COLS )
+            {
+                lines++;
+                x = 0;
             }
+            x++;
         }
-        else
+
+        /* Make room for all of it at once. Rows that end up    */
+        /* above the top of the screen have scrolled off, and   */
+        /* nothing needs to be drawn there.                     */
+        y = terminal_y[ term ];
+        if( y + lines > NUM_ROWS - 1 )
+        {
+            scroll_screen_lines( term, y + lines - ( NUM_ROWS - 1 ) );
+            y = NUM_ROWS - 1 - lines;
+        }
+
+        x = terminal_x[ term ];
+        while( start < end )
         {
-            terminal_x[ display_terminal ]--;
-            if( terminal_x[ display_terminal ] != 0 )
+            if( buf[ start ] == '\n' || buf[ start ] == '\r' )
+            {
+                y++;
+                x = 0;
+                start++;
+                continue;
+            }
+            if( x >= NUM_COLS )
             {
-                end_of_line[ terminal_y[ display_terminal ] ] = terminal_x[ display_terminal ];
+                y++;
+                x = 0;
+            }
+
+            /* Copy as much as fits on this row. Rows above the top */
+            /* of the screen already went to the scrollback, so     */
+            /* they are filled in there.                            */
+            for( run = 0; start + run < end && x + run < NUM_COLS &&
+                          buf[ start + run ] != '\n' && buf[ start + run ] != '\r'; run++ );
+            if( y >= 0 )
+            {
+                row = shadow + NUM_COLS * y;
+                shadow_dirty[ term ] |= 1 << y;
             }
             else
             {
-                end_of_line[ terminal_y[ display_terminal ] ] = 0;
+                row = ( -y <= SCROLLBACK_ROWS ) ? scrollback_slot( term, -y ) : NULL;
+            }
+            for( i = 0; row != NULL && i < run; i++ )
+            {
+                row[ x + i ] = SHADOW_CELL( buf[ start + i ] );
             }
+            x += run;
+            start += run;
         }
-        /* Set c to ' ' to figuratively "delete" the last character.     */
-        c = ' ';
-        /* Print over character pointed to by terminal_y and terminal_x. */
-        *(uint8_t *)(VIDEO_MEM_LOC + ((NUM_COLS * terminal_y[ display_terminal ] + terminal_x[ display_terminal ]) << 1)) = c;
-        *(uint8_t *)(VIDEO_MEM_LOC + ((NUM_COLS * terminal_y[ display_terminal ] + terminal_x[ display_terminal ]) << 1) + 1) = ATTRIB;
-
-        /* Decrease wordcount. Since this section is already configured */
-        /* to return if at top-left corner, we can safely decrement the */
-        /* word_count, since this part is designed to make sure that a  */
-        /* character exists that can be deleted.                        */
-        word_count[ display_terminal ]--;
 
-        /* Remove the character from the keyboard buffer. */
-        keyboard_buffer[ display_terminal ][ word_count[ display_terminal ] ] = 0;
+        terminal_x[ term ] = x;
+        terminal_y[ term ] = y;
     }
-    /* Check if printing a character at the current terminal_x value    */
-    /* prints outside of the allowed bounds. If so, scroll to the next  */
-    /* line.                                                            */
-    else if( terminal_x[ display_terminal ] >= NUM_COLS )
+    restore_flags( flags );
+}
+
+/* int32_t terminal_puts( int32_t term, const uint8_t* buf, int32_t nbytes ) */
+/* Description: prints program output to the shadow     */
+/* screen of terminal term, up to the first '\0'. It    */
+/* goes out a screenful at a time, with interrupts back */
+/* on in between, so one big write can't hold off the   */
+/* timer and the keyboard for as long as it likes.      */
+/* Inputs: term -> terminal to print to                 */
+/*         buf -> characters to print                   */
+/*         nbytes -> most characters to print           */
+/* Outputs: number of characters printed                */
+/* Side Effects: Updates the shadow screen and the      */
+/* terminal's x and y. Doesn't flush.                   */
+int32_t terminal_puts( int32_t term, const uint8_t* buf, int32_t nbytes )
+{
+    int32_t len, done, count;
+
+    for( len = 0; len < nbytes && buf[ len ] != '\0'; len++ );
+
+    for( done = 0; done < len; done += count )
     {
-        /* Reset the value of terminal_x to zero and move to the next   */
-        /* line. Scroll screen if necessary.                            */
-        if( terminal_y[ display_terminal ] != NUM_ROWS - 1 )
+        count = ( len - done < PUTS_CHUNK ) ? len - done : PUTS_CHUNK;
+        terminal_puts_chunk( term, buf + done, count );
+    }
+
+    return len;
+}
+
+/*         void terminal_flush( int32_t term )          */
+/* Description: copies the dirty rows of a terminal's   */
+/* shadow screen to its video page, the real screen if  */
+/* it is displayed or its saved page if not. Runs of    */
+/* dirty rows next to each other go out in one copy.    */
+/* If the displayed terminal scrolled, the screen is    */
+/* moved down the VGA text window instead of copied,    */
+/* and only the new rows are written; when the window   */
+/* runs out it goes back to the top with a full copy.   */
+/* Moves the cursor, once, if the terminal is on screen.*/
+/* Inputs: term -> terminal to flush                    */
+/* Outputs: None.                                       */
+/* Side Effects: Writes video memory and the cursor.    */
+void terminal_flush( int32_t term )
+{
+    uint32_t flags;
+    uint32_t dirty;
+    uint32_t scrolled;
+    int32_t origin;
+    uint16_t* video_page;
+    int32_t first, last;
+
+    /* The page has to be picked with interrupts off, so a      */
+    /* terminal switch can't move the screen out from under us. */
+    cli_and_save( flags );
+
+    /* A terminal being looked back through keeps its changes   */
+    /* for when the view goes back to live.                     */
+    if( term == display_terminal && scrollback_view[ term ] != 0 )
+    {
+        restore_flags( flags );
+        return;
+    }
+
+    scrolled = shadow_scrolled[ term ];
+    shadow_scrolled[ term ] = 0;
+
+    if( term == display_terminal )
+    {
+        origin = vga_origin;
+        if( terminal_uses_vidmap( term ) )
         {
-            /* Not at bottom of screen, no need to scroll. Find the     */
-            /* next y value and reset x to zero.                        */
-            terminal_y[ display_terminal ] = ( terminal_y[ display_terminal ] + 1 ) % NUM_ROWS;
+            origin = 0;
         }
-        else
+        else if( scrolled != 0 )
         {
-            /* Scroll the screen and reset x to the beginning of line.  */   
-            scroll_screen( );
+            origin += scrolled;
+            if( scrolled >= NUM_ROWS || origin + NUM_ROWS > VGA_WINDOW_ROWS )
+            {
+                origin = 0;
+            }
         }
-        terminal_x[ display_terminal ] = 0;
-
-        /* Print at the current location, then update the values of x   */
-        /* and y accordingly.                                           */
-        *(uint8_t *)(VIDEO_MEM_LOC + ((NUM_COLS * terminal_y[ display_terminal ] + terminal_x[ display_terminal ]) << 1)) = c;
-        *(uint8_t *)(VIDEO_MEM_LOC + ((NUM_COLS * terminal_y[ display_terminal ] + terminal_x[ display_terminal ]) << 1) + 1) = ATTRIB;
-        terminal_x[ display_terminal ]++;
-
-        /* Also update the end of line tracker, add the character to    */
-        /* the keyboard buffer, and increase the word count.            */
-        end_of_line[ terminal_y[ display_terminal ] ] = terminal_x[ display_terminal ];
-        keyboard_buffer[ display_terminal ][ word_count[ display_terminal ] ] = c;
-        word_count[ display_terminal ]++;
-    }
-    /* Else, print the charcater normally and increment the values of   */
-    /* terminal_x and terminal_y accordingly.                           */
+
+        /* Anywhere but one scroll further down the window, what's  */
+        /* there is stale.                                          */
+        if( origin != vga_origin + (int32_t)scrolled )
+        {
+            shadow_dirty[ term ] = SHADOW_ALL_ROWS;
+        }
+        video_page = (uint16_t *)VIDEO_MEM_LOC + origin * NUM_COLS;
+    }
     else
     {
-        /* Assumes that the value of x is valid for printing. Don't     */
-        /* worry about line overflow, as that should be supported by    */
-        /* the previous if statement.                                   */
+        /* Saved pages are plain memory and can't be scrolled */
+        if( scrolled != 0 )
+        {
+            shadow_dirty[ term ] = SHADOW_ALL_ROWS;
+        }
+        origin = 0;
+        video_page = (uint16_t *)terminal_video_page( term );
+    }
 
-        /* Update the end of line tracker before printing.              */
-        end_of_line[ terminal_y[ display_terminal ] ] = terminal_x[ display_terminal ];
-        /* Print the character to the screen at the current location    */
-        /* determined by terminal_x. terminal_x should not be able to   */
-        /* overflow, and thus we can print without worry.               */
-        *(uint8_t *)(VIDEO_MEM_LOC + ((NUM_COLS * terminal_y[ display_terminal ] + terminal_x[ display_terminal ]) << 1)) = c;
-        *(uint8_t *)(VIDEO_MEM_LOC + ((NUM_COLS * terminal_y[ display_terminal ] + terminal_x[ display_terminal ]) << 1) + 1) = ATTRIB;
-        terminal_x[ display_terminal ]++;
+    dirty = shadow_dirty[ term ];
+    shadow_dirty[ term ] = 0;
 
-        /* Also add the character to the keyboard buffer and increment  */
-        /* the word_count for tracking.                                 */
-        keyboard_buffer[ display_terminal ][ word_count[ display_terminal ] ] = c;
-        word_count[ display_terminal ]++;
+    for( first = 0; dirty != 0 && first < NUM_ROWS; first++ )
+    {
+        if( !( dirty & ( 1 << first ) ) )
+        {
+            continue;
+        }
+        for( last = first; last + 1 < NUM_ROWS && ( dirty & ( 1 << ( last + 1 ) ) ); last++ );
+        memcpy( video_page + NUM_COLS * first, shadow_screen[ term ] + NUM_COLS * first,
+                ( last - first + 1 ) * NUM_COLS * sizeof( uint16_t ) );
+        dirty &= ~( ( ( 1 << ( last + 1 ) ) - 1 ) );
+        first = last;
     }
 
-    /* Also, update cursor */
-    terminal_print_cursor( terminal_y[ display_terminal ], terminal_x[ display_terminal ] );
+    if( term == display_terminal )
+    {
+        /* Move the screen only once the new rows are in place */
+        if( origin != vga_origin )
+        {
+            vga_set_origin( origin );
+        }
+        terminal_print_cursor( terminal_y[ term ], terminal_x[ term ] );
+    }
+    restore_flags( flags );
+}
+
+/*           void keyboard_putc( uint8_t c )            */
+/* Description: echoes a typed character onto the       */
+/* displayed terminal and records it in that terminal's */
+/* keyboard buffer.                                     */
+/* Inputs: c -> character to be printed                 */
+/* Outputs: None.                                       */
+/* Side Effects: prints given character to screen and   */
+/* updates the keyboard buffer. Wakes up any reader of  */
+/* the displayed terminal on '\n'.                      */
+void keyboard_putc( uint8_t c )
+{    
+    /* Typing goes back to the live screen, like a real console */
+    if( scrollback_view[ display_terminal ] != 0 )
+    {
+        scrollback_scroll( display_terminal, -SCROLLBACK_ROWS );
+    }
+
+    /* First, check if the buffer is full. If so, then  */
+    /* do NOT allow more printing to occur. However, we */
+    /* want to allow '\n' and BACKSPACE, since we want  */
+    /* to be able to remove characters from the buffer, */
+    /* and use '\n' to "enter" the command to the       */
+    /* terminal.                                        */
+    if( ( word_count[ display_terminal ] >= BUFFER_SIZE - 1 ) && ( c != '\n' && c != BACKSPACE ) )
+    {
+        return;
+    }
+
+    /* Also don't allow printing if the buffer is empty and we      */
+    /* attempt to delete a character.                               */
+    if( ( word_count[ display_terminal ] == 0 ) && ( c == BACKSPACE ) )
+    {
+        return;
+    }
+
+    terminal_putc( display_terminal, c );
+    terminal_flush( display_terminal );
+
+    if( c == BACKSPACE )
+    {
+        /* Remove the character from the keyboard buffer. */
+        word_count[ display_terminal ]--;
+        keyboard_buffer[ display_terminal ][ word_count[ display_terminal ] ] = 0;
+        return;
+    }
+
+    /* Add the character to the keyboard buffer and increment   */
+    /* the word_count. These go towards the terminal support.   */
+    keyboard_buffer[ display_terminal ][ word_count[ display_terminal ] ] = c;
+    word_count[ display_terminal ]++;
+
+    if( c == '\n' || c == '\r' )
+    {
+        /* The line is finished, so hand it to the reader through   */
+        /* the input ring and start a new one. If the reader is so  */
+        /* far behind that the ring can't take the whole line, the  */
+        /* line is dropped rather than split.                       */
+        input_ring_put( &terminals[ display_terminal ].input,
+                        keyboard_buffer[ display_terminal ], word_count[ display_terminal ] );
+        clear_line_buffer( display_terminal );
+        wake_up( &terminals[ display_terminal ].read_queue );
+    }
 }
 
 /*             terminal_print_cursor                */
@@ -626,7 +1163,14 @@ void terminal_print_cursor( int cur_row, int cur_col )
     /* cursor starts and ends.                                  */
     /* Find the position on the VGA that corresponds to where   */
     /* the cursor should be.                                    */
-    uint16_t cursor_position = NUM_COLS * cur_row + cur_col;
+    uint16_t cursor_position = NUM_COLS * ( vga_origin + cur_row ) + cur_col;
+
+    /* Nothing to do if it's already there */
+    if( cursor_position == cursor_shown )
+    {
+        return;
+    }
+    cursor_shown = cursor_position;
 
     /* Set the VGA registers accordingly using the outb         */
     /* function provided by lib.h. Make sure to connect to the  */
@@ -650,60 +1194,81 @@ void terminal_print_cursor( int cur_row, int cur_col )
     outb( cursor_position_shifted_masked, VGA_BASE2 );
 }
 
-/*              void scroll_screen( void )                  */
-/* Scrolls the screen, adding another line to the bottom of */
-/* the screen while erasing the top line of the screen.     */
-/* Inputs: none.                                            */
+/*          void scroll_screen( int32_t term )              */
+/* Scrolls the screen of terminal term, adding another line */
+/* to the bottom of the screen while erasing the top line.  */
+/* Inputs: term -> terminal to scroll.                      */
 /* Outputs: none.                                           */
-/* Side Effects: Scrolls the screen. May erase lines from   */
-/* the top to make room for the bottom. Used in             */
-/* keyboard_putc to implement newline scrolling.            */
-void scroll_screen( void )
+/* Side Effects: Scrolls the shadow screen. May erase lines */
+/* from the top to make room for the bottom. Used in        */
+/* terminal_putc to implement newline scrolling.            */
+void scroll_screen( int32_t term )
 {
-    /* Accomplish scrolling by shifting video memory up the */
-    /* screen. We do not have to account for history, nor   */
-    /* support scrolling the screen up. We only need to     */
-    /* support scrolling the screen down.                   */
+    scroll_screen_lines( term, 1 );
 
-    /* Scroll the video memory up */
-    int cur_row;
-    int cur_col;
-    for( cur_row = 0; cur_row < NUM_ROWS - 1; cur_row++ )
+    /* Also reset terminal x and y values just in case... */
+    terminal_x[ term ] = 0;
+    terminal_y[ term ] = NUM_ROWS - 1;
+}
+
+/*   void scroll_screen_lines( int32_t term, int32_t lines )    */
+/* Scrolls the screen of terminal term up by lines rows at     */
+/* once, blanking the rows that come in at the bottom. The     */
+/* rows that go off the top are appended to the scrollback.    */
+/* Inputs: term -> terminal to scroll.                         */
+/*         lines -> rows to scroll by                          */
+/* Outputs: none.                                              */
+/* Side Effects: Scrolls the shadow screen and the end of line */
+/* tracker, and adds to the scrollback. Leaves terminal_x and  */
+/* terminal_y alone.                                           */
+void scroll_screen_lines( int32_t term, int32_t lines )
+{
+    /* Accomplish scrolling by shifting the shadow screen   */
+    /* up, after saving the rows that go off the top.       */
+    uint16_t* shadow = shadow_screen[ term ];
+    int i;
+
+    if( lines <= 0 )
     {
-        for( cur_col = 0; cur_col < NUM_COLS; cur_col++ )
-        {
-            /* Take on the memory of the row below the current row. */
-            *(uint8_t *)(VIDEO_MEM_LOC + ((NUM_COLS * cur_row + cur_col) << 1)) = *(uint8_t *)(terminal_video_mem + ((NUM_COLS * ( cur_row + 1 ) + cur_col) << 1));
-            *(uint8_t *)(VIDEO_MEM_LOC + ((NUM_COLS * cur_row + cur_col) << 1) + 1) = *(uint8_t *)(terminal_video_mem + ((NUM_COLS * ( cur_row + 1 ) + cur_col) << 1) + 1);
-        }
+        return;
     }
 
-    cur_row = NUM_ROWS - 1;
-    uint8_t c = ' ';
-    /* On the last row, set the values to blank. */
-    for( cur_col = 0; cur_col < NUM_COLS; cur_col++ )
+    /* Scrolling by more than a screen also passes over rows    */
+    /* that were never on it. Their scrollback rows start out   */
+    /* blank for terminal_puts to fill in.                      */
+    if( lines > NUM_ROWS )
     {
-        *(uint8_t *)(VIDEO_MEM_LOC + ((NUM_COLS * cur_row + cur_col) << 1)) = c;
-        *(uint8_t *)(VIDEO_MEM_LOC + ((NUM_COLS * cur_row + cur_col) << 1) + 1) = ATTRIB;
-        
+        scrollback_append( term, shadow, NUM_ROWS );
+        scrollback_append( term, NULL, lines - NUM_ROWS );
+        lines = NUM_ROWS;
     }
-
-    int i;
-    /* Shift the values in the end of line buffer to        */
-    /* account for the scrolling                            */
-    for( i = 0; i < NUM_ROWS - 1; i++ )
+    else
     {
-        end_of_line[ i ] = end_of_line[ i + 1 ];
+        scrollback_append( term, shadow, lines );
     }
-    end_of_line[ NUM_ROWS - 1 ] = 0;
 
-    /* Also reset terminal x and y values just in case... */
-    terminal_x[ display_terminal ] = 0;
-    terminal_y[ display_terminal ] = NUM_ROWS - 1;
+    memmove( shadow, shadow + NUM_COLS * lines, ( NUM_ROWS - lines ) * NUM_COLS * sizeof( uint16_t ) );
 
-    /* And don't forget to update the cursor after scrolling. */
-    terminal_print_cursor( terminal_y[ display_terminal ], terminal_x[ display_terminal ] );
+    /* On the new rows, set the values to blank. */
+    memset_word( shadow + ( NUM_ROWS - lines ) * NUM_COLS, SHADOW_CELL( ' ' ), lines * NUM_COLS );
 
+    /* Rows not yet flushed move up with the text, and the new  */
+    /* ones need writing. terminal_flush decides how to move    */
+    /* the rest.                                                */
+    shadow_dirty[ term ] = ( shadow_dirty[ term ] >> lines ) |
+                           ( SHADOW_ALL_ROWS & ~( ( 1 << ( NUM_ROWS - lines ) ) - 1 ) );
+    shadow_scrolled[ term ] += lines;
+
+    /* Shift the values in the end of line buffer to        */
+    /* account for the scrolling                            */
+    for( i = 0; i < NUM_ROWS - lines; i++ )
+    {
+        end_of_line[ term ][ i ] = end_of_line[ term ][ i + lines ];
+    }
+    for( ; i < NUM_ROWS; i++ )
+    {
+        end_of_line[ term ][ i ] = 0;
+    }
 }
 
 
@@ -730,23 +1295,51 @@ void put_string( const uint8_t* string )
 
 
 /*                 reset_keyboard_buffer                    */
-/* Resets the keyboard buffer, initializing all of its      */
-/* contents to 0, which we will use in determining whether  */
-/* we have reached the end of the buffer or not.            */
+/* Resets the keyboard buffer of the displayed terminal,    */
+/* initializing all of its contents to 0, which we will use */
+/* in determining whether we have reached the end of the    */
+/* buffer or not.                                           */
 /* Inputs: None.                                            */
 /* Outputs: None.                                           */
 /* Side Effects: Clears keyboard_buffer and word_count.     */
 void reset_keyboard_buffer( void )
+{
+    clear_keyboard_buffer( display_terminal );
+}
+
+/*                 clear_keyboard_buffer                    */
+/* Throws away the input of terminal term, both the line    */
+/* being typed and whole lines not read yet. Only the       */
+/* terminal's reader may call it, since it empties the      */
+/* input ring from the reading side.                        */
+/* Inputs: term -> terminal whose buffer to clear.          */
+/* Outputs: None.                                           */
+/* Side Effects: Clears keyboard_buffer, word_count and the */
+/* input ring.                                              */
+void clear_keyboard_buffer( int32_t term )
+{
+    uint32_t flags;
+
+    cli_and_save( flags );
+    clear_line_buffer( term );
+    restore_flags( flags );
+    input_ring_flush( &terminals[ term ].input );
+}
+
+/*                   clear_line_buffer                      */
+/* Resets the line being typed in terminal term.            */
+/* Inputs: term -> terminal whose line to clear.            */
+/* Outputs: None.                                           */
+/* Side Effects: Clears keyboard_buffer and word_count.     */
+static void clear_line_buffer( int32_t term )
 {
     /* Reset keyboard_buffer to 0 on request */
     int i;
     for( i = 0; i < BUFFER_SIZE; i++ )
     {
-        keyboard_buffer[ display_terminal ][ i ] = 0;
+        keyboard_buffer[ term ][ i ] = 0;
     }
     /* Also reset the word_count */
-    word_count[ display_terminal ] = 0;
+    word_count[ term ] = 0;
 
 }
-
-
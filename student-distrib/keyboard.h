@@ -40,6 +40,21 @@
 #define NUM_ROWS    25
 #define ATTRIB      0x7
 
+/* Rows of text that fit in the 32KB VGA text window */
+#define VGA_WINDOW_ROWS     ( 0x8000 / ( NUM_COLS * 2 ) )
+
+/* A character and its attribute, as one cell of text memory */
+#define SHADOW_CELL( c )    ( (uint16_t)( c ) | ( ATTRIB << 8 ) )
+#define SHADOW_ALL_ROWS     ( ( 1 << NUM_ROWS ) - 1 )
+
+/* Rows of history each terminal keeps once they scroll off the */
+/* top, and how far one Shift+PageUp/PageDown moves through it. */
+#define SCROLLBACK_ROWS     200
+#define SCROLLBACK_STEP     ( NUM_ROWS / 2 )
+
+/* Most output terminal_puts writes with interrupts off at once */
+#define PUTS_CHUNK          ( NUM_ROWS * NUM_COLS )
+
 /* Define Special Character Key Constants*/
 #define ESCAPE_PRESSED          0x01
 #define ESCAPE_RELEASED         0x81
@@ -58,6 +73,11 @@
 #define LEFT_ALT_PRESSED        0x38
 #define LEFT_ALT_RELEASED       0xB8
 
+/* Keys sent after an 0xE0 prefix byte */
+#define EXTENDED_PREFIX         0xE0
+#define PAGE_UP_PRESSED         0x49
+#define PAGE_DOWN_PRESSED       0x51
+
 /* Special keys to ignore */
 #define KEYPAD_STAR_PRESSED     0x37
 
@@ -99,20 +119,42 @@ extern int process_type_of_character( unsigned int scancode );
 /* Helper function to clear the screen and reset the printing location */
 extern void clear_and_reset_screen( void );
 
-/* Helper function to print character to screen. Modified version of putc. */
+/* Finds the text memory a terminal draws into, on screen or saved. */
+extern char* terminal_video_page( int32_t term );
+/* Shows the screen from the given row of the VGA text window. */
+extern void vga_set_origin( int32_t row );
+/* Prints a character to the shadow screen of the given terminal. */
+extern void terminal_putc( int32_t term, uint8_t c );
+/* Prints a buffer of program output to the shadow screen of the given terminal. */
+extern int32_t terminal_puts( int32_t term, const uint8_t* buf, int32_t nbytes );
+/* Copies what changed on a terminal's shadow screen to video memory. */
+extern void terminal_flush( int32_t term );
+/* Copies all of a terminal's shadow screen to video memory. */
+extern void terminal_redraw( int32_t term );
+/* Whether the program running in a terminal has its video page mapped. */
+extern int32_t terminal_uses_vidmap( int32_t term );
+/* Gets a row of a terminal's scrollback, back rows above the top of its screen. */
+extern const uint16_t* scrollback_row( int32_t term, int32_t back );
+/* Moves the view of a terminal rows further back into its scrollback, or forward if negative. */
+extern void scrollback_scroll( int32_t term, int32_t rows );
+/* Echoes a typed character to the displayed terminal and its keyboard buffer. */
 extern void keyboard_putc( uint8_t c );
 
 /* Function to print cursor to screen */
 extern void terminal_print_cursor( int cur_row, int cur_col );
 
 /* Function to scroll the screen */
-extern void scroll_screen( void );
+extern void scroll_screen( int32_t term );
+/* Function to scroll the screen by several lines at once */
+extern void scroll_screen_lines( int32_t term, int32_t lines );
 
 /* Function to print a string to the screen. Follows very closely to puts. */
 extern void put_string( const uint8_t* string );
 
 /* Function to reset the keyboard buffer. */
 extern void reset_keyboard_buffer( void );
+/* Function to reset the keyboard buffer of the given terminal. */
+extern void clear_keyboard_buffer( int32_t term );
 
 
 
@@ -0,0 +1,296 @@
+/* klog.c - Kernel log ring, read back through the "dmesg" file
+ * vim:ts=4 noexpandtab
+ */
+
+#include "klog.h"
+#include "lib.h"
+#include "ktime.h"
+#include "serial.h"
+#include "keyboard.h"
+#include "file_system.h"
+
+/* The log. Positions count up forever and are masked to index     */
+/* klog_buf, so the oldest text is written over once it fills.     */
+/* A writer reserves its bytes by moving klog_head, copies them     */
+/* in, and then adds them to klog_done. Whenever klog_done catches  */
+/* up with klog_head nothing is half written, and klog_committed    */
+/* moves up to there. Readers only look below klog_committed.       */
+static uint8_t klog_buf[ KLOG_SIZE ];
+static volatile uint32_t klog_head = 0;
+static volatile uint32_t klog_done = 0;
+static volatile uint32_t klog_committed = 0;
+
+/* How far klog_flush has sent the log */
+static uint32_t klog_flushed = 0;
+
+/* A message being formatted */
+typedef struct klog_line_t {
+    int32_t len;
+    uint8_t buf[ KLOG_LINE_MAX ];
+} klog_line_t;
+
+/* static uint32_t atomic_fetch_add(volatile uint32_t* p, uint32_t v);
+ *   Inputs: p - counter to add to
+ *           v - amount to add
+ *   Return Value: the counter before the add
+ *   Function: Adds in one instruction, so a handler interrupting
+ *             the add can't lose either update. */
+static inline uint32_t atomic_fetch_add( volatile uint32_t* p, uint32_t v )
+{
+    asm volatile( "lock; xaddl %0, %1" : "+r" ( v ), "+m" ( *p ) : : "memory" );
+    return v;
+}
+
+/* static uint32_t atomic_cmpxchg(volatile uint32_t* p, uint32_t old, uint32_t new);
+ *   Inputs: p - value to change
+ *           old - what it has to be for the change
+ *           new - what to change it to
+ *   Return Value: what *p was, old if it was changed */
+static inline uint32_t atomic_cmpxchg( volatile uint32_t* p, uint32_t old, uint32_t new )
+{
+    uint32_t prev;
+
+    asm volatile( "lock; cmpxchgl %2, %1"
+                  : "=a" ( prev ), "+m" ( *p )
+                  : "r" ( new ), "0" ( old )
+                  : "memory" );
+    return prev;
+}
+
+/* static void klog_line_out(uint8_t c, void* arg);
+ *   Inputs: c - next character of the message
+ *           arg - the klog_line_t being built
+ *   Return Value: none
+ *   Function: Adds to a message, keeping the last byte free for a
+ *             newline. */
+static void klog_line_out( uint8_t c, void* arg )
+{
+    klog_line_t* line = arg;
+
+    if( line->len < KLOG_LINE_MAX - 1 )
+    {
+        line->buf[ line->len++ ] = c;
+    }
+}
+
+/* static void klog_append(const uint8_t* data, uint32_t len);
+ *   Inputs: data - finished message
+ *           len - its length
+ *   Return Value: none
+ *   Function: Copies a message into the log without locking, so an
+ *             interrupt handler logging in the middle of it just
+ *             gets the space after it. */
+static void klog_append( const uint8_t* data, uint32_t len )
+{
+    uint32_t start = atomic_fetch_add( &klog_head, len );
+    uint32_t done;
+    uint32_t committed;
+    uint32_t prev;
+    uint32_t i;
+
+    for( i = 0; i < len; i++ )
+    {
+        klog_buf[ ( start + i ) & ( KLOG_SIZE - 1 ) ] = data[ i ];
+    }
+
+    done = atomic_fetch_add( &klog_done, len ) + len;
+    if( done != klog_head )
+    {
+        /* Someone else is still writing; they commit us too */
+        return;
+    }
+
+    /* Only ever move klog_committed forward. A later writer that   */
+    /* interrupted this one may already have moved it further.      */
+    committed = klog_committed;
+    while( (int32_t)( done - committed ) > 0 )
+    {
+        prev = atomic_cmpxchg( &klog_committed, committed, done );
+        if( prev == committed )
+        {
+            break;
+        }
+        committed = prev;
+    }
+}
+
+/* void klog(int8_t* format, ...);
+ *   Inputs: format - printf format string, then its arguments
+ *   Return Value: none
+ *   Function: Logs a line like "[12.345] message", the time being
+ *             seconds since boot. A newline is added if the message
+ *             doesn't end in one. */
+void klog( int8_t* format, ... )
+{
+    klog_line_t line;
+    uint32_t msec;
+    uint32_t sec;
+    int32_t* esp = (void *)&format;
+
+    esp++;
+    line.len = 0;
+
+    sec = (uint32_t)div_u64_u32( div_u64_u32( ktime_ns( ), NSEC_PER_MSEC, NULL ), MSEC_PER_SEC, &msec );
+    format_to( klog_line_out, &line, "[%u.", (int32_t*)&sec );
+    klog_line_out( '0' + msec / 100, &line );
+    klog_line_out( '0' + msec / 10 % 10, &line );
+    klog_line_out( '0' + msec % 10, &line );
+    klog_line_out( ']', &line );
+    klog_line_out( ' ', &line );
+
+    format_to( klog_line_out, &line, format, esp );
+    if( line.buf[ line.len - 1 ] != '\n' )
+    {
+        line.buf[ line.len++ ] = '\n';
+    }
+
+    klog_append( line.buf, line.len );
+}
+
+/* int32_t klog_read(uint32_t* pos, uint8_t* buf, int32_t nbytes);
+ *   Inputs: pos - where in the log to start, moved past what is read
+ *           buf - buffer to fill
+ *           nbytes - most bytes to read
+ *   Return Value: number of bytes read, 0 once caught up
+ *   Function: Copies finished log text. If *pos has been written
+ *             over it starts instead at the first whole line still
+ *             in the log. */
+int32_t klog_read( uint32_t* pos, uint8_t* buf, int32_t nbytes )
+{
+    uint32_t start;
+    uint32_t end;
+    uint32_t count;
+    uint32_t i;
+
+    if( nbytes <= 0 )
+    {
+        return 0;
+    }
+
+    do
+    {
+        start = *pos;
+        end = klog_committed;
+
+        /* Reserved space that isn't committed yet is already being */
+        /* written over the oldest text.                            */
+        if( klog_head - start > KLOG_SIZE )
+        {
+            start = klog_head - KLOG_SIZE;
+            while( (int32_t)( end - start ) > 0 && klog_buf[ start & ( KLOG_SIZE - 1 ) ] != '\n' )
+            {
+                start++;
+            }
+            if( (int32_t)( end - start ) > 0 )
+            {
+                start++;
+            }
+        }
+
+        count = ( (int32_t)( end - start ) > 0 ) ? end - start : 0;
+        if( count > (uint32_t)nbytes )
+        {
+            count = nbytes;
+        }
+        for( i = 0; i < count; i++ )
+        {
+            buf[ i ] = klog_buf[ ( start + i ) & ( KLOG_SIZE - 1 ) ];
+        }
+
+        /* If a writer got to what we copied meanwhile, do it again */
+    } while( klog_head - start > KLOG_SIZE );
+
+    *pos = start + count;
+    return count;
+}
+
+/* void klog_flush();
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: Sends the log text nobody has seen yet to the serial
+ *             port and/or the displayed terminal. Only as much as
+ *             the serial queue has room for goes at once, so this
+ *             never waits; the rest goes on a later call. Called
+ *             when the CPU goes idle, never from a handler. */
+void klog_flush( void )
+{
+    uint8_t chunk[ KLOG_FLUSH_CHUNK ];
+    int32_t room = KLOG_FLUSH_CHUNK;
+    int32_t count;
+    int32_t i;
+
+#if KLOG_TO_SERIAL
+    /* Each byte may go out as two, for "\r\n" */
+    if( serial_present && serial_tx_room( ) / 2 < room )
+    {
+        room = serial_tx_room( ) / 2;
+    }
+#endif
+#if !KLOG_TO_CONSOLE
+    if( !serial_present || !KLOG_TO_SERIAL )
+    {
+        return;
+    }
+#endif
+
+    count = klog_read( &klog_flushed, chunk, room );
+    if( count == 0 )
+    {
+        return;
+    }
+
+#if KLOG_TO_SERIAL
+    for( i = 0; i < count; i++ )
+    {
+        serial_putc( chunk[ i ] );
+    }
+#endif
+#if KLOG_TO_CONSOLE
+    terminal_puts( display_terminal, chunk, count );
+    terminal_flush( display_terminal );
+#endif
+}
+
+/* int32_t dmesg_open(const uint8_t* filename);
+ *   Inputs: filename - unused
+ *   Return Value: 0
+ *   Function: Opens the log; reads start at the oldest text kept */
+int32_t dmesg_open( const uint8_t* filename )
+{
+    return 0;
+}
+
+/* int32_t dmesg_close(int32_t fd);
+ *   Inputs: fd - unused
+ *   Return Value: 0
+ *   Function: Closes the log */
+int32_t dmesg_close( int32_t fd )
+{
+    return 0;
+}
+
+/* int32_t dmesg_read(int32_t fd, void* buf, int32_t nbytes);
+ *   Inputs: fd - open "dmesg" file
+ *           buf - buffer to fill
+ *           nbytes - most bytes to read
+ *   Return Value: number of bytes read, 0 at the end of the log
+ *   Function: Reads the log on from the file's position */
+int32_t dmesg_read( int32_t fd, void* buf, int32_t nbytes )
+{
+    open_file_t* file = get_open_file( fd );
+
+    if( file == NULL || buf == NULL )
+    {
+        return -1;
+    }
+    return klog_read( &file->file_position, buf, nbytes );
+}
+
+/* int32_t dmesg_write(int32_t fd, const void* buf, int32_t nbytes);
+ *   Inputs: ignored
+ *   Return Value: -1
+ *   Function: The log can't be written through the file */
+int32_t dmesg_write( int32_t fd, const void* buf, int32_t nbytes )
+{
+    return -1;
+}
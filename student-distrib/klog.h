@@ -0,0 +1,37 @@
+/* klog.h - Kernel log ring, read back through the "dmesg" file
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _KLOG_H
+#define _KLOG_H
+
+#include "types.h"
+
+#define KLOG_SIZE           16384   /* Bytes of log kept. Must be a power of two.  */
+#define KLOG_LINE_MAX       160     /* Longest message; longer ones are cut short   */
+#define KLOG_FLUSH_CHUNK    256     /* Most bytes klog_flush sends at once          */
+#define MSEC_PER_SEC        1000
+
+/* Where klog_flush sends the log as it comes in. The console      */
+/* target prints into the displayed terminal like program output.  */
+#define KLOG_TO_SERIAL      1
+#define KLOG_TO_CONSOLE     0
+
+/* Adds a printf style message to the log, stamped with the time.  */
+/* Never waits, so it is fine in interrupt handlers.               */
+extern void klog( int8_t* format, ... );
+
+/* Copies log text from *pos on, moving *pos past what was copied. */
+extern int32_t klog_read( uint32_t* pos, uint8_t* buf, int32_t nbytes );
+
+/* Sends new log text to the serial port and/or console. Only call */
+/* this outside interrupt handlers.                                */
+extern void klog_flush( void );
+
+/* Device file operations for "dmesg" */
+extern int32_t dmesg_open( const uint8_t* filename );
+extern int32_t dmesg_close( int32_t fd );
+extern int32_t dmesg_read( int32_t fd, void* buf, int32_t nbytes );
+extern int32_t dmesg_write( int32_t fd, const void* buf, int32_t nbytes );
+
+#endif /* _KLOG_H */
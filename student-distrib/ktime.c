@@ -0,0 +1,94 @@
+/* ktime.c - TSC calibration, ktime_ns and the user-visible time page
+ * vim:ts=4 noexpandtab
+ */
+
+#include "ktime.h"
+#include "lib.h"
+#include "scheduling.h"
+
+uint32_t tsc_khz = 0;
+
+uint8_t time_page_frame[ KTIME_PAGE_SIZE ] __attribute__((aligned(KTIME_PAGE_SIZE)));
+time_page_t* const time_page = (time_page_t*)time_page_frame;
+
+/* Fails to compile if sysenter moves without user space knowing */
+typedef char time_page_sysenter_check[
+    ( __builtin_offsetof( time_page_t, sysenter ) == TIME_PAGE_SYSENTER_OFFSET ) ? 1 : -1 ];
+
+/* TSC value at boot, and nanoseconds per cycle << KTIME_SHIFT */
+static uint64_t tsc_boot;
+static uint32_t tsc_mult;
+
+/* void ktime_init( void );
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: Counts how many TSC cycles go by while PIT channel 2 counts
+ *             down KTIME_CALIBRATE_MS worth of PIT clocks, and works out
+ *             tsc_khz and the cycles to nanoseconds multiplier from that. */
+void ktime_init( void )
+{
+    uint64_t start;
+    uint64_t cycles;
+    uint32_t polls;
+    uint8_t  gate;
+
+    /* Gate channel 2 on with the speaker off, then start the count */
+    gate = inb( PIT_GATE_PORT );
+    outb( ( gate & ~PIT_SPEAKER_ENABLE ) | PIT_GATE_ENABLE, PIT_GATE_PORT );
+    outb( PIT_CH2_ONESHOT_VAL, PIT_COMMAND_REG );
+    outb( KTIME_CALIBRATE_COUNT & RELOAD_MASK_LOWER, PIT_CHANNEL_2 );
+    outb( ( KTIME_CALIBRATE_COUNT & RELOAD_MASK_UPPER ) >> RELOAD_UPPER_SHIFT, PIT_CHANNEL_2 );
+
+    start = rdtsc( );
+    for( polls = 0; polls < KTIME_CALIBRATE_POLLS; polls++ )
+    {
+        if( inb( PIT_GATE_PORT ) & PIT_OUT2_STATUS )
+        {
+            break;
+        }
+    }
+    cycles = rdtsc( ) - start;
+
+    /* Put the gate back the way we found it */
+    outb( gate, PIT_GATE_PORT );
+
+    tsc_boot = rdtsc( );
+    tsc_khz = 0;
+    if( polls < KTIME_CALIBRATE_POLLS )
+    {
+        tsc_khz = (uint32_t)div_u64_u32( cycles, KTIME_CALIBRATE_MS, NULL );
+    }
+    if( tsc_khz != 0 )
+    {
+        tsc_mult = (uint32_t)div_u64_u32( (uint64_t)NSEC_PER_MSEC << KTIME_SHIFT, tsc_khz, NULL );
+    }
+
+    /* Hand the same numbers to user space */
+    time_page->pit_hz      = pit_hz;
+    time_page->tsc_khz     = tsc_khz;
+    time_page->tsc_mult    = tsc_mult;
+    time_page->tsc_shift   = KTIME_SHIFT;
+    time_page->tsc_boot_lo = (uint32_t)tsc_boot;
+    time_page->tsc_boot_hi = (uint32_t)( tsc_boot >> 32 );
+}
+
+/* uint64_t ktime_ns( void );
+ *   Inputs: none
+ *   Return Value: nanoseconds since ktime_init
+ *   Function: Scales the cycles since boot by tsc_mult. The 64-bit cycle
+ *             count times the 32-bit multiplier doesn't fit in 64 bits, so
+ *             the high and low halves of the count are scaled separately.
+ *             Without a calibrated TSC, counts PIT ticks instead. */
+uint64_t ktime_ns( void )
+{
+    uint64_t cycles;
+
+    if( tsc_khz == 0 )
+    {
+        return (uint64_t)sched_ticks * ( NSEC_PER_SEC / pit_hz );
+    }
+
+    cycles = rdtsc( ) - tsc_boot;
+    return ( ( (uint64_t)(uint32_t)( cycles >> 32 ) * tsc_mult ) << ( 32 - KTIME_SHIFT ) ) +
+           ( ( (uint64_t)(uint32_t)cycles * tsc_mult ) >> KTIME_SHIFT );
+}
@@ -0,0 +1,77 @@
+/* ktime.h - High resolution time since boot, counted by the TSC
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _KTIME_H
+#define _KTIME_H
+
+#include "types.h"
+
+#define NSEC_PER_SEC            1000000000
+#define NSEC_PER_MSEC           1000000
+
+/* TSC cycles are turned into nanoseconds by multiplying by tsc_mult    */
+/* and shifting right by KTIME_SHIFT, which keeps the fraction of a     */
+/* nanosecond per cycle without any division.                           */
+#define KTIME_SHIFT             24
+
+#define KTIME_PAGE_SIZE         0x1000
+
+/* The TSC is calibrated at boot against PIT channel 2, which only      */
+/* drives the speaker, so channel 0 is left alone. Gating channel 2 on  */
+/* and giving it a count in Mode 0 raises OUT2 (bit 5 of port 0x61)     */
+/* once the count runs out.                                             */
+/* Channel 2 command: +-- 1 0 --+-- 1 1 --+-- 0 0 0 --+-- 0 --+         */
+#define PIT_CHANNEL_2           0x42
+#define PIT_CH2_ONESHOT_VAL     0xB0
+#define PIT_GATE_PORT           0x61
+#define PIT_GATE_ENABLE         0x01
+#define PIT_SPEAKER_ENABLE      0x02
+#define PIT_OUT2_STATUS         0x20
+
+/* Calibrate over 10ms, which is 1193182 / 100 PIT counts. If OUT2      */
+/* never comes up (no PIT channel 2), give up after this many polls.    */
+#define KTIME_CALIBRATE_MS      10
+#define KTIME_CALIBRATE_COUNT   11932
+#define KTIME_CALIBRATE_POLLS   10000000
+
+/* Kernel side of the read-only page every process sees at           */
+/* VIRT_TIME_PAGE. The kernel keeps it current, so user programs can    */
+/* read the time without making a system call. The layout is shared    */
+/* with ece391support.h and must not change without updating it.       */
+/* The user stubs also read sysenter at TIME_PAGE_SYSENTER_OFFSET.      */
+/* The counters are 32-bit, so they are always read whole.             */
+typedef struct time_page_t {
+    volatile uint32_t pit_ticks;    /* Same as sched_ticks                      */
+    volatile uint32_t pit_hz;       /* Rate pit_ticks counts at                 */
+    volatile uint32_t rtc_ticks;    /* RTC interrupts since boot                */
+    volatile uint32_t rtc_hz;       /* Rate the RTC is running at right now     */
+    uint32_t tsc_khz;               /* 0 if the TSC wasn't calibrated           */
+    uint32_t tsc_mult;              /* ns = cycles * tsc_mult >> tsc_shift      */
+    uint32_t tsc_shift;
+    uint32_t tsc_boot_lo;           /* TSC value that ns counts from            */
+    uint32_t tsc_boot_hi;
+    uint32_t sysenter;              /* 1 if the fast system call stubs may use  */
+                                    /* SYSENTER, 0 if they must use int $0x80   */
+} time_page_t;
+
+/* Offset of sysenter, the same as ECE391_TIME_PAGE_SYSENTER */
+#define TIME_PAGE_SYSENTER_OFFSET   36
+
+/* Backed by a whole page of its own, so nothing else is exposed to user */
+extern time_page_t* const time_page;
+
+/* Physical (and kernel virtual) address of the time page */
+extern uint8_t time_page_frame[];
+
+/* TSC frequency in kHz, or 0 if calibration failed and ktime_ns falls  */
+/* back to counting PIT ticks.                                          */
+extern uint32_t tsc_khz;
+
+/* Calibrates the TSC. Call once at boot with interrupts off. */
+void ktime_init( void );
+
+/* Nanoseconds since ktime_init, never goes backwards. */
+uint64_t ktime_ns( void );
+
+#endif /* _KTIME_H */
@@ -2,6 +2,7 @@
  * vim:ts=4 noexpandtab */
 
 #include "lib.h"
+#include "serial.h"
 
 #define VIDEO       0xB8000
 #define NUM_COLS    80
@@ -12,6 +13,15 @@ int screen_x;
 int screen_y;
 static char* video_mem = (char *)VIDEO;
 
+/* void set_video_mem(char* base);
+ * Inputs: char* base = start of the text memory that is on screen
+ * Return Value: none
+ * Function: Moves where printf draws, for when the screen has been
+ *           scrolled by moving the VGA start address */
+void set_video_mem(char* base) {
+    video_mem = base;
+}
+
 /* void clear(void);
  * Inputs: void
  * Return Value: none
@@ -24,6 +34,27 @@ void clear(void) {
     }
 }
 
+/* static void printf_out(uint8_t c, void* arg);
+ *   Inputs: c = character printf produced
+ *           arg = unused
+ *   Return Value: none
+ *   Function: Sends printf's output to the console */
+static void printf_out(uint8_t c, void* arg) {
+    putc(c);
+}
+
+/* static void format_puts(format_out_t out, void* arg, int8_t* s);
+ *   Inputs: out, arg = where the characters go
+ *           s = string to send
+ *   Return Value: none
+ *   Function: Sends a string through out, a character at a time */
+static void format_puts(format_out_t out, void* arg, int8_t* s) {
+    while (*s != '\0') {
+        out(*s, arg);
+        s++;
+    }
+}
+
 /* Standard printf().
  * Only supports the following format strings:
  * %%  - print a literal '%' character
@@ -43,13 +74,27 @@ void clear(void) {
  *       the "#" modifier to alter output. */
 int32_t printf(int8_t *format, ...) {
 
-    /* Pointer to the format string */
-    int8_t* buf = format;
-
     /* Stack pointer for the other parameters */
     int32_t* esp = (void *)&format;
     esp++;
 
+    return format_to(printf_out, NULL, format, esp);
+}
+
+/* int32_t format_to(format_out_t out, void* arg, int8_t* format, int32_t* esp);
+ *   Inputs: out = called with each character of output, and arg
+ *           format = printf format string
+ *           esp = first of the arguments the format string uses
+ *   Return Value: length of the format string
+ *   Function: Does the formatting for printf, handing the output
+ *             to out instead of printing it, so other places (the
+ *             kernel log) can format into their own buffers. Takes
+ *             the same format strings as printf. */
+int32_t format_to(format_out_t out, void* arg, int8_t* format, int32_t* esp) {
+
+    /* Pointer to the format string */
+    int8_t* buf = format;
+
     while (*buf != '\0') {
         switch (*buf) {
             case '%':
@@ -62,7 +107,7 @@ format_char_switch:
                     switch (*buf) {
                         /* Print a literal '%' character */
                         case '%':
-                            putc('%');
+                            out('%', arg);
                             break;
 
                         /* Use alternate formatting */
@@ -80,7 +125,7 @@ format_char_switch:
                                 int8_t conv_buf[64];
                                 if (alternate == 0) {
                                     itoa(*((uint32_t *)esp), conv_buf, 16);
-                                    puts(conv_buf);
+                                    format_puts(out, arg, conv_buf);
                                 } else {
                                     int32_t starting_index;
                                     int32_t i;
@@ -90,7 +135,7 @@ format_char_switch:
                                         conv_buf[i] = '0';
                                         i++;
                                     }
-                                    puts(&conv_buf[starting_index]);
+                                    format_puts(out, arg, &conv_buf[starting_index]);
                                 }
                                 esp++;
                             }
@@ -101,7 +146,7 @@ format_char_switch:
                             {
                                 int8_t conv_buf[36];
                                 itoa(*((uint32_t *)esp), conv_buf, 10);
-                                puts(conv_buf);
+                                format_puts(out, arg, conv_buf);
                                 esp++;
                             }
                             break;
@@ -117,20 +162,20 @@ format_char_switch:
                                 } else {
                                     itoa(value, conv_buf, 10);
                                 }
-                                puts(conv_buf);
+                                format_puts(out, arg, conv_buf);
                                 esp++;
                             }
                             break;
 
                         /* Print a single character */
                         case 'c':
-                            putc((uint8_t) *((int32_t *)esp));
+                            out((uint8_t) *((int32_t *)esp), arg);
                             esp++;
                             break;
 
                         /* Print a NULL-terminated string */
                         case 's':
-                            puts(*((int8_t **)esp));
+                            format_puts(out, arg, *((int8_t **)esp));
                             esp++;
                             break;
 
@@ -142,7 +187,7 @@ format_char_switch:
                 break;
 
             default:
-                putc(*buf);
+                out(*buf, arg);
                 break;
         }
         buf++;
@@ -166,8 +211,12 @@ int32_t puts(int8_t* s) {
 /* void putc(uint8_t c);
  * Inputs: uint_8* c = character to print
  * Return Value: void
- *  Function: Output a character to the console */
+ *  Function: Output a character to the console, and to COM1 as well
+ *            when SERIAL_MIRROR_PRINTF is set */
 void putc(uint8_t c) {
+#if SERIAL_MIRROR_PRINTF
+    serial_putc(c);
+#endif
     if(c == '\n' || c == '\r') {
         screen_y = (screen_y + 1) % NUM_ROWS;
         screen_x = 0;
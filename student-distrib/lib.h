@@ -16,12 +16,17 @@ extern int screen_y;
 /* in the header file, and were subsequently defined by the     */
 /* team.                                                        */
 int32_t printf(int8_t *format, ...);
+
+/* Receives the output of format_to a character at a time */
+typedef void (*format_out_t)(uint8_t c, void* arg);
+int32_t format_to(format_out_t out, void* arg, int8_t* format, int32_t* esp);
 void putc(uint8_t c);
 int32_t puts(int8_t *s);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 int8_t *strrev(int8_t* s);
 uint32_t strlen(const int8_t* s);
 void clear(void);
+void set_video_mem(char* base);
 
 void* memset(void* s, int32_t c, uint32_t n);
 void* memset_word(void* s, int32_t c, uint32_t n);
@@ -81,6 +86,38 @@ static inline uint32_t inl(port) {
     return val;
 }
 
+/* Reads the 64-bit time-stamp counter. Used to measure how many
+ * cycles a piece of kernel code takes */
+static inline uint64_t rdtsc(void) {
+    uint64_t val;
+    asm volatile ("rdtsc"
+            : "=A"(val)
+            :
+            : "memory"
+    );
+    return val;
+}
+
+/* Divides a 64-bit number by a 32-bit one. There is no libgcc to
+ * do 64-bit division for us, so split it into two divl's: the high
+ * half first, then the remainder with the low half. The second can't
+ * overflow since the remainder is always less than the divisor. The
+ * remainder is stored in *rem if rem isn't NULL */
+static inline uint64_t div_u64_u32(uint64_t dividend, uint32_t divisor, uint32_t* rem) {
+    uint32_t high = (uint32_t)(dividend >> 32);
+    uint32_t q_high = high / divisor;
+    uint32_t q_low;
+    uint32_t r = high % divisor;
+    asm ("divl %4"
+            : "=a"(q_low), "=d"(r)
+            : "a"((uint32_t)dividend), "d"(r), "rm"(divisor)
+    );
+    if (rem != NULL) {
+        *rem = r;
+    }
+    return ((uint64_t)q_high << 32) | q_low;
+}
+
 /* Writes a byte to a port */
 #define outb(data, port)                \
 do {                                    \
@@ -1,12 +1,15 @@
 #include "lib.h"
 #include "paging.h"
 #include "types.h"
+#include "ktime.h"
+#include "frame.h"
+#include "process.h"
 
 /* Define as "1" for CP5. Define as "0" for else.               */
 #define CP5 1
 #if CP5
     #define ALT_VID_PAGE_START  0xB8
-    #define NUM_ALT_VID_PAGES   5
+    #define NUM_ALT_VID_PAGES   8       /* The whole 32KB VGA text window */
 #endif
 
 
@@ -77,15 +80,18 @@ void page_init( void ) {
         page_table[i].available_3          = 0;
         page_table[i].virtual_address      = i;
 
-        /* Sets the video memory section to be present */
+        /* Sets the video memory section to be present. It is the same */
+        /* page in every process, so it is global.                     */
         if (i << SHIFT_12_VIRTUAL_ADDR == VIDEO_MEM_START_ADDR) {
             page_table[i].present = 1;
+            page_table[i].global  = 1;
         }        
     }  
 
     #if CP5
-        /* CP3.5: Sets the pages for Video Memory. Sets pages for   */
-        /* B8, B9, BA, BB, BC for alternative video memory storage. */
+        /* CP3.5: Sets the pages for Video Memory. Maps B8 through  */
+        /* BF, the whole text window, which the displayed terminal  */
+        /* scrolls through by moving the VGA start address.         */
         for( i = ALT_VID_PAGE_START; i < ALT_VID_PAGE_START + NUM_ALT_VID_PAGES; i++ )
         {
             page_table[i].present              = 1;
@@ -96,13 +102,39 @@ void page_init( void ) {
             page_table[i].accessed             = 0;
             page_table[i].dirty                = 0;
             page_table[i].page_attribute_table = 0;
-            page_table[i].global               = 0;
+            page_table[i].global               = 1;
             page_table[i].available_3          = 0;
             page_table[i].virtual_address      = i;
         }
     #endif
 
-    
+    /* Maps the time page read-only into every process, next to where  */
+    /* vidmap puts video memory. The kernel writes it through its own   */
+    /* mapping of the kernel 4MB page. The vidmap page in the same      */
+    /* table stays not present unless the running process called it.   */
+    i = VIRT_TIME_PAGE >> PDE_SHIFT;
+    page_directory[i].present         = 1;
+    page_directory[i].user_supervisor = 1;
+    page_directory[i].page_size       = 0;
+    page_directory[i].global          = 0;
+    page_directory[i].virtual_address = ( (uint32_t) vid_page_table ) >> SHIFT_12_VIRTUAL_ADDR;
+
+    i = ( VIRT_TIME_PAGE >> SHIFT_12_VIRTUAL_ADDR ) & PTE_INDEX_MASK;
+    vid_page_table[i].present         = 1;
+    vid_page_table[i].read_write      = 0;
+    vid_page_table[i].user_supervisor = 1;
+    vid_page_table[i].global          = 1;
+    vid_page_table[i].virtual_address = ( (uint32_t) time_page_frame ) >> SHIFT_12_VIRTUAL_ADDR;
+
+    /* The process area is the kernel's, so like the kernel page it is */
+    /* supervisor only and the same in every page directory. Its table */
+    /* starts out empty; slots are mapped as PIDs are handed out.      */
+    i = PROC_AREA_START >> PDE_SHIFT;
+    page_directory[i].present         = 1;
+    page_directory[i].page_size       = 0;
+    page_directory[i].virtual_address = ( (uint32_t) proc_area_table ) >> SHIFT_12_VIRTUAL_ADDR;
+    memset(proc_area_table, 0, sizeof(proc_area_table));
+
     loadPageDirectory((unsigned int*) page_directory);
     enablePaging();
 }
@@ -110,15 +142,16 @@ void page_init( void ) {
 /* void loadPageDirectory(unsigned int *arg);
  *   Inputs: unsigned int *arg --> A pointer to a given page directory
  *   Return Value: none
- *   Function: Loads a given page directory */
+ *   Function: Loads a given page directory. This drops every TLB entry
+ *             that isn't global. */
 void loadPageDirectory(unsigned int *arg) {
+    cr3 = (unsigned int) arg;
     asm volatile 
     (
-        "mov 8(%%esp), %%eax    ;"
-        "mov %%eax, %%cr3       ;"
-        : "=r"(cr3)
+        "mov %0, %%cr3          ;"
+        :
         : "r"(cr3)
-        : "%eax"
+        : "memory"
     );
     return;
 }
@@ -127,8 +160,15 @@ void loadPageDirectory(unsigned int *arg) {
  *   Inputs: none
  *   Return Value: none
  *   Function: Sets Bit 31 of CR0 and Bit 4 of CR4 to enable
- *             paging and specifically 4MB paging */
+ *             paging and specifically 4MB paging, then Bit 7 of
+ *             CR4 so global pages stay in the TLB across CR3 loads,
+ *             if the processor has them. Bit 16 of CR0 makes the
+ *             kernel fault on writes to read-only user pages, so a
+ *             system call writing into a shared page copies it like
+ *             the program writing it would. */
 void enablePaging( void ) {
+    uint32_t eax, ebx, ecx, edx;
+
     asm volatile 
     (
         "mov %%cr4, %%eax           ;"  /* eax <-- cr4, Stores cr4 in eax */
@@ -143,6 +183,17 @@ void enablePaging( void ) {
         "mov %%eax, %%cr0           ;"  /* cr0 <-- eax, Saves eax back into cr0 */ 
         : "=r"(cr0)
     );    
+    asm volatile( "mov %%cr0, %0" : "=r" ( cr0 ) );
+    cr0 |= CR0_WP;
+    asm volatile( "mov %0, %%cr0" : : "r" ( cr0 ) : "memory" );
+
+    eax = 1;
+    asm volatile( "cpuid" : "+a" ( eax ), "=b" ( ebx ), "=c" ( ecx ), "=d" ( edx ) );
+    if (edx & CPUID_PGE_BIT) {
+        asm volatile( "mov %%cr4, %0" : "=r" ( cr4 ) );
+        cr4 |= CR4_PGE;
+        asm volatile( "mov %0, %%cr4" : : "r" ( cr4 ) : "memory" );
+    }
     return;
 }
 
@@ -170,3 +221,147 @@ void flush_tlb( void )
 
 
 }
+
+/* void flush_tlb_entry( uint32_t addr );
+ *   Inputs: uint32_t addr --> Virtual address whose translation changed
+ *   Return Value: none
+ *   Function: Invalidates the TLB entry for one page with invlpg, so a
+ *             single remapped page does not cost a whole CR3 reload */
+void flush_tlb_entry( uint32_t addr )
+{
+    asm volatile( "invlpg (%0)" : : "r" (addr) : "memory" );
+}
+
+/* void user_page_table_reset( int32_t pid );
+ *   Inputs: int32_t pid --> Process whose user page table is reset
+ *   Return Value: none
+ *   Function: Drops the reference to the frame behind every present page,
+ *             which frees it unless the exec cache or another process
+ *             still has it, and leaves every entry not present, so the first
+ *             touch of each page traps into the page fault handler, which
+ *             allocates a new frame for it */
+void user_page_table_reset( int32_t pid )
+{
+    unsigned int i;
+    page_table_entry_t* table;
+
+    if (proc_slot_phys(pid) == 0) {
+        return;
+    }
+    table = proc_user_page_table(pid);
+
+    for(i = 0; i < NUM_PAGES; i++)
+    {
+        if (table[i].present) {
+            frame_put(table[i].virtual_address << SHIFT_12_VIRTUAL_ADDR);
+        }
+        table[i].present              = 0;
+        table[i].read_write           = 1;
+        table[i].user_supervisor      = 1;
+        table[i].write_through        = 0;
+        table[i].cache_disable        = 0;
+        table[i].accessed             = 0;
+        table[i].dirty                = 0;
+        table[i].page_attribute_table = 0;
+        table[i].global               = 0;
+        table[i].available_3          = 0;
+        table[i].virtual_address      = 0;
+    }
+}
+
+/* void user_page_table_share( int32_t parent, int32_t child );
+ *   Inputs: int32_t parent --> Process whose pages are shared
+ *           int32_t child --> Process given the same pages, with nothing
+ *                             present in its user page table yet
+ *   Return Value: none
+ *   Function: Maps every present page of the parent into the child at the
+ *             same address, and gives the child its own reference to each
+ *             frame. Pages the parent could write become read-only and
+ *             copy-on-write in both, so whichever one writes first gets a
+ *             copy from the page fault handler. The caller drops the
+ *             parent's TLB entries if it is running. */
+void user_page_table_share( int32_t parent, int32_t child )
+{
+    unsigned int i;
+    page_table_entry_t* parent_table;
+    page_table_entry_t* child_table;
+
+    if (proc_slot_phys(parent) == 0 || proc_slot_phys(child) == 0) {
+        return;
+    }
+    parent_table = proc_user_page_table(parent);
+    child_table = proc_user_page_table(child);
+
+    for(i = 0; i < NUM_PAGES; i++)
+    {
+        if (!parent_table[i].present) {
+            continue;
+        }
+        if (parent_table[i].read_write) {
+            parent_table[i].read_write   = 0;
+            parent_table[i].available_3 |= PTE_AVL_COW;
+        }
+        frame_get(parent_table[i].virtual_address << SHIFT_12_VIRTUAL_ADDR);
+        child_table[i] = parent_table[i];
+    }
+}
+
+/* void* kmap_window( uint32_t frame );
+ *   Inputs: uint32_t frame --> Physical address of a frame
+ *   Return Value: the address the kernel can reach the frame at
+ *   Function: Points the kernel's window page at the frame. The frames
+ *             the allocator hands out aren't otherwise mapped anywhere
+ *             the kernel can always see. */
+void* kmap_window( uint32_t frame )
+{
+    page_table_entry_t* pte = &page_table[(KMAP_WINDOW_ADDR >> SHIFT_12_VIRTUAL_ADDR) & PTE_INDEX_MASK];
+
+    pte->read_write      = 1;
+    pte->user_supervisor = 0;
+    pte->virtual_address = frame >> SHIFT_12_VIRTUAL_ADDR;
+    pte->present         = 1;
+    flush_tlb_entry(KMAP_WINDOW_ADDR);
+    return (void*)KMAP_WINDOW_ADDR;
+}
+
+/* void kunmap_window( void );
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: Takes the frame back out of the window */
+void kunmap_window( void )
+{
+    page_table[(KMAP_WINDOW_ADDR >> SHIFT_12_VIRTUAL_ADDR) & PTE_INDEX_MASK].present = 0;
+    flush_tlb_entry(KMAP_WINDOW_ADDR);
+}
+
+/* void process_page_directory_init( int32_t pid );
+ *   Inputs: int32_t pid --> Process whose page directory is built
+ *   Return Value: none
+ *   Function: Copies the kernel's page directory, which brings along the
+ *             kernel page, low memory and the vidmap/time page table, and
+ *             points the user page at the process's own 4kB page table.
+ *             Both live in the PID's slot in the process area, which
+ *             the kernel reaches at a different address than the one
+ *             the processor is given. */
+void process_page_directory_init( int32_t pid )
+{
+    page_directory_entry_t* directory;
+
+    if (proc_slot_phys(pid) == 0) {
+        return;
+    }
+    directory = proc_page_directory(pid);
+    memcpy(directory, page_directory, sizeof(page_directory));
+
+    directory[USER_PAGE].present         = 1;
+    directory[USER_PAGE].read_write      = 1;
+    directory[USER_PAGE].user_supervisor = 1;
+    directory[USER_PAGE].write_through   = 0;
+    directory[USER_PAGE].cache_disable   = 0;
+    directory[USER_PAGE].accessed        = 0;
+    directory[USER_PAGE].available_1     = 0;
+    directory[USER_PAGE].page_size       = 0;
+    directory[USER_PAGE].global          = 0;
+    directory[USER_PAGE].available_3     = 0;
+    directory[USER_PAGE].virtual_address = ( proc_slot_phys(pid) + PROC_TABLE_OFFSET ) >> SHIFT_12_VIRTUAL_ADDR;
+}
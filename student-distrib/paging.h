@@ -1,6 +1,8 @@
 #ifndef _PAGING_H
 #define _PAGING_H
 
+#include "types.h"
+
 #define NUM_PAGES               1024
 #define STRUCT_SIZE             4
 #define SHIFT_12_VIRTUAL_ADDR   12
@@ -9,6 +11,40 @@
 #define VIDEO_MEM_BG_START_ADDR 0xB9000
 #define KERNEL_START_ADDR       0x400000
 #define USER_START_ADDR         0x8000000
+#define USER_END_ADDR           0x8400000
+#define PAGE_FRAME_MASK         0xFFFFF000
+
+/* Kernel only 4MB just above the kernel page holding each process's  */
+/* PCB, kernel stack and page tables. See process.h.                  */
+#define PROC_AREA_START         0x00800000
+#define PROC_AREA_END           0x00C00000
+
+/* The last page of the low 4MB, where the kernel maps a frame for a   */
+/* moment to fill it or copy out of it                                 */
+#define KMAP_WINDOW_ADDR        0x003FF000
+
+/* Kept in available_3 of a user page table entry. The page is mapped  */
+/* read-only because it is shared, and the first write to it gets the  */
+/* process its own copy.                                               */
+#define PTE_AVL_COW             0x1
+
+/* The read-only time page sits in the same 4MB as the vidmap page     */
+/* (VIRT_VID_MEM, 136MB), one page after it, so both share              */
+/* vid_page_table.                                                      */
+#define VIRT_TIME_PAGE          0x08801000
+#define PDE_SHIFT               22
+#define PTE_INDEX_MASK          0x3FF
+
+/* Page fault error code bits pushed by the processor */
+#define PF_ERR_PRESENT          0x1   /* Set --> protection violation, clear --> page not present */
+#define PF_ERR_WRITE            0x2   /* Set --> fault was caused by a write                      */
+#define PF_ERR_USER             0x4   /* Set --> fault happened while in user mode                */
+
+/* CR4 bits and the CPUID feature flag for global pages */
+#define CR4_PSE                 0x00000010    /* 4MB pages                                      */
+#define CR4_PGE                 0x00000080    /* Global pages survive a CR3 load                */
+#define CR0_WP                  0x00010000    /* The kernel can't write read-only pages either  */
+#define CPUID_PGE_BIT           0x00002000
 
 /* Defining the page directory entry struct */
 typedef struct __attribute__((packed)) page_directory_entry_t {
@@ -44,6 +80,11 @@ page_directory_entry_t page_directory[NUM_PAGES] __attribute__((aligned(4096)));
 page_table_entry_t page_table[NUM_PAGES] __attribute__((aligned(4096))); 
 page_table_entry_t vid_page_table[NUM_PAGES] __attribute__((aligned(4096))); 
 
+/* Maps the process area. Entries are filled in by process.c as each  */
+/* PID's slot is first used, and every page directory shares the table */
+/* so a new slot shows up in all of them at once.                      */
+page_table_entry_t proc_area_table[NUM_PAGES] __attribute__((aligned(4096)));
+
 /* Called by kernel.c initializes page tables and directory */
 extern void page_init( void );
 
@@ -56,4 +97,21 @@ extern void enablePaging( void );
 /* Clears the tlb by reloading Directory Base Address into register CR3 */
 extern void flush_tlb( void );
 
+/* Drops the TLB entry for a single virtual address */
+extern void flush_tlb_entry( uint32_t addr );
+
+/* Frees every page a process's user page table maps and marks them not present */
+extern void user_page_table_reset( int32_t pid );
+
+/* Maps a process's pages into another, copy-on-write, for fork */
+extern void user_page_table_share( int32_t parent, int32_t child );
+
+/* Maps a frame at KMAP_WINDOW_ADDR until kunmap_window. Interrupts must */
+/* stay off in between, since there is only the one window.             */
+extern void* kmap_window( uint32_t frame );
+extern void kunmap_window( void );
+
+/* Builds a process's page directory from the kernel's and its user page table */
+extern void process_page_directory_init( int32_t pid );
+
 #endif /* PAGING_H */
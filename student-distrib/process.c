@@ -0,0 +1,214 @@
+/* process.c - PID bitmap and the pool of per-process kernel slots
+ * vim:ts=4 noexpandtab
+ */
+
+#include "process.h"
+#include "lib.h"
+#include "frame.h"
+#include "klog.h"
+
+#define PID_MAP_FULL            0xFFFFFFFF
+
+/* Bit n of the map is set while PID n is handed out. The lowest     */
+/* free PID is found a word at a time, so even with every PID taken  */
+/* pid_alloc only looks at PID_MAP_WORDS words.                      */
+static uint32_t pid_map[ PID_MAP_WORDS ];
+
+/* Physical address of each PID's slot, 0 until it is first used.    */
+/* Slots are never given back to the frame allocator, so a PID that  */
+/* is freed and handed out again gets its old, already mapped slot.  */
+static uint32_t proc_slot_base[ PROC_MAX ];
+
+static proc_stats_t proc_stats;
+
+/* static int32_t proc_slot_back(int32_t pid);
+ *   Inputs: pid - PID whose slot is needed
+ *   Return Value: 1 if the slot has frames behind it, 0 if none were free
+ *   Function: Backs a slot the first time its PID is handed out with four
+ *             contiguous frames, maps them into the process area and
+ *             zeroes them, so the new user page table has nothing present.
+ *             The process area's page table is shared by every page
+ *             directory, so the slot shows up in all of them at once.
+ *             Interrupts must be off. */
+static int32_t proc_slot_back( int32_t pid )
+{
+    page_table_entry_t* pte;
+    uint32_t phys;
+    uint32_t i;
+
+    if( proc_slot_base[ pid ] )
+    {
+        return 1;
+    }
+
+    phys = frame_alloc( PROC_SLOT_ORDER );
+    if( phys == 0 )
+    {
+        klog( "pid_alloc: no memory for the slot of PID %d\n", pid );
+        return 0;
+    }
+
+    for( i = 0; i < PROC_SLOT_PAGES; i++ )
+    {
+        pte = &proc_area_table[ pid * PROC_SLOT_PAGES + i ];
+        pte->read_write      = 1;
+        pte->user_supervisor = 0;
+        pte->global          = 1;
+        pte->virtual_address = ( phys >> SHIFT_12_VIRTUAL_ADDR ) + i;
+        pte->present         = 1;
+    }
+    memset( (void*)PROC_SLOT( pid ), 0, PROC_SLOT_SIZE );
+
+    proc_slot_base[ pid ] = phys;
+    proc_stats.pooled++;
+    return 1;
+}
+
+/* int32_t pid_alloc();
+ *   Inputs: none
+ *   Return Value: the new PID, -1 if none could be handed out
+ *   Function: Takes the lowest free PID, backing its slot if it has never
+ *             been used */
+int32_t pid_alloc( void )
+{
+    uint32_t flags;
+    uint32_t word;
+    int32_t pid = -1;
+
+    cli_and_save( flags );
+    for( word = 0; word < PID_MAP_WORDS; word++ )
+    {
+        if( pid_map[ word ] != PID_MAP_FULL )
+        {
+            pid = word * PID_MAP_BITS + pid_map_ffs( ~pid_map[ word ] );
+            break;
+        }
+    }
+
+    if( pid < 0 || !proc_slot_back( pid ) )
+    {
+        proc_stats.failures++;
+        restore_flags( flags );
+        return -1;
+    }
+
+    pid_map[ word ] |= 1 << ( pid % PID_MAP_BITS );
+    proc_stats.allocs++;
+    proc_stats.in_use++;
+    if( proc_stats.in_use > proc_stats.peak )
+    {
+        proc_stats.peak = proc_stats.in_use;
+    }
+    restore_flags( flags );
+    return pid;
+}
+
+/* void pid_free(int32_t pid);
+ *   Inputs: pid - PID to give back
+ *   Return Value: none
+ *   Function: Marks the PID free. Its slot stays mapped, and whoever is
+ *             running on its kernel stack can go on using it until they
+ *             switch away. */
+void pid_free( int32_t pid )
+{
+    uint32_t flags;
+
+    if( !pid_in_use( pid ) )
+    {
+        return;
+    }
+
+    cli_and_save( flags );
+    pid_map[ pid / PID_MAP_BITS ] &= ~( 1 << ( pid % PID_MAP_BITS ) );
+    proc_stats.in_use--;
+    restore_flags( flags );
+}
+
+/* int32_t pid_in_use(int32_t pid);
+ *   Inputs: pid - PID to look up
+ *   Return Value: 1 if it is handed out, 0 if not or out of range */
+int32_t pid_in_use( int32_t pid )
+{
+    if( pid < 0 || pid >= PROC_MAX )
+    {
+        return 0;
+    }
+    return ( pid_map[ pid / PID_MAP_BITS ] >> ( pid % PID_MAP_BITS ) ) & 1;
+}
+
+/* int32_t pid_next(int32_t pid);
+ *   Inputs: pid - where to start looking
+ *   Return Value: the first PID in use at or after pid, -1 if none
+ *   Function: Walks the map a word at a time, for looping over every
+ *             process without checking each PID */
+int32_t pid_next( int32_t pid )
+{
+    uint32_t word;
+    uint32_t bits;
+
+    if( pid < 0 )
+    {
+        pid = 0;
+    }
+
+    while( pid < PROC_MAX )
+    {
+        word = pid / PID_MAP_BITS;
+        bits = pid_map[ word ] & ( PID_MAP_FULL << ( pid % PID_MAP_BITS ) );
+        if( bits )
+        {
+            return word * PID_MAP_BITS + pid_map_ffs( bits );
+        }
+        pid = ( word + 1 ) * PID_MAP_BITS;
+    }
+    return -1;
+}
+
+/* uint32_t proc_slot_phys(int32_t pid);
+ *   Inputs: pid - PID to look up
+ *   Return Value: physical address of its slot, 0 if it was never backed */
+uint32_t proc_slot_phys( int32_t pid )
+{
+    if( pid < 0 || pid >= PROC_MAX )
+    {
+        return 0;
+    }
+    return proc_slot_base[ pid ];
+}
+
+/* uint32_t proc_kernel_stack(int32_t pid);
+ *   Inputs: pid - PID to look up
+ *   Return Value: the address just past the top of its kernel stack */
+uint32_t proc_kernel_stack( int32_t pid )
+{
+    return PROC_SLOT( pid ) + PROC_KSTACK_SIZE;
+}
+
+/* page_directory_entry_t* proc_page_directory(int32_t pid);
+ *   Inputs: pid - PID to look up
+ *   Return Value: its page directory, as the kernel sees it */
+page_directory_entry_t* proc_page_directory( int32_t pid )
+{
+    return (page_directory_entry_t*)( PROC_SLOT( pid ) + PROC_DIR_OFFSET );
+}
+
+/* page_table_entry_t* proc_user_page_table(int32_t pid);
+ *   Inputs: pid - PID to look up
+ *   Return Value: the page table of its 4MB user page, as the kernel
+ *                 sees it */
+page_table_entry_t* proc_user_page_table( int32_t pid )
+{
+    return (page_table_entry_t*)( PROC_SLOT( pid ) + PROC_TABLE_OFFSET );
+}
+
+/* void proc_get_stats(proc_stats_t* stats);
+ *   Inputs: stats - where to copy the counters
+ *   Return Value: none */
+void proc_get_stats( proc_stats_t* stats )
+{
+    uint32_t flags;
+
+    cli_and_save( flags );
+    *stats = proc_stats;
+    restore_flags( flags );
+}
@@ -0,0 +1,75 @@
+/* process.h - PID bitmap and the pool of per-process kernel slots
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _PROCESS_H
+#define _PROCESS_H
+
+#include "types.h"
+#include "paging.h"
+
+/* Every PID has a 16kB slot in the process area, so PID n's PCB is at */
+/* PROC_AREA_START + n * PROC_SLOT_SIZE. The slots fill the 4MB area.  */
+#define PROC_MAX                ( ( PROC_AREA_END - PROC_AREA_START ) / PROC_SLOT_SIZE )
+#define PID_MAP_BITS            32
+#define PID_MAP_WORDS           ( PROC_MAX / PID_MAP_BITS )
+
+/* Layout of a slot. The PCB sits at the bottom of the first 8kB with  */
+/* the kernel stack growing down onto it from the top, as before. The  */
+/* page directory and the user page table each take a page after that. */
+#define PROC_SLOT_SIZE          0x4000
+#define PROC_SLOT_ORDER         2       /* 2^2 frames from frame_alloc  */
+#define PROC_SLOT_PAGES         4
+#define PROC_KSTACK_SIZE        0x2000
+#define PROC_DIR_OFFSET         0x2000
+#define PROC_TABLE_OFFSET       0x3000
+#define PROC_SLOT( pid )        ( PROC_AREA_START + (uint32_t)( pid ) * PROC_SLOT_SIZE )
+
+/* Slots start on a page, so no two PCBs ever share a cache line */
+#define CACHE_LINE_SIZE         64
+
+/* Counters for watching the pool */
+typedef struct proc_stats_t {
+    uint32_t in_use;                    /* PIDs handed out right now            */
+    uint32_t peak;                      /* Most PIDs ever in use at once        */
+    uint32_t pooled;                    /* Slots with frames behind them        */
+    uint32_t allocs;                    /* Successful pid_alloc calls           */
+    uint32_t failures;                  /* pid_alloc calls that found nothing   */
+} proc_stats_t;
+
+/* Index of the lowest set bit of a nonzero word */
+static inline uint32_t pid_map_ffs( uint32_t word )
+{
+    uint32_t bit;
+
+    asm( "bsfl %1, %0" : "=r" ( bit ) : "rm" ( word ) );
+    return bit;
+}
+
+/* Takes the lowest free PID and makes sure its slot is backed. -1 if  */
+/* every PID is taken or there is no memory for the slot.              */
+extern int32_t pid_alloc( void );
+
+/* Gives a PID back. Its slot stays backed for the next pid_alloc.     */
+extern void pid_free( int32_t pid );
+
+/* 1 if the PID is handed out, 0 if not */
+extern int32_t pid_in_use( int32_t pid );
+
+/* The first PID at or after pid that is in use, -1 if there is none   */
+extern int32_t pid_next( int32_t pid );
+
+/* Physical address of a PID's slot, 0 if it has never been backed     */
+extern uint32_t proc_slot_phys( int32_t pid );
+
+/* Top of a PID's kernel stack, for the TSS */
+extern uint32_t proc_kernel_stack( int32_t pid );
+
+/* A PID's page directory and user page table, through the process area */
+extern page_directory_entry_t* proc_page_directory( int32_t pid );
+extern page_table_entry_t* proc_user_page_table( int32_t pid );
+
+/* Copies the pool's counters */
+extern void proc_get_stats( proc_stats_t* stats );
+
+#endif /* _PROCESS_H */
@@ -7,6 +7,9 @@
 #include "lib.h"
 #include "types.h"
 #include "tests.h"
+#include "scheduling.h"
+#include "ktime.h"
+#include "file_system.h"
 
 /* Turn on Macro to test RTC */
 #define TEST_RTC 0
@@ -17,7 +20,17 @@
 *  Function: Initializes the RTC and maps to IRQ on PIC
 *   also ensures that periodic interrupts are allowed
 */
-volatile int rtc_interrupt_occured;
+wait_queue_t rtc_wait_queue = { "rtc read" };          /* Set up here, before anything can read    */
+
+/* Every open rtc file ticks at its own rate. The chip runs at the  */
+/* fastest rate any file asked for, and rtc_vtime counts 1024ths of */
+/* a second, moving by a whole hardware period each interrupt. A    */
+/* file with divider d ticks whenever rtc_vtime reaches a multiple  */
+/* of d, so files never change each other's rates.                  */
+static uint32_t rtc_rate_users[RTC_NUM_RATES];         /* Open files at each rate, 2 Hz first      */
+static volatile uint32_t rtc_vtime = 0;
+static volatile uint32_t rtc_wake_at = 0;              /* Earliest tick anyone is asleep for       */
+static volatile int32_t rtc_wake_pending = 0;          /* Set while rtc_wake_at means something    */
 
 int rtc_init(){
     /* Turning on periodic interrupts (from https://wiki.osdev.org/RTC)                             */    
@@ -33,6 +46,7 @@ int rtc_init(){
     prev = prev | HZ_RATE_2;                                /* Set the bottom 4 bits to 0x0F = 2Hz  */ 
     outb((DISABLE_NMI | REGISTER_A), RTC_PORT);             /* Select register A                    */
     outb(prev, CMOS_PORT);                                  /* Write the bits to the memory         */
+    time_page->rtc_hz = 2;                                  /* Let user space know the rate         */
     enable_irq(RTC_IRQ_NUM);                                /* Unmask the IRQ input                 */
     return 1;                     
 }
@@ -55,7 +69,15 @@ void rtc_handler(){
     #endif
     
     send_eoi(RTC_IRQ_NUM);                              /* Send eoi signal                                          */
-    rtc_interrupt_occured = 1;                          /* Set the interrupt flag for the read command              */                                      
+    time_page->rtc_ticks++;                             /* Count it where user space can see it                     */                                      
+    rtc_vtime += RTC_MAX_HZ / time_page->rtc_hz;        /* Move virtual time on by one hardware period              */
+
+    /* Only wake the readers once one of them is due, not every interrupt                                           */
+    if (rtc_wake_pending && (int32_t)(rtc_vtime - rtc_wake_at) >= 0){
+        rtc_wake_pending = 0;
+        wake_up(&rtc_wait_queue);                       /* Wake up anything sleeping in rtc_read                    */
+    }
+    scheduler_preempt();                                /* Run the reader now if it outranks the current process    */
     sti();
 }
 
@@ -99,61 +121,148 @@ int rtc_set_freq(uint32_t rate){
         prev = prev | new_freq;                         /* Set the bottom 4 bits to 0x0F = 2Hz                      */ 
         outb((DISABLE_NMI | REGISTER_A), RTC_PORT);     /* Select register A                                        */
         outb(prev, CMOS_PORT);                          /* Write the bits to the memory                             */
+        time_page->rtc_hz = rate;                       /* Let user space know the new rate                         */
         return 1;                                       /* Return value is used for test cases                      */
     }
 }
 
+/* static int rtc_rate_index(uint32_t rate);
+*  Inputs: rate in Hz
+*  Return Value: index into rtc_rate_users, -1 if the rate isn't allowed
+*  Function: Maps 2, 4, ... 1024 Hz to 0, 1, ... 9
+*/
+static int rtc_rate_index(uint32_t rate){
+    int i;
+    for (i = 0; i < RTC_NUM_RATES; i++){
+        if (rate == (RTC_MIN_HZ << i)){
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* static void rtc_set_users(open_file_t* file, uint32_t rate);
+*  Inputs: file: the open rtc file
+*          rate: its new rate in Hz, 0 to go back to the default
+*  Return Value: None
+*  Function: Moves a file from its old rate to a new one, then runs the
+*            chip at the fastest rate still wanted, or 2 Hz if none is.
+*            Interrupts must be off.
+*/
+static void rtc_set_users(open_file_t* file, uint32_t rate){
+    int i;
+
+    if (file->rtc_divider != 0){
+        rtc_rate_users[rtc_rate_index(RTC_MAX_HZ / file->rtc_divider)]--;
+    }
+    file->rtc_divider = 0;
+    if (rate != 0){
+        rtc_rate_users[rtc_rate_index(rate)]++;
+        file->rtc_divider = RTC_MAX_HZ / rate;
+    }
+
+    for (i = RTC_NUM_RATES - 1; i > 0 && rtc_rate_users[i] == 0; i--);
+    if (time_page->rtc_hz != (RTC_MIN_HZ << i)){
+        rtc_set_freq(RTC_MIN_HZ << i);                  /* Only touch the chip when the rate really changes             */
+    }
+}
+
 /* int32_t rtc_open(const uint8_t* filename);
 *  Inputs: the filename that we are opening  
-*  Return Value: always 0
-*  Function: Opens the rtc and initializes the clock to 2Hz
+*  Return Value: 0, or -1 for a NULL name
+*  Function: Opens the rtc. The new file ticks at 2 Hz, which the chip
+*            never runs slower than, so other files aren't disturbed
 */
 int32_t rtc_open(const uint8_t* filename){
     if (filename == NULL){                              /* If the file is NULL then just return -1                      */
         return -1;
     }
-    rtc_init();                                         /* Just have to init the RTC, sets rate to 2Hz and enable irq   */
+    enable_irq(RTC_IRQ_NUM);                            /* Make sure the interrupts are on, the rate is left alone      */
     return 0;                                           /* Return 0 on success                                          */
 }
 
 /* int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes);
 *  Inputs: fd, buf, and nbytes  
 *  Return Value: always 0
-*  Function: Reads the state of the RTC and returns when an interrupt has occured
+*  Function: Sleeps until the next tick at this file's rate. Other files
+*            ticking faster don't wake it early.
 */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes){
-    while (!rtc_interrupt_occured) {}                   /* While loop to wait for next interrupt                        */
-    rtc_interrupt_occured = 0;                          /* Reset the flag back to 0                                     */
+    open_file_t* file = get_open_file(fd);
+    uint32_t divider = RTC_DEFAULT_DIVIDER;
+    uint32_t next;
+    uint32_t flags;
+
+    if (file != NULL && file->rtc_divider != 0){
+        divider = file->rtc_divider;
+    }
+
+    cli_and_save(flags);
+    next = (rtc_vtime & ~(divider - 1)) + divider;      /* Only a tick after the call counts                            */
+    while ((int32_t)(rtc_vtime - next) < 0){
+        if (!rtc_wake_pending || (int32_t)(next - rtc_wake_at) < 0){
+            rtc_wake_at = next;                         /* Have the handler wake us in time for our tick                */
+            rtc_wake_pending = 1;
+        }
+        wait_queue_sleep(&rtc_wait_queue);
+    }
+    restore_flags(flags);
     return 0;                                           /* Should alwauys return zero as specified in documentation     */
 }
 
 /* int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes);
 *  Inputs: fd, buf, and nbytes  
 *  Return Value: 0 on success, -1 on failure
-*  Function: Set the interrupt rte of the RTC to the number specified by the buffer
+*  Function: Sets this file's rate to the number in the buffer. The chip
+*            speeds up if this is the fastest rate anyone wants.
 */
 int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes){
+    open_file_t* file = get_open_file(fd);
+    uint32_t flags;
+
     /* The buffer will contain the 4 bytes that we will use to set the clock rate */
-    /* Intial check to make sure argument for set_freq is correct                 */
-    /* All other checks for a correct clock value is in rtc_set_freq              */
-    if (buf == NULL){
+    if (buf == NULL || file == NULL){
         return -1;
     }
-    if (nbytes != 4){
+    if (nbytes != 4 || rtc_rate_index(*((uint32_t*)buf)) < 0){
         return -1;
     }
-    cli();                                              /* Block interrupts when writing to RTC (from doc)              */
-    rtc_set_freq( *(( uint32_t *)buf) );                /* Pass the uint32_t from the buffer as the arg for the set_freq*/
-    sti();                                              /* Allow interrupts again (from doc)                            */
+    cli_and_save(flags);                                /* Block interrupts when writing to RTC (from doc)              */
+    rtc_set_users(file, *((uint32_t*)buf));
+    restore_flags(flags);                               /* Allow interrupts again (from doc)                            */
     return 0;                                           /* Return 0 on success                                          */
 }
 
 /* int32_t rtc_close(int32_t fd);
 *  Inputs: fd  
 *  Return Value: 0 always
-*  Function: Does not do anything just returns 0
+*  Function: Forgets this file's rate, slowing the chip down if nobody
+*            else needs it as fast
 */
 int32_t rtc_close(int32_t fd){
-    rtc_set_freq(HZ_RATE_2);                            /* Set the interrupt rate back to 0                             */
+    open_file_t* file = get_open_file(fd);
+    uint32_t flags;
+
+    if (file != NULL){
+        cli_and_save(flags);
+        rtc_set_users(file, 0);
+        restore_flags(flags);
+    }
     return 0;                                           /* Return 0 on success                                          */
 }
+
+/* void rtc_file_dup(open_file_t* file);
+*  Inputs: file: the child's copy of an open rtc file
+*  Return Value: None
+*  Function: Counts the copy fork made as one more user of the file's
+*            rate, so that closing both doesn't leave the count short
+*/
+void rtc_file_dup(open_file_t* file){
+    uint32_t flags;
+
+    if (file->rtc_divider != 0){
+        cli_and_save(flags);
+        rtc_rate_users[rtc_rate_index(RTC_MAX_HZ / file->rtc_divider)]++;
+        restore_flags(flags);
+    }
+}
@@ -9,6 +9,8 @@
 // Files to include
 #include "types.h"
 #include "lib.h"
+#include "wait_queue.h"
+#include "file_system.h"
 
 /*Four registers in the RTC avaliable
 * Below is a description of each and the functionality of each bit in the register 
@@ -124,6 +126,13 @@
 #define HZ_RATE_2                       0x0F
 #define HZ_RATE_1024                    0x06   
 #define POWER_2_MASK                    0x0001  
+#define RTC_MIN_HZ                      2
+#define RTC_MAX_HZ                      1024
+#define RTC_NUM_RATES                   10      /* Powers of two from RTC_MIN_HZ to RTC_MAX_HZ  */
+#define RTC_DEFAULT_DIVIDER             ( RTC_MAX_HZ / RTC_MIN_HZ )
+
+/* rtc_read sleeps here until the next periodic interrupt */
+extern wait_queue_t rtc_wait_queue;
 
 /* Initilize the rtc device, map to PIC, and enable interrupts */
 int rtc_init();
@@ -134,16 +143,19 @@ void rtc_handler();
 /* Function to set the frequency of the RTC */
 int rtc_set_freq(uint32_t rate);
 
-/* Initalizes the rtc when a file is open to 2 Hz */
+/* Opens the rtc. Each open file ticks at 2 Hz until it is written */
 int32_t rtc_open(const uint8_t* filename);
 
-/* Reads the state of the RTC when an interrupt occurs */
+/* Waits for the next tick at the rate of this file */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes);
 
-/* Writes a new periodic interrupt value to the rtc from a buffer */
+/* Sets the rate of this file, speeding up the hardware if needed */
 int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes);
 
-/* Resets the value of the periodic intterrupt when a file is closed */
+/* Drops this file's rate, slowing the hardware if nobody needs it */
 int32_t rtc_close(int32_t fd);
 
+/* Counts a copy of an open file, made by fork, as using its rate too */
+void rtc_file_dup(open_file_t* file);
+
 #endif
@@ -3,10 +3,36 @@
 #include "terminal.h"
 #include "syscall.h"
 #include "paging.h"
+#include "ktime.h"
+#include "klog.h"
 
 int32_t curr_pid;
 uint32_t startUpInitialized = 0;
 
+/* Time slice of each MLFQ level, in PIT ticks          */
+static const uint32_t sched_slice[SCHED_LEVELS] = { 1, 2, 4, 8 };
+
+/* Ready processes waiting at each level                */
+static sched_queue_t run_queue[SCHED_LEVELS];
+
+/* PIT ticks since boot, and task switches made         */
+uint32_t sched_ticks = 0;
+uint32_t sched_switches = 0;
+static uint32_t sched_last_boost = 0;
+
+/* Timer setup. pit_oneshot_count is the count the PIT  */
+/* was started at for the current idle period, or 0 if  */
+/* it is ticking. pit_idle_counts keeps idle time that  */
+/* hasn't added up to a whole tick yet.                 */
+uint32_t pit_hz = PIT_DEFAULT_HZ;
+uint32_t tickless_enabled = 1;
+static uint32_t pit_reload;
+static uint32_t pit_running = 0;
+static uint32_t pit_oneshot_count = 0;
+static uint32_t pit_idle_counts = 0;
+uint32_t sched_idle_entries = 0;
+uint32_t sched_idle_ticks = 0;
+
 /*              General Notes about Scheduling              */
 /* 1) Need to support up to 3 terminals and use             */
 /*    ALT+F(1,2,3) to switch between the terminals can have */
@@ -43,6 +69,66 @@ uint32_t startUpInitialized = 0;
 /*                                                          */
 
 
+/* ----------------- PIT_PARSE_CMDLINE ---------------- */
+/* Reads the timer options off the multiboot command    */
+/* line, which is a list of space separated words:      */
+/*   hz=N       -> run the PIT at N Hz, clamped to      */
+/*                 PIT_MIN_HZ through PIT_MAX_HZ        */
+/*   notickless -> take every tick even when idle       */
+/* Anything else is left for other parts of the kernel. */
+/* Inputs:          cmdline -> the command line string  */
+/* Outputs:         None.                               */
+/* Side Effects:    Sets pit_hz and tickless_enabled    */
+void PIT_parse_cmdline( const int8_t* cmdline )
+{
+    uint32_t hz;
+
+    while (*cmdline != '\0') {
+        if (strncmp(cmdline, "hz=", 3) == 0) {
+            hz = 0;
+            for (cmdline += 3; *cmdline >= '0' && *cmdline <= '9'; cmdline++) {
+                hz = hz * 10 + (*cmdline - '0');
+            }
+            if (hz < PIT_MIN_HZ) {
+                hz = PIT_MIN_HZ;
+            } else if (hz > PIT_MAX_HZ) {
+                hz = PIT_MAX_HZ;
+            }
+            pit_hz = hz;
+        } else if (strncmp(cmdline, "notickless", 10) == 0 &&
+                   (cmdline[10] == ' ' || cmdline[10] == '\0')) {
+            tickless_enabled = 0;
+        }
+
+        /* Skip to the start of the next word */
+        while (*cmdline != ' ' && *cmdline != '\0') {
+            cmdline++;
+        }
+        while (*cmdline == ' ') {
+            cmdline++;
+        }
+    }
+}
+
+/* ------------------ PIT_SET_PERIODIC ---------------- */
+/* Puts channel 0 in square wave mode at pit_hz.        */
+/* Inputs:          None.                               */
+/* Outputs:         None.                               */
+/* Side Effects:    Reprograms the PIT                  */
+static void PIT_set_periodic( void )
+{
+    /* Set the PIT Command Register to Square Wave Mode */
+    /* to enable the PIT to generate Square Waves for   */
+    /* timings. Command register number located under   */
+    /* "I/O Ports" on osdev.org provided above.         */
+    outb( PIT_COMMAND_REG_VAL, PIT_COMMAND_REG );
+
+    /* Also set the frequency of channel 0 by setting   */
+    /* the high and low bytes of the channel.           */
+    outb( pit_reload & RELOAD_MASK_LOWER, CHANNEL_0 );
+    outb( ( pit_reload & RELOAD_MASK_UPPER ) >> RELOAD_UPPER_SHIFT, CHANNEL_0 );
+}
+
 /* --------------------- PIT_INIT --------------------- */
 /* Initializes the PIT (Programmable Interval Timer),   */
 /* enabling us to implement the scheduler. The PIT chip */
@@ -57,22 +143,107 @@ uint32_t startUpInitialized = 0;
 /*                  scheduling.                         */
 void PIT_init( void )
 {
-    /* Set the PIT Command Register to Square Wave Mode */
-    /* to enable the PIT to generate Square Waves for   */
-    /* timings. Command register number located under   */
-    /* "I/O Ports" on osdev.org provided above.         */
-    outb( PIT_COMMAND_REG_VAL, PIT_COMMAND_REG );
-
-    /* Also set the frequency of channel 0 by setting   */
-    /* the high and low bytes of the channel.           */
-    uint16_t reload = RELOAD_VAL;
-    outb( reload & RELOAD_MASK_LOWER, CHANNEL_0 );
-    outb( reload & RELOAD_MASK_UPPER, CHANNEL_0 );
+    pit_reload = ( PIT_BASE_FREQ + pit_hz / 2 ) / pit_hz;
+    PIT_set_periodic();
+    pit_running = 1;
 
     /* Now setup the PIT with PIC to enable interrupts  */
     enable_irq(PIT_IRQ_NUM);
 }
 
+/* ------------------- PIT_LEAVE_IDLE ----------------- */
+/* Puts the PIT back to ticking after an idle period,   */
+/* and adds the time spent idle to sched_ticks.         */
+/* Inputs:          expired -> 1 if called for the      */
+/*                  one-shot interrupt itself           */
+/* Outputs:         1 if we were idle, 0 if not         */
+/* Side Effects:    Reprograms the PIT                  */
+static int32_t PIT_leave_idle( int32_t expired )
+{
+    uint32_t remaining;
+    uint32_t ticks;
+
+    if (pit_oneshot_count == 0) {
+        return 0;
+    }
+
+    /* Latch the count so both bytes come from the same moment.     */
+    /* Once it hits zero the count wraps around and can't be told   */
+    /* apart from one still counting down, so whether the one-shot  */
+    /* went off is read from the PIC after the latch. If it did,    */
+    /* its IRQ is still to come and pit_handler counts that as a    */
+    /* tick, so leave one tick's worth out here.                    */
+    remaining = 0;
+    if (!expired) {
+        outb( PIT_LATCH_REG_VAL, PIT_COMMAND_REG );
+        remaining = inb( CHANNEL_0 );
+        remaining |= inb( CHANNEL_0 ) << RELOAD_UPPER_SHIFT;
+        if (irq_pending(PIT_IRQ_NUM)) {
+            remaining = pit_reload;
+        } else if (remaining > pit_oneshot_count) {
+            remaining = 0;
+        }
+    }
+
+    pit_idle_counts += pit_oneshot_count - remaining;
+    ticks = pit_idle_counts / pit_reload;
+    pit_idle_counts -= ticks * pit_reload;
+    sched_ticks += ticks;
+    sched_idle_ticks += ticks;
+    time_page->pit_ticks = sched_ticks;
+
+    pit_oneshot_count = 0;
+    PIT_set_periodic();
+    return 1;
+}
+
+/* ------------------ SCHEDULER_IDLE ------------------ */
+/* Halts until the next interrupt because nothing can   */
+/* run. Rather than waking every tick, the PIT is set   */
+/* to go off once, at the next deadline. There are no   */
+/* timed sleeps and no time slice is running, so the    */
+/* only deadline is starting the shells at boot; else   */
+/* we wait as long as the PIT can count, which keeps    */
+/* sched_ticks up to date. Must be called with          */
+/* interrupts off, and returns with them off. Kernel   */
+/* log text is sent out first, since nothing else      */
+/* wants the CPU.                                       */
+/* Inputs:          None.                               */
+/* Outputs:         None.                               */
+/* Side Effects:    Reprograms the PIT while idle       */
+void scheduler_idle( void )
+{
+    uint32_t count = PIT_MAX_COUNT;
+    int32_t i;
+
+    klog_flush();
+
+    if (!pit_running || !tickless_enabled) {
+        asm volatile( "sti; hlt; cli" : : : "memory" );
+        return;
+    }
+
+    for (i = 0; i < NUM_TERMINALS; i++) {
+        if (terminals[i].initialized == 0) {
+            count = pit_reload;
+        }
+    }
+
+    sched_idle_entries++;
+    pit_oneshot_count = count;
+    outb( PIT_ONESHOT_REG_VAL, PIT_COMMAND_REG );
+    outb( count & RELOAD_MASK_LOWER, CHANNEL_0 );
+    outb( ( count & RELOAD_MASK_UPPER ) >> RELOAD_UPPER_SHIFT, CHANNEL_0 );
+
+    /* sti only takes effect after hlt has started, so an interrupt */
+    /* can't sneak in between and leave us halted for nothing.      */
+    asm volatile( "sti; hlt; cli" : : : "memory" );
+
+    /* Woken by something other than the PIT (or the PIT handler    */
+    /* already switched back to ticking)                            */
+    PIT_leave_idle(0);
+}
+
 /* Called whenever an interrupt is generated by the PIT */
 /* Will cause the next task in the round robin          */
 /* scheduling to occur                                  */
@@ -82,21 +253,383 @@ void PIT_init( void )
 /*                  robin schedule                      */
 void pit_handler( void ){
     cli();                          /* Disable interrupts   */
+    /* Send EOI to the PIC before switching. The task we    */
+    /* switch to may have given up the CPU from somewhere   */
+    /* other than this handler, and won't send it for us.   */
+    send_eoi(PIT_IRQ_NUM);
+
+    /* A one-shot going off means we were idle, and that    */
+    /* time is counted when the PIT goes back to ticking.   */
+    if (!PIT_leave_idle(1)) {
+        sched_ticks++;
+        time_page->pit_ticks = sched_ticks;
+    }
+    /* Anything printed without a flush shows up by the     */
+    /* next tick.                                           */
+    terminal_flush( display_terminal );
     scheduler();                    /* Call the scheduler   */
-    send_eoi(PIT_IRQ_NUM);          /* Send EOI to the PIC  */
-    /* RESUME: Check send_eoi stuff */
     sti();                          /* Enable interrupts    */
 }
 
+/* ------------------ RUN_QUEUE_PUSH ------------------ */
+/* Queues a process at its current level and marks it   */
+/* ready.                                               */
+/* Inputs:          pid -> process to queue             */
+/*                  at_head -> 1 to run it before the   */
+/*                  rest of its level (it was only      */
+/*                  preempted), 0 to wait its turn      */
+/* Outputs:         None.                               */
+/* Side effects:    Adds to run_queue                   */
+static void run_queue_push( int32_t pid, int32_t at_head ){
+    pcb_t* pcb = get_pcb(pid);
+    sched_queue_t* queue = &run_queue[pcb->sched_level];
+
+    if (at_head) {
+        queue->head = (queue->head + SCHED_MAX_PROCS - 1) % SCHED_MAX_PROCS;
+        queue->pids[queue->head] = pid;
+    } else {
+        queue->pids[(queue->head + queue->count) % SCHED_MAX_PROCS] = pid;
+    }
+    queue->count++;
+    pcb->sched_state = SCHED_READY;
+}
+
+/* ------------------ RUN_QUEUE_POP ------------------- */
+/* Takes the oldest process off the highest level that  */
+/* has one.                                             */
+/* Inputs:          None.                               */
+/* Outputs:         PID of the process, or -1 if every  */
+/*                  queue is empty                      */
+/* Side effects:    Removes from run_queue              */
+static int32_t run_queue_pop( void ){
+    int32_t level;
+    int32_t pid;
+
+    for (level = 0; level < SCHED_LEVELS; level++) {
+        if (run_queue[level].count) {
+            pid = run_queue[level].pids[run_queue[level].head];
+            run_queue[level].head = (run_queue[level].head + 1) % SCHED_MAX_PROCS;
+            run_queue[level].count--;
+            return pid;
+        }
+    }
+    return -1;
+}
+
+/* --------------- RUN_QUEUE_TOP_LEVEL ---------------- */
+/* Inputs:          None.                               */
+/* Outputs:         Highest level with a ready process, */
+/*                  or SCHED_LEVELS if there is none    */
+/* Side effects:    None.                               */
+static int32_t run_queue_top_level( void ){
+    int32_t level;
+
+    for (level = 0; level < SCHED_LEVELS; level++) {
+        if (run_queue[level].count) {
+            break;
+        }
+    }
+    return level;
+}
+
+/* -------------------- SCHED_BOOST ------------------- */
+/* Moves every process back up to its top level, so a   */
+/* process that sank while computing gets a fair share  */
+/* again once it starts waiting on input.               */
+/* Inputs:          None.                               */
+/* Outputs:         None.                               */
+/* Side effects:    Rebuilds run_queue                  */
+static void sched_boost( void ){
+    /* Too big for the kernel stack of whoever the PIT  */
+    /* interrupted; only the PIT handler boosts.        */
+    static int32_t ready[SCHED_MAX_PROCS];
+    int32_t num_ready = 0;
+    int32_t pid;
+    int32_t i;
+
+    /* Empty the queues, oldest of the highest level first */
+    while ((pid = run_queue_pop()) >= 0) {
+        ready[num_ready++] = pid;
+    }
+
+    for (pid = pid_next(0); pid >= 0; pid = pid_next(pid + 1)) {
+        get_pcb(pid)->sched_level = get_pcb(pid)->nice;
+        get_pcb(pid)->slice_used = 0;
+    }
+
+    /* Requeue in the same order */
+    for (i = 0; i < num_ready; i++) {
+        run_queue_push(ready[i], 0);
+    }
+}
+
+/* --------------------- SCHED_RUN -------------------- */
+/* Hands the CPU to a process taken off the run queue.  */
+/* Inputs:          pid -> process to run               */
+/* Outputs:         None.                               */
+/* Side effects:    Switches tasks unless pid is the    */
+/*                  process already running             */
+static void sched_run( int32_t pid ){
+    pcb_t* pcb = get_pcb(pid);
+
+    pcb->sched_state = SCHED_RUNNING;
+    if (pid != curr_pid) {
+        sched_switches++;
+        switch_task(pcb->terminal, pid);
+    }
+}
+
 /* Called by pit_handler whenever an interrupt is       */
-/* generated by the PIT.                                */
-/* Causes the next task in the round robin              */
+/* generated by the PIT. Charges the tick to the        */
+/* running process, and switches to the highest         */
+/* priority ready process once its time slice is used   */
+/* up or something with a higher priority is ready.     */
 /* Inputs:          None.                               */
 /* Outputs:         None.                               */
-/* Side effects:    Causes switch to next task in round */
-/*                  robin schedule                      */
+/* Side effects:    May switch to another task          */
 void scheduler( void ){
-    // cli();
+    pcb_t* pcb;
+    int32_t next_pid;
+    int32_t i;
+
+    /* Start the shell of any terminal that doesn't have one yet.   */
+    /* Terminal 2 --> 1 --> 0, the same order as they are          */
+    /* displayed on bootup.                                         */
+    for (i = NUM_TERMINALS - 1; i >= 0; i--) {
+        if (terminals[i].initialized == 0) {
+            if (curr_pid >= 0 && get_pcb(curr_pid)->sched_state == SCHED_RUNNING) {
+                run_queue_push(curr_pid, 1);
+            }
+            switch_task(i, -1);
+            return;
+        }
+    }
+
+    if (curr_pid < 0) {
+        return;
+    }
+
+    if (sched_ticks - sched_last_boost >= SCHED_BOOST_TICKS) {
+        sched_last_boost = sched_ticks;
+        sched_boost();
+    }
+
+    pcb = get_pcb(curr_pid);
+    if (pcb->sched_state == SCHED_RUNNING) {
+        pcb->run_ticks++;
+        pcb->slice_used++;
+
+        if (pcb->slice_used >= sched_slice[pcb->sched_level]) {
+            /* Used its whole slice, so it is computing. Drop a level. */
+            if (pcb->sched_level < SCHED_LEVELS - 1) {
+                pcb->sched_level++;
+            }
+            pcb->slice_used = 0;
+            run_queue_push(curr_pid, 0);
+        } else if (run_queue_top_level() < pcb->sched_level) {
+            run_queue_push(curr_pid, 1);
+        } else {
+            return;
+        }
+    }
+
+    /* If the running process is asleep and nothing is ready, it    */
+    /* just stays halted in wait_queue_sleep.                       */
+    next_pid = run_queue_pop();
+    if (next_pid >= 0) {
+        sched_run(next_pid);
+    }
+}
+
+/* ------------------ SCHEDULER_YIELD ----------------- */
+/* Gives up the CPU because the running process is      */
+/* waiting for an interrupt. It is marked asleep, so    */
+/* nothing runs it again until scheduler_wake. Must be  */
+/* called with interrupts off.                          */
+/* Inputs:          None.                               */
+/* Outputs:         1 if another task ran before we     */
+/*                  were woken, 0 if there was nothing  */
+/*                  else to run.                        */
+/* Side effects:    May switch to another task.         */
+int32_t scheduler_yield( void ){
+    int32_t next_pid;
+
+    /* Before the first shell starts (e.g. the boot tests) there is */
+    /* nothing to switch to.                                        */
+    if (curr_pid < 0 || terminals[sched_terminal].initialized == 0) {
+        return 0;
+    }
+
+    get_pcb(curr_pid)->sched_state = SCHED_SLEEPING;
+
+    next_pid = run_queue_pop();
+    if (next_pid < 0) {
+        return 0;
+    }
+    sched_run(next_pid);
+
+    return 1;
+}
+
+/* ------------------ SCHEDULER_WAKE ------------------ */
+/* Makes a sleeping process runnable again. It just got */
+/* input, so it goes back to its top level with a fresh */
+/* time slice. Does nothing if it isn't asleep.         */
+/* Inputs:          pid -> process to wake              */
+/* Outputs:         None.                               */
+/* Side effects:    May add to run_queue                */
+void scheduler_wake( int32_t pid ){
+    pcb_t* pcb = get_pcb(pid);
+
+    if (pcb->sched_state != SCHED_SLEEPING) {
+        return;
+    }
+
+    pcb->sched_level = pcb->nice;
+    pcb->slice_used = 0;
+
+    /* Woken while halted in wait_queue_sleep without anything else */
+    /* to run, so it is still the running process.                  */
+    if (pid == curr_pid) {
+        pcb->sched_state = SCHED_RUNNING;
+        return;
+    }
+    run_queue_push(pid, 0);
+}
+
+/* ----------------- SCHEDULER_PREEMPT ---------------- */
+/* Called at the end of interrupt handlers, after the   */
+/* EOI. If the interrupt woke a process that outranks   */
+/* the running one, or the running one is asleep,       */
+/* switch now rather than on the next PIT tick.         */
+/* Inputs:          None.                               */
+/* Outputs:         None.                               */
+/* Side effects:    May switch to another task          */
+void scheduler_preempt( void ){
+    pcb_t* pcb;
+
+    /* Whatever woke us, the next task gets regular ticks */
+    PIT_leave_idle(0);
+
+    if (curr_pid < 0 || terminals[sched_terminal].initialized == 0) {
+        return;
+    }
+
+    pcb = get_pcb(curr_pid);
+    if (pcb->sched_state == SCHED_RUNNING) {
+        if (run_queue_top_level() >= pcb->sched_level) {
+            return;
+        }
+        run_queue_push(curr_pid, 1);
+    } else if (run_queue_top_level() == SCHED_LEVELS) {
+        return;
+    }
+    sched_run(run_queue_pop());
+}
+
+/* -------------- SCHEDULER_PROCESS_INIT -------------- */
+/* Sets up the scheduling state of a process that is    */
+/* about to start running in sched_terminal. It takes   */
+/* over the CPU from its parent, and inherits the       */
+/* parent's nice value.                                 */
+/* Inputs:          pid -> new process                  */
+/*                  parent_pid -> its parent, or -1     */
+/* Outputs:         None.                               */
+/* Side effects:    Fills in the PCB scheduling fields  */
+void scheduler_process_init( int32_t pid, int32_t parent_pid ){
+    pcb_t* pcb = get_pcb(pid);
+
+    pcb->terminal = sched_terminal;
+    pcb->nice = (parent_pid >= 0) ? get_pcb(parent_pid)->nice : 0;
+    pcb->sched_level = pcb->nice;
+    pcb->slice_used = 0;
+    pcb->run_ticks = 0;
+    pcb->sched_state = SCHED_RUNNING;
+}
+
+/* ------------- SCHEDULER_PROCESS_READY -------------- */
+/* Queues a process that was set up by                  */
+/* scheduler_process_init but doesn't take over the CPU */
+/* from its parent. A forked child waits its turn like  */
+/* anything else that is ready.                         */
+/* Inputs:          pid -> new process                  */
+/* Outputs:         None.                               */
+/* Side effects:    Adds to run_queue                   */
+void scheduler_process_ready( int32_t pid ){
+    uint32_t flags;
+
+    cli_and_save(flags);
+    run_queue_push(pid, 0);
+    restore_flags(flags);
+}
+
+/* ------------------ SCHEDULER_EXIT ------------------ */
+/* Gives up the CPU for good. The running process is    */
+/* marked a zombie, so nothing queues it again, and we  */
+/* switch to whatever is ready, idling until something  */
+/* is. Its stack is never switched back to. Must be     */
+/* called with interrupts off.                          */
+/* Inputs:          None.                               */
+/* Outputs:         None, never returns.                */
+/* Side effects:    Switches to another task            */
+void scheduler_exit( void ){
+    int32_t next_pid;
+
+    get_pcb(curr_pid)->sched_state = SCHED_ZOMBIE;
+
+    while (1) {
+        next_pid = run_queue_pop();
+        if (next_pid >= 0) {
+            sched_run(next_pid);
+        }
+        /* An interrupt that readies something may also switch */
+        /* away from us before we get back here.               */
+        scheduler_idle();
+    }
+}
+
+/* ------------------- SCHEDULER_NICE ----------------- */
+/* Changes the nice value of a process. The nice value  */
+/* is the highest level the process can be on, so a     */
+/* niced process never outranks a normal one that is    */
+/* waiting on input.                                    */
+/* Inputs:          pid -> process to change            */
+/*                  increment -> amount to add, clamped */
+/*                  to 0 through SCHED_LEVELS - 1       */
+/* Outputs:         The new nice value                  */
+/* Side effects:    May lower the process' level        */
+int32_t scheduler_nice( int32_t pid, int32_t increment ){
+    pcb_t* pcb = get_pcb(pid);
+    int32_t nice = pcb->nice + increment;
+
+    if (nice < 0) {
+        nice = 0;
+    } else if (nice > SCHED_LEVELS - 1) {
+        nice = SCHED_LEVELS - 1;
+    }
+    pcb->nice = nice;
+
+    /* The running process is not queued, so this is safe */
+    if (pcb->sched_level < nice) {
+        pcb->sched_level = nice;
+    }
+    return nice;
+}
+
+/* -------------------- SWITCH_TASK ------------------- */
+/* Saves the running task in its PCB and switches to    */
+/* next_pid, or starts a shell in next_terminal if      */
+/* next_pid is -1. Forked processes share a terminal,   */
+/* so the context is kept per process rather than per   */
+/* terminal. Returns once something switches back to    */
+/* us.                                                  */
+/* Inputs:          next_terminal -> terminal to run    */
+/*                  next_pid -> process to run, or -1   */
+/* Outputs:         None.                               */
+/* Side effects:    Changes curr_pid, sched_terminal,   */
+/*                  the user page, vidmap page and TSS. */
+void switch_task( int32_t next_terminal, int32_t next_pid ){
+    pcb_t* pcb;
 
     /* Store the ESP and the EBP so that we can return to it later */
     uint32_t saved_esp;
@@ -115,14 +648,26 @@ void scheduler( void ){
                     /* clobbered here.                                  */
                     "memory"
                 ); 
-    /* Make sure to save ESP, and EBP into the terminals struct array */
-    terminals[sched_terminal].pid = curr_pid;
-    terminals[sched_terminal].saved_esp = saved_esp;
-    terminals[sched_terminal].saved_ebp = saved_ebp;
 
-    /* If the current terminal is not initialized, set up   */
-    /* and execute shell                                    */
-    if (terminals[sched_terminal].initialized == 0) {
+    /* Make sure to save ESP, and EBP into the PCB. Nothing runs   */
+    /* before the first shell is started, so the boot stack we      */
+    /* interrupt on the first tick is never saved. A zombie is      */
+    /* never switched back to, so it isn't what its terminal runs.  */
+    if (curr_pid >= 0) {
+        pcb = get_pcb(curr_pid);
+        pcb->sched_esp = saved_esp;
+        pcb->sched_ebp = saved_ebp;
+        if (pcb->sched_state != SCHED_ZOMBIE) {
+            terminals[sched_terminal].pid = curr_pid;
+        }
+    }
+    sched_terminal = next_terminal;
+
+    /* If the next terminal is not initialized, set up and  */
+    /* execute shell. The task we just left keeps its stack */
+    /* above the saved ESP, so running shell below it is    */
+    /* fine.                                                */
+    if (next_pid < 0) {
         /* Sets the terminal to be marked as initialized    */
         terminals[sched_terminal].initialized = 1;
 
@@ -130,53 +675,34 @@ void scheduler( void ){
         /* the next scheduled terminal                                      */
         switch_terminal(sched_terminal);     
 
-        /* Need to send the end-of-interrupt signal before execute is called */
-        send_eoi(PIT_IRQ_NUM);    
+        /* No parent to return to, so the new shell is a base shell */
+        curr_pid = -1;
 
         /* Executes the base shell call */
         syscall_execute( (uint8_t*)"shell" );
 
         return;
     }  
-    
-    /* Switch to the next terminal in a round robin loop */
-    /* Terminal 2 --> 1 --> 0 --> 2 , etc.               */
-    sched_terminal -= 1;
-    if (sched_terminal < 0) {
-        sched_terminal = 2;
-    }     
-
-    #if 0
-    /* Return early if the next terminal in the round robin is not initialized */
-    if (terminals[sched_terminal].initialized == 0) {
-        return;
-    }
-
-    if (sched_terminal == display_terminal) {
-        set_video_page_to_reg( );
-    } else {
-        set_non_displayed_video_page( sched_terminal );
-    }
 
     /* Gets the current process ID and the saved values for ESP and EBP */
-    int32_t next_pid = terminals[sched_terminal].pid;
-    saved_esp = terminals[sched_terminal].saved_esp;
-    saved_ebp = terminals[sched_terminal].saved_ebp;
+    curr_pid = next_pid;
+    terminals[sched_terminal].pid = curr_pid;
+    saved_esp = get_pcb(curr_pid)->sched_esp;
+    saved_ebp = get_pcb(curr_pid)->sched_ebp;
+
+    /* Remaps the corresponding program based off of the program ID to the user page */
+    map_prog_to_page(curr_pid);
+
+    /* Point the vidmap page at where this terminal is drawn */
+    set_sched_video_page( );
 
-    if (next_pid > 2) {
-        /* Remaps the corresponding program based off of the program ID to the user page */
-        map_prog_to_page(next_pid);
-    }
-    
-  
     /* Updates tss parameters to prepare for context switch */
     tss.ss0 = KERNEL_DS;
-    tss.esp0 = EIGHT_MB - EIGHT_KB * curr_pid - 4;
-
-    /* Send end-of-interrupt signal for PIT to the PIC */
-    // send_eoi(PIT_IRQ_NUM);
+    tss.esp0 = proc_kernel_stack(curr_pid) - 4;
 
-    /* Context switch to the next program in the scheduling queue */
+    /* Context switch to the next program in the scheduling queue. We    */
+    /* land in that task's own call to switch_task(), so returning from  */
+    /* here unwinds its stack rather than ours.                          */
     asm volatile( 
                     "movl     %0, %%esp;" /* Move arg one into reg ESP    */
                     "movl     %1, %%ebp;" /* Move arg two into reg EBP    */
@@ -186,15 +712,43 @@ void scheduler( void ){
                       "r" ( saved_esp ),
                       /* Input 1: Saved EBP.      */
                       "r" ( saved_ebp )
+                    : "memory"
                 ); 
-    
 
-    // sti();
-    #endif
     return;
 } 
 
 /* PAGING FUNCTIONS RELEVANT TO SCHEDULER */
+/* ---------------- SET_VIDMAP_FRAME ------------------ */
+/* Points the vidmap page at a physical frame. The page */
+/* table is shared by every process, so the page is     */
+/* only present while the running process has called   */
+/* vidmap; anyone else would be handed the screen, or   */
+/* another terminal's copy of it. Only that one page    */
+/* changes, so only its TLB entry is dropped, with      */
+/* invlpg, and nothing at all is done if it already     */
+/* looks the way it should.                             */
+/* Inputs:          frame -> physical page number       */
+/* Outputs:         None.                               */
+/* Side Effects:    Remaps vid_page_table[0]            */
+static void set_vidmap_frame( uint32_t frame )
+{
+    uint32_t mapped = ( curr_pid >= 0 && get_pcb(curr_pid)->vidmap ) ? 1 : 0;
+
+    if (vid_page_table[0].present == mapped &&
+        vid_page_table[0].user_supervisor == mapped &&
+        vid_page_table[0].virtual_address == frame) {
+        return;
+    }
+
+    vid_page_table[0].present = mapped;
+    vid_page_table[0].read_write = 1;
+    vid_page_table[0].user_supervisor = mapped;
+    vid_page_table[0].virtual_address = frame;
+
+    flush_tlb_entry( VIRT_VID_MEM );
+}
+
 /* ---------------- set_video_page -------------------- */
 /* Sets characteristics and virtual memory address of   */
 /* page to point to the video memory                    */
@@ -203,13 +757,23 @@ void scheduler( void ){
 /* Side Effects:    Sets the virtual adress of the      */
 /*                  vid_page_table to vid_mem           */
 void set_video_page_to_reg( void ) {
-    
-    vid_page_table[0].present = 1;
-    vid_page_table[0].read_write = 1;
-    vid_page_table[0].user_supervisor = 1;
-    vid_page_table[0].virtual_address = VIDEO_START_ADDR / FOUR_KB;
+    set_vidmap_frame( VIDEO_START_ADDR / FOUR_KB );
+}
 
-    flush_tlb();
+/* --------------- set_sched_video_page -------------- */
+/* Points the vidmap page at the screen if the running  */
+/* terminal is the one being displayed, or at its saved */
+/* copy if it is in the background.                     */
+/* Inputs:          None.                               */
+/* Outputs:         None.                               */
+/* Side Effects:    Remaps vid_page_table and drops its */
+/*                  TLB entry                           */
+void set_sched_video_page( void ) {
+    if (sched_terminal == display_terminal) {
+        set_video_page_to_reg( );
+    } else {
+        set_non_displayed_video_page( sched_terminal );
+    }
 }
 
 /* --------- set_alternative_video_page --------------- */
@@ -223,11 +787,5 @@ void set_video_page_to_reg( void ) {
 /*                  to terminal we are updating         */
 void set_non_displayed_video_page( int terminal )
 {
-
-    vid_page_table[0].present = 1;
-    vid_page_table[0].read_write = 1;
-    vid_page_table[0].user_supervisor = 1;
-    vid_page_table[0].virtual_address = ((VIDEO_ALT_START + (terminal)) * SCHED_FOUR_MB) / FOUR_KB;
-
-    flush_tlb();
+    set_vidmap_frame( ( (uint32_t)terminal_vid_mem[ terminal ] ) / FOUR_KB );
 }
@@ -1,6 +1,7 @@
 #ifndef _SCHED_H
 #define _SCHED_H
 #include "lib.h"
+#include "process.h"
 
 /* Most information found on osdev.org, at:             */
 /* https://wiki.osdev.org/PIT                           */
@@ -27,27 +28,89 @@
 /* to obtain a slower frequency that is still accurate  */
 /* enough for timekeeping.                              */
 /* Frequency = 1193182 / (Reload Value) Hz              */
-/* Set the Reload Value to get an acceptable frequency, */
-/* rounded up.                                          */
-#define RELOAD_VAL              11931        
+/* The Reload Value is worked out from the tick rate,   */
+/* rounded to the nearest count.                        */
 #define RELOAD_MASK_LOWER       0x00FF
 #define RELOAD_MASK_UPPER       0xFF00
+#define RELOAD_UPPER_SHIFT      8
+
+/* The tick rate can be picked on the multiboot command */
+/* line with "hz=N". The reload value is 16 bits, which */
+/* puts a floor of about 19 Hz on the rate.             */
+#define PIT_BASE_FREQ           1193182
+#define PIT_DEFAULT_HZ          100
+#define PIT_MIN_HZ              19
+#define PIT_MAX_HZ              5000
+#define PIT_MAX_COUNT           0xFFFF
+
+/* Tickless idle. When nothing can run, the PIT is put  */
+/* in one-shot mode (Mode 0, interrupt on terminal      */
+/* count) for the next deadline instead of waking us    */
+/* every tick. The latch command freezes channel 0's    */
+/* count so we can read how long we were idle. Pass     */
+/* "notickless" on the command line to keep ticking.    */
+/* Result: +-- 0 0 --+-- 1 1 --+-- 0 0 0 --+-- 0 --+    */
+#define PIT_ONESHOT_REG_VAL     0x30
+#define PIT_LATCH_REG_VAL       0x00
 
 /* Define as having the highest priority with the PIC   */
 /* since we want to always switch to the next task      */
 /* whenever an intterupt occurs                         */
 #define PIT_IRQ_NUM             0
 
+/* Multilevel feedback queue. A process starts at its    */
+/* top level (level 0 unless niced) and drops a level    */
+/* every time it uses up a whole time slice, so compute  */
+/* jobs sink while processes that sleep on input stay    */
+/* on top. Waking from input, and the periodic boost,    */
+/* put a process back on its top level.                  */
+#define SCHED_LEVELS            4       /* Number of priority levels            */
+#define SCHED_MAX_PROCS         PROC_MAX /* Processes that can be queued at once */
+#define SCHED_BOOST_TICKS       100     /* Ticks between priority boosts        */
+
+/* Scheduling states of a process                       */
+#define SCHED_RUNNING           0       /* On the CPU, or waiting on a child    */
+#define SCHED_READY             1       /* In a run queue                       */
+#define SCHED_SLEEPING          2       /* Asleep on a wait queue               */
+#define SCHED_ZOMBIE            3       /* Exited, waiting to be reaped         */
+
+/* A run queue holds the PIDs waiting at one level,     */
+/* oldest first.                                        */
+typedef struct sched_queue_t {
+    int32_t  pids[ SCHED_MAX_PROCS ];
+    uint32_t head;
+    uint32_t count;
+} sched_queue_t;
+
 #define VIDEO_PAGE_NUM   0x8800000 >> 22
 #define VIDEO_TABLE_NUM  0xB8
-#define VIDEO_ALT_START  0xBA
 #define VIDEO_VIRT_ADDR  0xB8
 #define SCHED_FOUR_KB    0x1000
 #define SCHED_FOUR_MB    0x00400000
 
+/* Tick rate of the PIT, and whether idle is tickless   */
+extern uint32_t pit_hz;
+extern uint32_t tickless_enabled;
+
+/* PIT ticks since boot, including those spent idle     */
+extern uint32_t sched_ticks;
+
+/* Times we went idle, and ticks spent idle             */
+extern uint32_t sched_idle_entries;
+extern uint32_t sched_idle_ticks;
+
+/* Picks up "hz=N" and "notickless" from the multiboot  */
+/* command line. Call before PIT_init.                  */
+void PIT_parse_cmdline( const int8_t* cmdline );
+
 /* Initializes the PIT (Programmable Interval Timer)    */
 void PIT_init( void );
 
+/* Halts until the next interrupt with the PIT in       */
+/* one-shot mode. Called with interrupts off when       */
+/* nothing can run.                                     */
+void scheduler_idle( void );
+
 /* Called whenever an intterupt is generated by the PIT */
 /* Will cause the next task in the round robin          */
 /* scheduling to occur                                  */
@@ -58,6 +121,39 @@ void pit_handler( void );
 /* for multipell concurrent tasks                       */
 void scheduler( void );
 
+/* Gives up the CPU while the running task waits for an */
+/* interrupt. Returns 0 if there was nothing else to    */
+/* run, in which case the caller should halt instead.   */
+int32_t scheduler_yield( void );
+
+/* Makes a sleeping process runnable again, boosting it */
+/* to its top level since it just got input.            */
+void scheduler_wake( int32_t pid );
+
+/* Called at the end of interrupt handlers. Switches if */
+/* the interrupt woke a process that outranks the       */
+/* running one.                                         */
+void scheduler_preempt( void );
+
+/* Sets up the scheduling state of a new process        */
+void scheduler_process_init( int32_t pid, int32_t parent_pid );
+
+/* Queues a new process that doesn't take over the CPU  */
+/* from its parent, like a forked child                 */
+void scheduler_process_ready( int32_t pid );
+
+/* Leaves the running process for good, as a zombie.    */
+/* Must be called with interrupts off. Never returns.   */
+void scheduler_exit( void );
+
+/* Changes the nice value of a process, returns the new */
+/* value                                                */
+int32_t scheduler_nice( int32_t pid, int32_t increment );
+
+/* Saves the running task and switches to next_pid, or  */
+/* starts a shell in next_terminal if next_pid is -1    */
+void switch_task( int32_t next_terminal, int32_t next_pid );
+
 /* Sets characteristics and virtual memory address of   */
 /* page to point to the video memory                    */
 void set_video_page_to_reg( void );
@@ -67,5 +163,9 @@ void set_video_page_to_reg( void );
 /* to the passed terminal                               */
 void set_non_displayed_video_page( int terminal );
 
+/* Points the vidmap page at wherever the running       */
+/* terminal is drawn, on screen or in its saved copy    */
+void set_sched_video_page( void );
+
 
 #endif
@@ -0,0 +1,304 @@
+/* serial.c - Interrupt driven driver for the 16550 UART on COM1
+ * vim:ts=4 noexpandtab
+ */
+
+#include "serial.h"
+#include "i8259.h"
+#include "lib.h"
+#include "scheduling.h"
+#include "wait_queue.h"
+
+int32_t serial_present = 0;
+
+/* Received bytes. The handler is the only one putting bytes in. */
+input_ring_t serial_rx;
+
+/* Bytes waiting to go out. Anything can print, the handler     */
+/* included, so both ends are only touched with interrupts off. */
+/* serial_tx_busy is set while the FIFO has bytes the handler   */
+/* will hear about when they are gone.                          */
+static uint8_t  serial_tx_buf[ SERIAL_TX_SIZE ];
+static uint32_t serial_tx_head = 0;
+static uint32_t serial_tx_tail = 0;
+static int32_t  serial_tx_busy = 0;
+
+/* Set up here, so reading before serial_init just sleeps */
+static wait_queue_t serial_read_queue  = { "serial read" };
+static wait_queue_t serial_write_queue = { "serial write" };
+
+/* static void serial_tx_fill();
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: Moves up to a FIFO's worth of queued bytes into the
+ *             transmit FIFO, which has to be empty. Interrupts must
+ *             be off. */
+static void serial_tx_fill( void )
+{
+    int32_t i;
+
+    for( i = 0; i < SERIAL_FIFO_SIZE && serial_tx_tail != serial_tx_head; i++ )
+    {
+        outb( serial_tx_buf[ serial_tx_tail & ( SERIAL_TX_SIZE - 1 ) ], COM1_PORT + SERIAL_DATA );
+        serial_tx_tail++;
+    }
+    serial_tx_busy = ( i != 0 );
+}
+
+/* static void serial_queue(uint8_t c);
+ *   Inputs: c - byte to send
+ *   Return Value: none
+ *   Function: Adds a byte to the transmit queue, starting the
+ *             transmitter if it is idle. If the queue is full, sends
+ *             the oldest bytes by polling, since this can be called
+ *             from places that can't sleep. Interrupts must be off. */
+static void serial_queue( uint8_t c )
+{
+    while( serial_tx_head - serial_tx_tail >= SERIAL_TX_SIZE )
+    {
+        while( !( inb( COM1_PORT + SERIAL_LSR ) & SERIAL_LSR_THR_EMPTY ) );
+        serial_tx_fill( );
+    }
+
+    serial_tx_buf[ serial_tx_head & ( SERIAL_TX_SIZE - 1 ) ] = c;
+    serial_tx_head++;
+
+    if( !serial_tx_busy && ( inb( COM1_PORT + SERIAL_LSR ) & SERIAL_LSR_THR_EMPTY ) )
+    {
+        serial_tx_fill( );
+    }
+}
+
+/* int32_t serial_init();
+ *   Inputs: none
+ *   Return Value: 1 if a UART was found and set up, 0 if not
+ *   Function: Sets COM1 to 115200 8N1 with both FIFOs on, checks
+ *             the chip is there by looping a byte back, and unmasks
+ *             IRQ 4 for received data and an empty transmitter. */
+int32_t serial_init( void )
+{
+    outb( 0, COM1_PORT + SERIAL_IER );
+    outb( SERIAL_LCR_DLAB, COM1_PORT + SERIAL_LCR );
+    outb( SERIAL_DIVISOR & BYTE_0_MASK, COM1_PORT + SERIAL_DATA );
+    outb( ( SERIAL_DIVISOR >> HIGH_BYTE_SHIFT ) & BYTE_0_MASK, COM1_PORT + SERIAL_IER );
+    outb( SERIAL_LCR_8N1, COM1_PORT + SERIAL_LCR );
+    outb( SERIAL_FCR_ENABLE, COM1_PORT + SERIAL_FCR );
+
+    /* With nothing on the port, reads float and won't echo */
+    outb( SERIAL_MCR_LOOPBACK, COM1_PORT + SERIAL_MCR );
+    outb( SERIAL_LOOPBACK_BYTE, COM1_PORT + SERIAL_DATA );
+    if( inb( COM1_PORT + SERIAL_DATA ) != SERIAL_LOOPBACK_BYTE )
+    {
+        return 0;
+    }
+    outb( SERIAL_MCR_IRQ, COM1_PORT + SERIAL_MCR );
+
+    serial_rx.head = 0;
+    serial_rx.tail = 0;
+    serial_present = 1;
+    outb( SERIAL_IER_RX_TX, COM1_PORT + SERIAL_IER );
+    enable_irq( SERIAL_IRQ_NUM );
+    return 1;
+}
+
+/* void serial_handler();
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: Handles everything the UART has pending. Received
+ *             bytes go to serial_rx, dropped if nobody is reading
+ *             them, and an empty transmitter gets the next FIFO's
+ *             worth of queued bytes. */
+void serial_handler( void )
+{
+    uint8_t iir;
+    uint8_t c;
+    int32_t received = 0;
+    int32_t sent = 0;
+
+    while( !( ( iir = inb( COM1_PORT + SERIAL_IIR ) ) & SERIAL_IIR_NONE ) )
+    {
+        switch( iir & SERIAL_IIR_ID_MASK )
+        {
+            case SERIAL_IIR_RX_DATA:
+            case SERIAL_IIR_RX_TIMEOUT:
+                while( inb( COM1_PORT + SERIAL_LSR ) & SERIAL_LSR_DATA_READY )
+                {
+                    c = inb( COM1_PORT + SERIAL_DATA );
+                    input_ring_put( &serial_rx, &c, 1 );
+                    received = 1;
+                }
+                break;
+
+            case SERIAL_IIR_THR_EMPTY:
+                serial_tx_fill( );
+                sent = 1;
+                break;
+
+            /* Reading the status register is all it takes to clear */
+            case SERIAL_IIR_LINE:
+                inb( COM1_PORT + SERIAL_LSR );
+                break;
+
+            default:
+                inb( COM1_PORT + SERIAL_MSR );
+                break;
+        }
+    }
+
+    send_eoi( SERIAL_IRQ_NUM );
+
+    if( sent )
+    {
+        wake_up( &serial_write_queue );
+    }
+    if( received )
+    {
+        wake_up( &serial_read_queue );
+    }
+    scheduler_preempt( );
+}
+
+/* void serial_putc(uint8_t c);
+ *   Inputs: c - byte to send
+ *   Return Value: none
+ *   Function: Queues a byte for COM1, sending "\r\n" for '\n' so a
+ *             terminal on the other end starts a new line. Does
+ *             nothing if there is no UART. Safe from any context. */
+void serial_putc( uint8_t c )
+{
+    uint32_t flags;
+
+    if( !serial_present )
+    {
+        return;
+    }
+
+    cli_and_save( flags );
+    if( c == '\n' )
+    {
+        serial_queue( '\r' );
+    }
+    serial_queue( c );
+    restore_flags( flags );
+}
+
+/* void serial_drain();
+ *   Inputs: none
+ *   Return Value: none
+ *   Function: Sends everything queued by polling, for when the
+ *             output has to be out before going on. */
+void serial_drain( void )
+{
+    uint32_t flags;
+
+    if( !serial_present )
+    {
+        return;
+    }
+
+    cli_and_save( flags );
+    while( serial_tx_tail != serial_tx_head )
+    {
+        while( !( inb( COM1_PORT + SERIAL_LSR ) & SERIAL_LSR_THR_EMPTY ) );
+        serial_tx_fill( );
+    }
+    restore_flags( flags );
+}
+
+/* int32_t serial_tx_room();
+ *   Inputs: none
+ *   Return Value: free space in the transmit queue, 0 if no UART
+ *   Function: Lets callers that can't wait send only what fits. */
+int32_t serial_tx_room( void )
+{
+    if( !serial_present )
+    {
+        return 0;
+    }
+    return SERIAL_TX_SIZE - ( serial_tx_head - serial_tx_tail );
+}
+
+/* int32_t serial_open(const uint8_t* filename);
+ *   Inputs: filename - unused
+ *   Return Value: 0, or -1 if there is no UART
+ *   Function: Opens the serial port */
+int32_t serial_open( const uint8_t* filename )
+{
+    return serial_present ? 0 : -1;
+}
+
+/* int32_t serial_close(int32_t fd);
+ *   Inputs: fd - unused
+ *   Return Value: 0
+ *   Function: Closes the serial port */
+int32_t serial_close( int32_t fd )
+{
+    return 0;
+}
+
+/* int32_t serial_read(int32_t fd, void* buf, int32_t nbytes);
+ *   Inputs: fd - unused
+ *           buf - buffer to fill
+ *           nbytes - most bytes to read
+ *   Return Value: number of bytes read
+ *   Function: Sleeps until something has been received, then reads
+ *             as much of it as fits. */
+int32_t serial_read( int32_t fd, void* buf, int32_t nbytes )
+{
+    uint32_t flags;
+    int32_t count;
+
+    if( buf == NULL || nbytes <= 0 )
+    {
+        return 0;
+    }
+
+    /* Any process can have the port open, so the reading end   */
+    /* is kept to one reader at a time by turning interrupts    */
+    /* off around it.                                           */
+    cli_and_save( flags );
+    while( serial_rx.head == serial_rx.tail )
+    {
+        wait_queue_sleep( &serial_read_queue );
+    }
+    count = input_ring_read( &serial_rx, buf, nbytes, 0 );
+    restore_flags( flags );
+
+    return count;
+}
+
+/* int32_t serial_write(int32_t fd, const void* buf, int32_t nbytes);
+ *   Inputs: fd - unused
+ *           buf - bytes to send
+ *           nbytes - number of bytes
+ *   Return Value: nbytes, or -1 on a bad buffer
+ *   Function: Queues the bytes for sending, sleeping while the
+ *             queue is full rather than polling the UART. */
+int32_t serial_write( int32_t fd, const void* buf, int32_t nbytes )
+{
+    const uint8_t* data = buf;
+    uint32_t flags;
+    int32_t i;
+
+    if( buf == NULL || nbytes < 0 )
+    {
+        return -1;
+    }
+
+    cli_and_save( flags );
+    for( i = 0; i < nbytes; i++ )
+    {
+        /* Room for the byte and a '\r' in front of it */
+        while( SERIAL_TX_SIZE - ( serial_tx_head - serial_tx_tail ) < 2 )
+        {
+            wait_queue_sleep( &serial_write_queue );
+        }
+        if( data[ i ] == '\n' )
+        {
+            serial_queue( '\r' );
+        }
+        serial_queue( data[ i ] );
+    }
+    restore_flags( flags );
+
+    return nbytes;
+}
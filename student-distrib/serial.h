@@ -0,0 +1,79 @@
+/* serial.h - Defines used in interactions with the 16550 UART on COM1
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef _SERIAL_H
+#define _SERIAL_H
+
+#include "types.h"
+#include "terminal.h"
+
+/* Set to 1 to copy everything the kernel printf()s out of COM1 too,    */
+/* so a headless emulator (qemu -nographic) shows boot messages and     */
+/* test results.                                                        */
+#define SERIAL_MIRROR_PRINTF    1
+
+/* Port and IRQ of COM1 */
+#define COM1_PORT               0x3F8
+#define SERIAL_IRQ_NUM          4
+
+/* Register offsets from the base port */
+#define SERIAL_DATA             0       /* RX/TX holding register, divisor low with DLAB    */
+#define SERIAL_IER              1       /* Interrupt enable, divisor high with DLAB         */
+#define SERIAL_IIR              2       /* Interrupt identification when read               */
+#define SERIAL_FCR              2       /* FIFO control when written                        */
+#define SERIAL_LCR              3       /* Line control                                     */
+#define SERIAL_MCR              4       /* Modem control                                    */
+#define SERIAL_LSR              5       /* Line status                                      */
+#define SERIAL_MSR              6       /* Modem status                                     */
+
+/* Register values */
+#define SERIAL_LCR_DLAB         0x80    /* Makes offsets 0 and 1 the baud divisor           */
+#define SERIAL_LCR_8N1          0x03    /* 8 data bits, no parity, 1 stop bit               */
+#define SERIAL_DIVISOR          1       /* 115200 baud                                      */
+#define SERIAL_FCR_ENABLE       0xC7    /* FIFOs on and cleared, RX interrupt at 14 bytes   */
+#define SERIAL_MCR_IRQ          0x0B    /* DTR, RTS, and OUT2, which gates the IRQ line     */
+#define SERIAL_MCR_LOOPBACK     0x1E    /* Loopback, to check the chip is there             */
+#define SERIAL_IER_RX_TX        0x03    /* Interrupt on data received and on THR empty      */
+#define SERIAL_LSR_DATA_READY   0x01
+#define SERIAL_LSR_THR_EMPTY    0x20
+#define SERIAL_IIR_NONE         0x01    /* Set when nothing is pending                      */
+#define SERIAL_IIR_ID_MASK      0x0E
+#define SERIAL_IIR_MODEM        0x00
+#define SERIAL_IIR_THR_EMPTY    0x02
+#define SERIAL_IIR_RX_DATA      0x04
+#define SERIAL_IIR_LINE         0x06
+#define SERIAL_IIR_RX_TIMEOUT   0x0C
+#define SERIAL_LOOPBACK_BYTE    0xAE
+
+#define SERIAL_FIFO_SIZE        16      /* Bytes the transmit FIFO takes at once            */
+#define SERIAL_TX_SIZE          4096    /* Bytes queued for sending. Must be a power of two */
+
+/* Set once serial_init finds a UART on COM1 */
+extern int32_t serial_present;
+
+/* Received bytes waiting for serial_read */
+extern input_ring_t serial_rx;
+
+/* Sets up COM1 and its interrupt, if the chip is there */
+extern int32_t serial_init( void );
+
+/* Handles COM1 interrupts, moving bytes between the FIFOs and the rings */
+extern void serial_handler( void );
+
+/* Queues a byte to send, turning '\n' into "\r\n" */
+extern void serial_putc( uint8_t c );
+
+/* Waits until everything queued has gone out */
+extern void serial_drain( void );
+
+/* Bytes that can be queued right now without waiting */
+extern int32_t serial_tx_room( void );
+
+/* Device file operations for "serial" */
+extern int32_t serial_open( const uint8_t* filename );
+extern int32_t serial_close( int32_t fd );
+extern int32_t serial_read( int32_t fd, void* buf, int32_t nbytes );
+extern int32_t serial_write( int32_t fd, const void* buf, int32_t nbytes );
+
+#endif /* _SERIAL_H */
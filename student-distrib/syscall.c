@@ -1,18 +1,30 @@
 #include "syscall.h"
-
-/* Define a function pointer type so that our code is   */
-/* easier to read! Defines a pointer to a function with */
-/* return value of type int32_t and arbitrary args.     */
-typedef int32_t ( *function )( );
-typedef int32_t ( *read_function )( int32_t fd, void* buf, int32_t nbytes );
-typedef int32_t ( *write_function )( int32_t fd, void* buf, int32_t nbytes );
+#include "scheduling.h"
+#include "ktime.h"
+#include "klog.h"
+#include "frame.h"
+#include "exec_cache.h"
+#include "wait_queue.h"
+#include "rtc.h"
 
 /* Set curr_pid to -1 initially. Will be set in         */
 /* execute, when we execute a new program!              */
 int32_t curr_pid = -1;
 int32_t active_pid;
 int32_t prev_pid;
-int32_t pid_array[MAX_NUM_FILES - 2] = { 0, 0, 0, 0, 0, 0};
+int32_t sysenter_enabled = 0;
+
+/* SYSENTER starts on this stack. sysenter_entry moves to the   */
+/* process's kernel stack right away, so it only has to be big */
+/* enough for an NMI that lands before that.                    */
+static uint8_t sysenter_stack[ SYSENTER_STACK_SIZE ] __attribute__((aligned(16)));
+
+/* wait sleeps here until one of the children exits */
+static wait_queue_t child_exit_queue = { "child exit" };
+
+static void fork_exit( int32_t status );
+static void release_children( int32_t pid );
+static void reap_child( int32_t child );
 
 
 #define SYSCALL_HEADER      \
@@ -57,15 +69,38 @@ int32_t syscall_halt( uint8_t status )
     /* to identify the corresponding PCB.               */
     pcb_t* program_pcb = get_pcb( curr_pid );
 
-    /* Regardless, set the PID in the PID Array to be   */
-    /* free, since the Process will be quashed either   */
-    /* way.                                             */
-    pid_array[ curr_pid ] = PID_FREE;
+    /* A forked process has no execute to return to, so */
+    /* it waits as a zombie for its parent instead.     */
+    if( program_pcb->forked )
+    {
+        fork_exit( close_status );
+    }
+
+    /* From here until we jump back into the parent we  */
+    /* run on a stack whose PID we give back, so no     */
+    /* tick may switch away and let an execute in       */
+    /* another terminal take the PID and its stack.     */
+    cli( );
+
+    /* Nobody is left to wait for its forked children.  */
+    /* Done while we still hold our PID, so no new      */
+    /* process can be mistaken for their parent.        */
+    release_children( curr_pid );
+
+    /* Regardless, give the PID back, since the Process */
+    /* will be quashed either way. Its slot stays       */
+    /* mapped, so we can finish up on its stack.        */
+    pid_free( curr_pid );
 
     /* Iterate through the file array of the process    */
     /* and set all the files to closed (flags = 0 )     */
     close_all_files( );
 
+    /* Give the process's pages back to the frame       */
+    /* allocator. Nothing touches user memory from here */
+    /* on.                                              */
+    user_page_table_reset( curr_pid );
+
     /* Also, set the PID being serviced to the PID of   */
     /* the previous process, since we aim to halt this  */
     /* process and want to return to the previous one.  */
@@ -86,14 +121,18 @@ int32_t syscall_halt( uint8_t status )
     program_pcb->pid = -1;
     program_pcb->active = 0;
 
+    /* A program that put the terminal in raw mode doesn't leave it     */
+    /* that way for the shell.                                          */
+    terminals[ sched_terminal ].mode = TERM_MODE_CANON;
+
     /* Reset printf coordinates to be consistent w terminal's. Since    */
     /* we may be returning from a halt we want to print onto the next   */
     /* line as a means of making the terminal look cleaner. Update      */
     /* screen_x/y and determine if we want to add a newline.            */
-    if( terminal_x[ display_terminal ] != 0 )
+    if( terminal_x[ sched_terminal ] != 0 )
     {
-        keyboard_putc( '\n' );
-        reset_keyboard_buffer( );
+        terminal_putc( sched_terminal, '\n' );
+        terminal_flush( sched_terminal );
     }
 
     /* If the previous PID was -1, then run the program */
@@ -108,9 +147,18 @@ int32_t syscall_halt( uint8_t status )
         syscall_execute( (uint8_t*)"shell" );
     } 
 
+    /* The parent is what this terminal runs now, so    */
+    /* the scheduler has to switch back to it.          */
+    terminals[ sched_terminal ].pid = curr_pid;
+    get_pcb( curr_pid )->sched_state = SCHED_RUNNING;
+    get_pcb( curr_pid )->slice_used = 0;
+
     /* Remap the User Page to be updated with the       */
     /* parent's information and process.                */
     map_prog_to_page( curr_pid );
+
+    /* The vidmap page goes with whether the parent called vidmap */
+    set_sched_video_page( );
     
     /* Update the Task Switch Segment (TSS) with updated SS0 and ESP0.  */
     /* SS0 is the Segment Selector used to load the stack from a lower  */
@@ -121,8 +169,9 @@ int32_t syscall_halt( uint8_t status )
     /* details on the TSS.                                              */
     /* Update the TSS to load in the parent task.                       */
     tss.ss0 = KERNEL_DS;
-    /* 8 MB - 8KB * curr_pid, -4 for safety.                            */
-    tss.esp0 = EIGHT_MB - EIGHT_KB * curr_pid;
+    /* Top of the parent's kernel stack in its slot, -4 as everywhere   */
+    /* else, so its next system call frame is where fork looks for it.  */
+    tss.esp0 = proc_kernel_stack( curr_pid ) - 4;
 
     /* Jump to the parent process, resetting the stack  */
     /* and base pointer registers as well as calling    */
@@ -177,14 +226,15 @@ int32_t syscall_execute( const uint8_t* command )
 {
 
     int i;
+    uint32_t flags;
     /* Reset printf coordinates to be consistent w terminal's. Since    */
     /* we may be returning from a halt we want to print onto the next   */
     /* line as a means of making the terminal look cleaner. Update      */
     /* screen_x/y and determine if we want to add a newline.            */
-    if( terminal_x[ display_terminal ] != 0 )
+    if( terminal_x[ sched_terminal ] != 0 )
     {
-        keyboard_putc( '\n' );
-        reset_keyboard_buffer( );
+        terminal_putc( sched_terminal, '\n' );
+        terminal_flush( sched_terminal );
     }
     screen_x = terminal_x[ display_terminal ];
     screen_y = terminal_y[ display_terminal ];
@@ -211,38 +261,31 @@ int32_t syscall_execute( const uint8_t* command )
 
 
     /* ------------------ SETUP AND INPUT VALIDATION ------------------ */
-    /* Check if we are even allowed to open any new programs. The max   */
-    /* number of programs allowed is 5.                                 */
-    if( curr_pid >= MAX_NUM_PROGS )
-    {
-        // printf( "\nToo many programs are being run! Aborting execute...\n" );
-        return FAILURE;
-    }
     /* Check if command is NULL. If so, return failure since the call   */
     /* was not set up properly.                                         */
     if ( command == NULL )
     {
-        // printf( "\nNULL Command! Aborting execute...\n" );    
+        klog( "execute: NULL command\n" );
         return FAILURE;
     }
     /* Check if the only thing entered in the command is '\0', or NULL. */
     /* If so, return failure since call was not set up properly.        */
     if ( command == '\0' )
     { 
-        // printf( "\nEmpty Command! Aborting execute...\n" );
+        klog( "execute: empty command\n" );
         return FAILURE;
     }
     /* Check if the command is too large. If so, return failure since   */
     /* the command was not passed in properly.                          */
     if ( strlen( (int8_t*)command ) > BUFFER_SIZE )
     {
-        // printf( "\nCommand too long! Aborting execute...\n" );
+        klog( "execute: command too long\n" );
         return FAILURE;
     }
     /* Load the file name and arguments into the declared arrays.       */
     if( !get_fname( command ) )
     {
-        // printf( "\nFilename exceeds allowed size! Aborting execute...\n" );
+        klog( "execute: file name too long\n" );
         return FAILURE;
     }
 
@@ -260,6 +303,7 @@ int32_t syscall_execute( const uint8_t* command )
     read_flag = read_dentry_by_name( (uint8_t*)file_name, &dentry );
     if( read_flag == FAILURE )
     {
+        klog( "execute: no file named \"%s\"\n", file_name );
         return FAILURE;
     }
 
@@ -273,31 +317,28 @@ int32_t syscall_execute( const uint8_t* command )
         ( buf[ 2 ] != MAGIC_NUM_2 ) ||
         ( buf[ 3 ] != MAGIC_NUM_3 )   )
       {
+        klog( "execute: \"%s\" is not executable\n", file_name );
         return FAILURE;
       }
     
-    /* Get a new PID for the new process. Loop through the PID array    */
-    /* since our programs won't necessarily be executed and halted in   */
-    /* order, as they all have different runtimes.                      */
+    /* Get a new PID for the new process. Our programs won't be halted */
+    /* in the order they were executed, so take the lowest free PID     */
+    /* from the PID bitmap, which also gets its PCB and kernel stack    */
+    /* ready in the process area. Interrupts stay off from here until  */
+    /* the iret turns them back on, so no tick switches away while the  */
+    /* new PID and its PCB are half set up.                             */
+    cli_and_save( flags );
     prev_pid = curr_pid;
-    for( i = 0; i < 6; i++ )
-    {
-        if( pid_array[ i ] == PID_FREE )
-        {
-            pid_array[ i ] = 1;
-            curr_pid = i;
-            pid_array[ i ] = PID_IN_USE;
-            break;
-        }
-    }
+    curr_pid = pid_alloc( );
     /* If no PIDs are free, return FAILURE. */
-    if( i > MAX_NUM_PROGS )
+    if( curr_pid < 0 )
     {
+        curr_pid = prev_pid;
+        restore_flags( flags );
+        klog( "execute: too many programs are running\n" );
         return FAILURE;
     }
 
-    terminals[sched_terminal].pid = curr_pid;
-
     /* Get the PCB (Process Control Block) of the current process,  */
     /* which will hold all the relevant information to our process. */
     pcb_t* new_pcb = get_pcb( curr_pid );
@@ -322,15 +363,27 @@ int32_t syscall_execute( const uint8_t* command )
         eip |= buf[ EIP_BYTE_OFFSET + i ] << ( BYTE_SIZE * i );
     }
 
-    /* Set up new page. Set the entries as appropriate. Also, set   */
-    /* the virtual address according to the PID.                    */
+    /* Set up new page. Start with every page of the user page not  */
+    /* present, then point the user page at this PID's page table.  */
+    user_page_table_reset( curr_pid );
+    process_page_directory_init( curr_pid );
     map_prog_to_page( curr_pid );
 
-    /* Load file into memory. Get the File Size, and use read_data  */
-    /* to read the entire file into the program image address as    */
-    /* outlined by the documentation of MP3 (discussion).           */
-    uint32_t file_size = get_file_size( dentry.index_node_num );
-    read_flag = read_data( (uint32_t)dentry.index_node_num, (uint32_t)0, (uint8_t*)PROG_IMG_START, (uint32_t)file_size );
+    /* Don't copy the program in here. Only remember which file     */
+    /* backs the program image, and let the page fault handler map  */
+    /* in each 4kB page the first time the program touches it, from */
+    /* the exec cache if another process already read it.          */
+    new_pcb->exec_inode = dentry.index_node_num;
+    new_pcb->exec_size = get_file_size( dentry.index_node_num );
+    new_pcb->pages_loaded = 0;
+    new_pcb->pages_copied = 0;
+    new_pcb->vidmap = 0;
+    new_pcb->forked = 0;
+    new_pcb->exit_status = 0;
+
+    /* The new program hasn't called vidmap, so take the page away */
+    /* in case the caller had it.                                  */
+    set_sched_video_page( );
 
     /* Fill the PCB entries so that we can save the data for our program.   */
     /* Keep track of the parent's PID so that we can return to the parent   */
@@ -341,11 +394,6 @@ int32_t syscall_execute( const uint8_t* command )
     /* driver. Additionally, set the rest of the file flags in the file     */
     /* array of our PCB to 0 so that we can indiate they're not in use.     */
 
-    if( curr_pid < 3 )
-    {
-        prev_pid = -1;
-    }
-
     new_pcb->parent_id = prev_pid;
     new_pcb->pid = curr_pid;
     new_pcb->saved_ebp = parent_ebp;
@@ -355,12 +403,12 @@ int32_t syscall_execute( const uint8_t* command )
     /* First file is STDIN, whose table is just terminal's with WRITE set   */
     /* to NULL. Second file is STDOUT, whose table is just temrinal with    */
     /* READ set to NULL. Set the rest of the flags as not in use/available. */
-    new_pcb->fd_array[ 0 ].fops_ptr = get_terminal_table( );
+    new_pcb->fd_array[ 0 ].fops_ptr = get_stdin_table( );
     new_pcb->fd_array[ 0 ].index_node_num = -1;
     new_pcb->fd_array[ 0 ].file_position = 0;
     new_pcb->fd_array[ 0 ].flags = 1;
     new_pcb->filetype_array[ 0 ] = 3;
-    new_pcb->fd_array[ 1 ].fops_ptr = get_terminal_table( );
+    new_pcb->fd_array[ 1 ].fops_ptr = get_stdout_table( );
     new_pcb->fd_array[ 1 ].index_node_num = -1;
     new_pcb->fd_array[ 1 ].file_position = 0;
     new_pcb->fd_array[ 1 ].flags = 1;
@@ -373,6 +421,11 @@ int32_t syscall_execute( const uint8_t* command )
     new_pcb->fd_array[ 6 ].flags = 0;
     new_pcb->fd_array[ 7 ].flags = 0;
 
+    /* The new process takes over the CPU from its parent. Only once */
+    /* its scheduling state is set up is it what the terminal runs.  */
+    scheduler_process_init( curr_pid, prev_pid );
+    terminals[sched_terminal].pid = curr_pid;
+
     new_pcb->esp0 = tss.esp0; 
     new_pcb->ss0 = tss.ss0;   
          
@@ -384,8 +437,8 @@ int32_t syscall_execute( const uint8_t* command )
     /* Refer to: https://wiki.osdev.org/Task_State_Segment for more     */
     /* details on the TSS.                                              */
     tss.ss0 = KERNEL_DS;
-    /* 8 MB - 8KB * curr_pid, -4 for safety.                            */
-    tss.esp0 = EIGHT_MB - EIGHT_KB * curr_pid - 4; 
+    /* Top of the new process's kernel stack, -4 for safety.            */
+    tss.esp0 = proc_kernel_stack( curr_pid ) - 4;
 
     /* Load the return address ( given as a label ) into our PCB, so    */
     /* that we can return to the appropriate place later.               */
@@ -490,67 +543,17 @@ int32_t syscall_read( int32_t fd, void* buf, int32_t nbytes )
         return FAILURE;
     }
 
-    /* Synchronize the file_system global file array    */
-    /* with the PCB's local file array so that we don't */
-    /* get issues with opening and reading files or     */
-    /* writing files.                                   */
-    int i;
-    for( i = 0; i < MAX_NUM_FILES; i++ )
+    /* The fops table was bound when the file was opened. */
+    /* stdout has no read function, so check for that.    */
+    fops_table_t* fops = program_pcb->fd_array[ fd ].fops_ptr;
+    if( fops == NULL || fops->read == NULL )
     {
-        file_array[ i ].fops_ptr = program_pcb->fd_array[ i ].fops_ptr;
-        file_array[ i ].index_node_num = program_pcb->fd_array[ i ].index_node_num;
-        file_array[ i ].file_position = program_pcb->fd_array[ i ].file_position;
-        file_array[ i ].flags = program_pcb->fd_array[ i ].flags;
-    }
-
-    /* Call the corresponding function based on the     */
-    /* file type. Use its return value as the return    */
-    /* value for this function.                         */
-    int filetype;
-    filetype = program_pcb->filetype_array[ fd ];
-    switch( filetype )
-    {
-        /* Case 0: RTC Type */
-        case RTC_TYPE:
-            program_pcb->fd_array[ fd ].fops_ptr = get_RTC_table( );
-            break;
-
-        /* Case 1: Directory Type */
-        case DIRECTORY_TYPE:
-            program_pcb->fd_array[ fd ].fops_ptr = get_dir_table( );
-            break;
-
-        /* Case 2: Regular File Type */
-        case REG_FILE_TYPE:
-            program_pcb->fd_array[ fd ].fops_ptr = get_file_table( );
-            break;
-
-        /* Case 3: Terminal Type*/
-        case TERMINAL_FILE_TYPE:
-            program_pcb->fd_array[ fd ].fops_ptr = get_terminal_table( );
-            break;
-
-        /* If program type does not match any of these, */
-        /* then an error occurred. Return FAILURE.      */
-        default:
-            return FAILURE;
-    } 
-    
-    function func_read = (void*)program_pcb->fd_array[ fd ].fops_ptr->read;
-    /* Read result returns the # of bytes read.         */
-    int read_result = (func_read)( fd, buf, nbytes );
-    /* However, since the pcb and filesys file entries  */
-    /* are separate we need to update the pcb's file    */
-    /* entries with the filesys's file entries.         */
-    for( i = 0; i < MAX_NUM_FILES; i++ )
-    {
-        program_pcb->fd_array[ i ].fops_ptr = file_array[ i ].fops_ptr;
-        program_pcb->fd_array[ i ].index_node_num = file_array[ i ].index_node_num;
-        program_pcb->fd_array[ i ].file_position = file_array[ i ].file_position;
-        program_pcb->fd_array[ i ].flags = file_array[ i ].flags; 
+        return FAILURE;
     }
-    
-    return read_result;
+
+    /* The driver works straight on the PCB's open file,  */
+    /* so there is nothing to copy back afterwards.       */
+    return fops->read( fd, buf, nbytes );
 }
 
 /*-------------------syscall_write----------------------*/
@@ -605,61 +608,15 @@ int32_t syscall_write( int32_t fd, const void* buf, int32_t nbytes )
         return FAILURE;
     }
 
-    /* Synchronize the file_system global file array    */
-    /* with the PCB's local file array so that we don't */
-    /* get issues with opening and reading files or     */
-    /* writing files.                                   */
-    int i;
-    for( i = 0; i < MAX_NUM_FILES; i++ )
-    {
-        file_array[ i ].fops_ptr = program_pcb->fd_array[ i ].fops_ptr;
-        file_array[ i ].index_node_num = program_pcb->fd_array[ i ].index_node_num;
-        file_array[ i ].file_position = program_pcb->fd_array[ i ].file_position;
-        file_array[ i ].flags = program_pcb->fd_array[ i ].flags;
-    }
-
-    /* Call the corresponding function based on the     */
-    /* file type. Use its return value as the return    */
-    /* value for this function. Due to the fops         */
-    /* implementation, we need to reset the fops table  */
-    /* every time we read and write, because those      */
-    /* functions are unique to each file type.          */
-    int filetype;
-    filetype = program_pcb->filetype_array[ fd ];
-    switch( filetype )
-    {
-        /* Case 0: RTC Type */
-        case RTC_TYPE:
-            program_pcb->fd_array[ fd ].fops_ptr = get_RTC_table( );
-            break;
-        /* Case 1: Directory Type */
-        case DIRECTORY_TYPE:
-            program_pcb->fd_array[ fd ].fops_ptr = get_dir_table( );
-            break;
-        /* Case 2: Regular File Type */
-        case REG_FILE_TYPE:
-            program_pcb->fd_array[ fd ].fops_ptr = get_file_table( );
-            break;
-        /* Case 3: Terminal File Type */
-        case TERMINAL_FILE_TYPE:
-            program_pcb->fd_array[ fd ].fops_ptr = get_terminal_table( );
-            break;
-    }   
-
-    function func_write = (void*)program_pcb->fd_array[ fd ].fops_ptr->write;
-    /* Read result returns the # of bytes read.         */
-    int read_result = (func_write)( fd, buf, nbytes );
-    /* However, since the pcb and filesys file entries  */
-    /* are separate we need to update the pcb's file    */
-    /* entries with the filesys's file entries.         */
-    for( i = 0; i < MAX_NUM_FILES; i++ )
+    /* The fops table was bound when the file was opened. */
+    /* stdin has no write function, so check for that.    */
+    fops_table_t* fops = program_pcb->fd_array[ fd ].fops_ptr;
+    if( fops == NULL || fops->write == NULL )
     {
-        program_pcb->fd_array[ i ].fops_ptr = file_array[ i ].fops_ptr;
-        program_pcb->fd_array[ i ].index_node_num = file_array[ i ].index_node_num;
-        program_pcb->fd_array[ i ].file_position = file_array[ i ].file_position;
-        program_pcb->fd_array[ i ].flags = file_array[ i ].flags; 
+        return FAILURE;
     }
-    return read_result; 
+
+    return fops->write( fd, buf, nbytes );
 }
 
 /*-------------------syscall_open-----------------------*/
@@ -687,14 +644,22 @@ int32_t syscall_open( const uint8_t* filename )
         return FAILURE;
     }
 
+    /* Devices like "serial" aren't in the file system,  */
+    /* so look for them by name first.                   */
+    fops_table_t* device_fops = get_device_table( filename );
+
     /* See if we can find the directory entry. If so,   */
     /* then store it into an instance of dentry_t.      */
     /* read_dentry_by_name returns 1 if it fails, and 0 */
     /* if it passes, while passing the dentry instance  */
     /* to the second argument.                          */
     dentry_t dentry;
-    int dentry_pass = read_dentry_by_name( filename, &dentry );
-    if( dentry_pass == FAILURE )
+    if( device_fops != NULL )
+    {
+        dentry.file_type = DEVICE_FILE_TYPE;
+        dentry.index_node_num = 0;
+    }
+    else if( read_dentry_by_name( filename, &dentry ) == FAILURE )
     {
         return FAILURE;
     }
@@ -741,6 +706,7 @@ int32_t syscall_open( const uint8_t* filename )
         /* entry as such.                               */
         case RTC_TYPE:
             program_pcb->fd_array[ fd ].fops_ptr = get_RTC_table( );
+            program_pcb->fd_array[ fd ].rtc_divider = 0;
             break;
 
         /* File type is Directory. Initialize pcb file  */
@@ -755,6 +721,11 @@ int32_t syscall_open( const uint8_t* filename )
             program_pcb->fd_array[ fd ].fops_ptr = get_file_table( );
             break;
 
+        /* Device found by name above.                  */
+        case DEVICE_FILE_TYPE:
+            program_pcb->fd_array[ fd ].fops_ptr = device_fops;
+            break;
+
         /* File type not recognized, return failure.    */
         default:
             return FAILURE;
@@ -768,11 +739,13 @@ int32_t syscall_open( const uint8_t* filename )
     program_pcb->fd_array[ fd ].flags = 1;
 
     /* Also run the associated open function with the   */
-    /* given file type and f_ops pointer.               */
-    function func_sys_open = (void*)program_pcb->fd_array[ fd ].fops_ptr->open;
-    uint32_t open_status = (func_sys_open)( filename );
+    /* given file type and f_ops pointer. If it fails,  */
+    /* give the file descriptor back.                   */
+    int32_t open_status = program_pcb->fd_array[ fd ].fops_ptr->open( filename );
     if( open_status < 0 )
     {
+        program_pcb->fd_array[ fd ].fops_ptr = NULL;
+        program_pcb->fd_array[ fd ].flags = 0;
         return FAILURE;
     }
     return ( fd );
@@ -815,12 +788,21 @@ int32_t syscall_close( int32_t fd )
         return FAILURE;
     }
 
+    /* Let the driver give back anything the file holds */
+    /* on to, like the RTC rate it asked for.           */
+    if( program_pcb->fd_array[ fd ].fops_ptr != NULL &&
+        program_pcb->fd_array[ fd ].fops_ptr->close != NULL )
+    {
+        program_pcb->fd_array[ fd ].fops_ptr->close( fd );
+    }
+
     /* Both checks passed, close the file by resetting  */
     /* the file descriptor's elements to zero.          */
     program_pcb->fd_array[ fd ].fops_ptr = NULL;
     program_pcb->fd_array[ fd ].index_node_num = 0;
     program_pcb->fd_array[ fd ].file_position = 0;
     program_pcb->fd_array[ fd ].flags = 0;
+    program_pcb->fd_array[ fd ].rtc_divider = 0;
     program_pcb->filetype_array[ fd ] = 0;
     
     return 0;    
@@ -918,32 +900,27 @@ int32_t syscall_vidmap( uint8_t** screen_start )
     /* Checks if the passed in screen_start is valid and is in the correct address range */
     if (screen_start == NULL) {
         return FAILURE;
-    } else if ((uint32_t) screen_start >= FOUR_MB && (uint32_t) screen_start < EIGHT_MB) { // no sneaky kernel moves
+    } else if ((uint32_t) screen_start >= FOUR_MB && (uint32_t) screen_start < PROC_AREA_END) { // no sneaky kernel moves
         return FAILURE;
     }
 
     /* Sets the screen start virtual address */
     *screen_start = (uint8_t*)(VIRT_VID_MEM);
 
-    /* Gets the corresponding page directory index by getting the top 10 bits of the screen start address */
-    /* since there are 1024 total page directory entries */
-    uint32_t PDE_index = VIRT_VID_MEM >> 22;
-
-    /* Sets the necessary page directory parameters */
-    page_directory[PDE_index].present = 1;
-    page_directory[PDE_index].read_write = 1;
-    page_directory[PDE_index].user_supervisor = 1;
-    page_directory[PDE_index].page_size = 0;
-    page_directory[PDE_index].virtual_address = ((int)(vid_page_table)) / FOUR_KB;
+    /* The page directory entry for vid_page_table is in every      */
+    /* process's page directory already, since the time page shares */
+    /* it, so only the page itself has to be set up. It is only     */
+    /* present for processes that asked for it.                     */
+    get_pcb( curr_pid )->vidmap = 1;
 
-    /* Sets the necessary video page table parameter */
-    vid_page_table[0].present = 1;
-    vid_page_table[0].read_write = 1;
-    vid_page_table[0].user_supervisor = 1;
-    vid_page_table[0].virtual_address = VIDEO_MEM_START_ADDR / FOUR_KB; // 0xB8000
+    /* Sets the video page table to the screen, or to the saved copy of  */
+    /* the caller's terminal if it is running in the background. Also   */
+    /* flushes the TLB.                                                 */
+    set_sched_video_page( );
 
-    /* Flushes the TLB */
-    flush_tlb();
+    /* The page only covers the top of the VGA text window, so stop     */
+    /* scrolling the terminal by moving the start address.              */
+    terminal_flush( sched_terminal );
 
     return 0;
 }
@@ -963,27 +940,162 @@ int32_t syscall_sigreturn( void )
 
 /* ----------------- HELPER FUNCTIONS --------------------- */
 /* ----------------- map_prog_to_page --------------------- */
-/* Maps the program to a page in the page table. Maps the   */
-/* user to page 32, defined to be the user page.            */
+/* Switches to the address space of a process. Its page     */
+/* directory was built by execute, so this is only a CR3    */
+/* load. That drops the old process's user TLB entries but  */
+/* keeps the kernel's, which are global.                    */
 void map_prog_to_page( int32_t pid )
 {
-    /* Set up new page. Set the entries as appropriate. Also, set   */
-    /* the virtual address according to the PID.                    */
-    page_directory[ USER_PAGE ].present         = 1;
-    page_directory[ USER_PAGE ].read_write      = 1;
-    page_directory[ USER_PAGE ].user_supervisor = 1;
-    page_directory[ USER_PAGE ].write_through   = 0;
-    page_directory[ USER_PAGE ].cache_disable   = 0;
-    page_directory[ USER_PAGE ].accessed        = 0;
-    page_directory[ USER_PAGE ].available_1     = 0;
-    page_directory[ USER_PAGE ].page_size       = 1;
-    page_directory[ USER_PAGE ].global          = 1;
-    page_directory[ USER_PAGE ].available_3     = 0;
-    page_directory[ USER_PAGE ].virtual_address = ( (uint32_t)( EIGHT_MB + ( pid * FOUR_MB ) ) ) >> 12;
-
-    /* Flush the TLB since a new page has been set and old entries  */
-    /* are not irrelevant.                                          */
-    flush_tlb( );
+    loadPageDirectory( (unsigned int*)( proc_slot_phys( pid ) + PROC_DIR_OFFSET ) );
+}
+
+/* ------------------ user_frame_alloc -------------------- */
+/* Gets a frame for a user page. If none are free, program  */
+/* pages nobody is running are dropped from the exec cache  */
+/* to make some.                                            */
+/* Outputs: physical address of the frame, 0 if none        */
+static uint32_t user_frame_alloc( void )
+{
+    uint32_t frame = frame_alloc( 0 );
+
+    if( frame == 0 && exec_cache_reclaim( ) )
+    {
+        frame = frame_alloc( 0 );
+    }
+    return frame;
+}
+
+/* ------------------ page_cow_break ---------------------- */
+/* Gives the current process its own writable copy of a    */
+/* shared page it wrote to. If nobody else has the frame    */
+/* any more, it just becomes writable.                      */
+/* Inputs: pte          -> entry of the shared page         */
+/*         page_addr    -> user address of the page         */
+/* Outputs: 0           -> page is now writable, retry      */
+/*          -1          -> there is no free memory left     */
+/* Side Effects: Remaps the page and drops a reference to   */
+/*               the shared frame                           */
+static int32_t page_cow_break( page_table_entry_t* pte, uint32_t page_addr )
+{
+    uint32_t shared = pte->virtual_address << SHIFT_12_VIRTUAL_ADDR;
+    uint32_t frame;
+    uint32_t flags;
+
+    if( frame_refcount( shared ) > 1 )
+    {
+        frame = user_frame_alloc( );
+        if( frame == 0 )
+        {
+            klog( "pid %d: out of memory copying 0x%x\n", curr_pid, page_addr );
+            return FAILURE;
+        }
+
+        /* Copy from the shared frame through the kernel's window  */
+        /* into the new one through the user address.               */
+        cli_and_save( flags );
+        pte->virtual_address = frame >> SHIFT_12_VIRTUAL_ADDR;
+        pte->read_write = 1;
+        flush_tlb_entry( page_addr );
+        memcpy( (void*)page_addr, kmap_window( shared ), FOUR_KB );
+        kunmap_window( );
+        restore_flags( flags );
+
+        frame_put( shared );
+        get_pcb( curr_pid )->pages_copied++;
+    }
+
+    pte->read_write = 1;
+    pte->available_3 &= ~PTE_AVL_COW;
+    flush_tlb_entry( page_addr );
+    return 0;
+}
+
+/* ------------------ demand_page_in ---------------------- */
+/* Fills in a not present page of the current process's     */
+/* user page. Pages that overlap the program image come     */
+/* from the exec cache and are shared read-only with every  */
+/* other process running the program; the first write to    */
+/* one copies it, so data pages end up private and code     */
+/* pages stay shared. The rest are zeroed (bss, heap and    */
+/* the user stack). Writes to shared pages, from the        */
+/* program or from a system call on its behalf, also land   */
+/* here.                                                    */
+/* Inputs: fault_addr   -> address that faulted (CR2)       */
+/*         error_code   -> error code pushed by the CPU     */
+/* Outputs: 0           -> page is now present, retry       */
+/*          -1          -> fault can't be fixed up, or      */
+/*                         there is no free memory left     */
+/* Side Effects: Maps and fills one 4kB user page           */
+int32_t demand_page_in( uint32_t fault_addr, uint32_t error_code )
+{
+    pcb_t* program_pcb;
+    page_table_entry_t* pte;
+    uint32_t page_addr;
+    uint32_t frame;
+
+    /* Only faults inside the user page of a running process are   */
+    /* ours to fix.                                                 */
+    if( proc_slot_phys( curr_pid ) == 0 ||
+        fault_addr < USER_START_ADDR || fault_addr >= USER_END_ADDR )
+    {
+        return FAILURE;
+    }
+
+    page_addr = fault_addr & PAGE_FRAME_MASK;
+    pte = &proc_user_page_table( curr_pid )[ ( page_addr - USER_START_ADDR ) / FOUR_KB ];
+    program_pcb = get_pcb( curr_pid );
+
+    /* A present page only faults when it's written and read-only.  */
+    if( error_code & PF_ERR_PRESENT )
+    {
+        if( ( error_code & PF_ERR_WRITE ) && ( pte->available_3 & PTE_AVL_COW ) )
+        {
+            return page_cow_break( pte, page_addr );
+        }
+        return FAILURE;
+    }
+
+    if( page_addr >= PROG_IMG_START &&
+        page_addr - PROG_IMG_START < program_pcb->exec_size )
+    {
+        frame = exec_cache_get( program_pcb->exec_inode, ( page_addr - PROG_IMG_START ) / FOUR_KB );
+        if( frame == 0 )
+        {
+            klog( "pid %d: out of memory paging in 0x%x\n", curr_pid, page_addr );
+            return FAILURE;
+        }
+        pte->virtual_address = frame >> SHIFT_12_VIRTUAL_ADDR;
+        pte->read_write = 0;
+        pte->available_3 |= PTE_AVL_COW;
+        pte->present = 1;
+        flush_tlb_entry( page_addr );
+        program_pcb->pages_loaded++;
+
+        /* Retrying a write would only fault again */
+        if( error_code & PF_ERR_WRITE )
+        {
+            return page_cow_break( pte, page_addr );
+        }
+        return 0;
+    }
+
+    frame = user_frame_alloc( );
+    if( frame == 0 )
+    {
+        klog( "pid %d: out of memory paging in 0x%x\n", curr_pid, page_addr );
+        return FAILURE;
+    }
+
+    /* Map the page first, so the kernel can write to it through    */
+    /* the user address.                                            */
+    pte->virtual_address = frame >> SHIFT_12_VIRTUAL_ADDR;
+    pte->read_write = 1;
+    pte->present = 1;
+    flush_tlb_entry( page_addr );
+    memset( (uint8_t*)page_addr, 0, FOUR_KB );
+
+    program_pcb->pages_loaded++;
+    return 0;
 }
 
 /* ------------------ get_fname ----------------------- */
@@ -1111,9 +1223,30 @@ int get_args( const uint8_t* command ) {
 
 /* ------------------ get_pcb ------------------------- */
 /* Gets the PCB corresponding to the PID passed in.     */
-/* Takes in the PID and maps it accordingly.            */
+/* Every PID's PCB sits at the bottom of its slot in    */
+/* the process area, so this is just an offset.         */
 pcb_t* get_pcb(uint32_t pid) {
-    return (pcb_t*)( EIGHT_MB - EIGHT_KB*( 1 + pid ) );
+    return (pcb_t*)PROC_SLOT( pid );
+}
+
+/* ------------------ get_open_file ----------------------- */
+/* Returns the open file the drivers should use for a file  */
+/* descriptor. Once a process is running that is the entry  */
+/* in its PCB, before that it is the kernel's file_array.   */
+/* Inputs: fd       -> File Descriptor                      */
+/* Outputs: Pointer to the open file, NULL if fd is invalid */
+/* Side Effects: None                                       */
+open_file_t* get_open_file( int32_t fd )
+{
+    if( fd < 0 || fd >= MAX_NUM_FILES )
+    {
+        return NULL;
+    }
+    if( curr_pid < 0 )
+    {
+        return &file_array[ fd ];
+    }
+    return &get_pcb( curr_pid )->fd_array[ fd ];
 }
 
 /* ------------------ close_all_files ----------------- */
@@ -1128,4 +1261,330 @@ void close_all_files( void )
     }
 }
 
+/* ------------------- sysenter_init ---------------------- */
+/* Sets up the SYSENTER MSRs so user programs can make      */
+/* system calls without going through an interrupt gate.    */
+/* SYSEXIT finds the user code and stack segments at fixed  */
+/* offsets from KERNEL_CS, which our GDT already matches.   */
+/* int $0x80 keeps working either way, and the fast stubs   */
+/* fall back to it when the time page says SYSENTER is off. */
+/* Inputs: None                                             */
+/* Outputs: None                                            */
+/* Side Effects: Writes the SYSENTER MSRs if supported      */
+void sysenter_init( void )
+{
+    uint32_t eax, ebx, ecx, edx;
+
+    /* CPUID leaf 1 tells us whether SYSENTER is there at all */
+    eax = 1;
+    asm volatile( "cpuid"
+                  : "+a" ( eax ), "=b" ( ebx ), "=c" ( ecx ), "=d" ( edx )
+                );
+    if( !( edx & CPUID_SEP_BIT ) )
+    {
+        return;
+    }
+
+    /* wrmsr writes EDX:EAX to the MSR numbered by ECX */
+    asm volatile( "wrmsr" : : "c" ( SYSENTER_CS_MSR ), "a" ( KERNEL_CS ), "d" ( 0 ) );
+    asm volatile( "wrmsr" : : "c" ( SYSENTER_ESP_MSR ),
+                  "a" ( (uint32_t)( sysenter_stack + SYSENTER_STACK_SIZE ) ), "d" ( 0 ) );
+    asm volatile( "wrmsr" : : "c" ( SYSENTER_EIP_MSR ), "a" ( (uint32_t)sysenter_entry ), "d" ( 0 ) );
+
+    sysenter_enabled = 1;
 
+    /* Let the fast stubs in user space know they can use it */
+    time_page->sysenter = 1;
+}
+
+/*--------------------- syscall_nice -------------------- */
+/* Lowers (or raises) the scheduling priority of the      */
+/* calling process. The nice value is the highest MLFQ    */
+/* level the process can be on, from 0 (normal) to        */
+/* SCHED_LEVELS - 1, and is inherited by programs it      */
+/* executes.                                              */
+/* Inputs: increment -> amount to add to the nice value,  */
+/*                      the result is clamped to range.   */
+/* Outputs: The new nice value.                           */
+/* Side Effects: Changes how the scheduler treats the     */
+/*               process.                                 */
+int32_t syscall_nice( int32_t increment )
+{
+    return scheduler_nice( curr_pid, increment );
+}
+
+/*-------------------- syscall_gettime ------------------ */
+/* Reads the monotonic clock, in nanoseconds since boot.  */
+/* Inputs: ns -> user buffer for the 64-bit time          */
+/* Outputs: 0 on success, -1 if ns isn't a user address.  */
+/* Side Effects: Writes *ns.                              */
+int32_t syscall_gettime( uint64_t* ns )
+{
+    if( (uint32_t)ns < USER_START_ADDR ||
+        (uint32_t)ns > USER_END_ADDR - sizeof( uint64_t ) )
+    {
+        return FAILURE;
+    }
+
+    *ns = ktime_ns( );
+    return 0;
+}
+
+/*--------------------- syscall_ioctl ------------------- */
+/* Sends a control command to the driver of an open file. */
+/* Only the terminal takes any; see terminal_ioctl.       */
+/* Inputs: fd  -> file descriptor                         */
+/*         cmd -> driver-specific command                 */
+/*         arg -> argument to the command                 */
+/* Outputs: What the driver returns, or -1 if the file    */
+/*          isn't open or has no control commands.        */
+/* Side Effects: Depends on the command.                  */
+int32_t syscall_ioctl( int32_t fd, uint32_t cmd, uint32_t arg )
+{
+    pcb_t* program_pcb = get_pcb( curr_pid );
+    fops_table_t* fops;
+
+    if( fd > FD_MAX_VAL || fd < 0 || program_pcb->fd_array[ fd ].flags == 0 )
+    {
+        return FAILURE;
+    }
+
+    fops = program_pcb->fd_array[ fd ].fops_ptr;
+    if( fops == NULL || fops->ioctl == NULL )
+    {
+        return FAILURE;
+    }
+    return fops->ioctl( fd, cmd, arg );
+}
+
+/*--------------------- syscall_fork -------------------- */
+/* Starts a copy of the calling process. The child gets   */
+/* a copy of the PCB, open files included, and shares     */
+/* every page of the user page with its parent copy-on-   */
+/* write, so nothing is copied until one of them writes   */
+/* to a page; the page fault handler makes the copy then. */
+/* The child is queued like any ready process and returns */
+/* from the same call with 0 once it is run. Its kernel   */
+/* stack is built from the frame int $0x80 left on ours;  */
+/* sysenter_entry refuses fork, so that frame is always   */
+/* there.                                                 */
+/* Inputs: None.                                          */
+/* Outputs: PID of the child to the parent, 0 to the      */
+/*          child, -1 if there is no PID free.            */
+/* Side Effects: Makes every writable page of the caller  */
+/*               read-only until it is next written.      */
+int32_t syscall_fork( void )
+{
+    pcb_t* parent_pcb = get_pcb( curr_pid );
+    pcb_t* child_pcb;
+    uint32_t* parent_frame;
+    uint32_t* child_frame;
+    int32_t child;
+    int i;
+
+    /* int $0x80 and syscall_wrapper left the user context and  */
+    /* the saved registers right at the top of our stack.       */
+    parent_frame = (uint32_t*)( proc_kernel_stack( curr_pid ) - 4 ) - FORK_FRAME_WORDS;
+
+    child = pid_alloc( );
+    if( child < 0 )
+    {
+        klog( "fork: too many programs are running\n" );
+        return FAILURE;
+    }
+
+    /* The child starts out as a copy of its parent, running the    */
+    /* same program in the same terminal with the same files open.  */
+    child_pcb = get_pcb( child );
+    memcpy( child_pcb, parent_pcb, sizeof( pcb_t ) );
+    child_pcb->pid = child;
+    child_pcb->parent_id = curr_pid;
+    child_pcb->saved_esp = 0;
+    child_pcb->saved_ebp = 0;
+    child_pcb->pages_loaded = 0;
+    child_pcb->pages_copied = 0;
+    child_pcb->forked = 1;
+    child_pcb->exit_status = 0;
+    scheduler_process_init( child, curr_pid );
+
+    for( i = 0; i < MAX_NUM_FILES; i++ )
+    {
+        if( child_pcb->fd_array[ i ].flags && child_pcb->filetype_array[ i ] == RTC_TYPE )
+        {
+            rtc_file_dup( &child_pcb->fd_array[ i ] );
+        }
+    }
+
+    /* Share every present page copy-on-write. Pages not present yet */
+    /* are paged in separately by whoever touches them first.        */
+    user_page_table_reset( child );
+    process_page_directory_init( child );
+    user_page_table_share( curr_pid, child );
+    /* Reloading CR3 drops the parent's writable TLB entries */
+    map_prog_to_page( curr_pid );
+
+    /* Give the child our system call frame, and under it what the  */
+    /* leave and ret at the end of switch_task pop: no saved EBP,   */
+    /* then fork_child_entry to return to.                          */
+    child_frame = (uint32_t*)( proc_kernel_stack( child ) - 4 ) - FORK_FRAME_WORDS;
+    memcpy( child_frame, parent_frame, FORK_FRAME_WORDS * sizeof( uint32_t ) );
+    child_frame[ -1 ] = (uint32_t)fork_child_entry;
+    child_frame[ -2 ] = 0;
+    child_pcb->sched_esp = (uint32_t)&child_frame[ -2 ];
+    child_pcb->sched_ebp = (uint32_t)&child_frame[ -2 ];
+
+    scheduler_process_ready( child );
+    return child;
+}
+
+/*--------------------- syscall_wait -------------------- */
+/* Waits for one of the caller's forked children to exit  */
+/* and collects it, giving its PID back.                  */
+/* Inputs: status -> where to put the child's status, as  */
+/*                   execute would have returned it, or   */
+/*                   NULL if it isn't wanted              */
+/* Outputs: PID of the child that exited, -1 if the       */
+/*          caller has no forked children or status isn't */
+/*          a user address.                               */
+/* Side Effects: Sleeps until a child exits.              */
+int32_t syscall_wait( int32_t* status )
+{
+    uint32_t flags;
+    int32_t exit_status;
+    int32_t child;
+    int32_t pid;
+
+    if( status != NULL &&
+        ( (uint32_t)status < USER_START_ADDR ||
+          (uint32_t)status > USER_END_ADDR - sizeof( int32_t ) ) )
+    {
+        return FAILURE;
+    }
+
+    /* Check for an exited child with interrupts off, so one that */
+    /* exits while we look can't wake the queue before we sleep.  */
+    cli_and_save( flags );
+    while( 1 )
+    {
+        child = FAILURE;
+        for( pid = pid_next( 0 ); pid >= 0; pid = pid_next( pid + 1 ) )
+        {
+            if( get_pcb( pid )->parent_id == curr_pid && get_pcb( pid )->forked )
+            {
+                child = pid;
+                if( get_pcb( pid )->sched_state == SCHED_ZOMBIE )
+                {
+                    break;
+                }
+                child = WAIT_NO_ZOMBIE;
+            }
+        }
+        if( child != WAIT_NO_ZOMBIE )
+        {
+            break;
+        }
+        wait_queue_sleep( &child_exit_queue );
+    }
+
+    if( child < 0 )
+    {
+        restore_flags( flags );
+        return FAILURE;
+    }
+    exit_status = get_pcb( child )->exit_status;
+    reap_child( child );
+    restore_flags( flags );
+
+    if( status != NULL )
+    {
+        *status = exit_status;
+    }
+    return child;
+}
+
+/* ------------------ fork_exit --------------------------- */
+/* The halt of a forked process. Everything it holds is     */
+/* given back, then it stays a zombie holding only its PID  */
+/* and status until its parent waits for it, and switches   */
+/* away for good. With no parent left it frees its own PID. */
+/* Inputs: status       -> status for the parent's wait     */
+/* Outputs: None, never returns                             */
+/* Side Effects: Wakes anyone waiting for a child           */
+static void fork_exit( int32_t status )
+{
+    pcb_t* program_pcb = get_pcb( curr_pid );
+
+    close_all_files( );
+    user_page_table_reset( curr_pid );
+    release_children( curr_pid );
+
+    program_pcb->exit_status = status;
+    program_pcb->vidmap = 0;
+
+    /* The parent can't look at us between the check and us      */
+    /* turning into a zombie, so either it orphans us first or it */
+    /* is sure to find the zombie.                                */
+    cli( );
+    if( terminals[ sched_terminal ].pid == curr_pid )
+    {
+        terminals[ sched_terminal ].pid = -1;
+    }
+    if( program_pcb->parent_id < 0 )
+    {
+        /* Nothing else can take the PID before we switch away */
+        pid_free( curr_pid );
+    }
+    else
+    {
+        wake_up( &child_exit_queue );
+    }
+    scheduler_exit( );
+}
+
+/* ------------------ release_children -------------------- */
+/* Called by a process that is exiting. Nobody can wait for */
+/* its forked children any more, so the ones that already   */
+/* exited are collected now and the rest are orphaned, to   */
+/* free their own PIDs when they exit.                      */
+/* Inputs: pid          -> process that is exiting          */
+/* Outputs: None                                            */
+/* Side Effects: Frees the PIDs of zombie children          */
+static void release_children( int32_t pid )
+{
+    pcb_t* child_pcb;
+    uint32_t flags;
+    int32_t child;
+
+    cli_and_save( flags );
+    for( child = pid_next( 0 ); child >= 0; child = pid_next( child + 1 ) )
+    {
+        child_pcb = get_pcb( child );
+        if( child_pcb->parent_id != pid || !child_pcb->forked )
+        {
+            continue;
+        }
+        if( child_pcb->sched_state == SCHED_ZOMBIE )
+        {
+            reap_child( child );
+        }
+        else
+        {
+            child_pcb->parent_id = -1;
+        }
+    }
+    restore_flags( flags );
+}
+
+/* ------------------ reap_child -------------------------- */
+/* Gives back the PID of a zombie child. Its pooled PCB     */
+/* goes back to the state a fresh slot has, so nobody takes */
+/* the next process in the slot for a zombie before it is   */
+/* set up. Interrupts must be off.                          */
+/* Inputs: child        -> zombie to free                   */
+/* Outputs: None                                            */
+/* Side Effects: Frees the PID                              */
+static void reap_child( int32_t child )
+{
+    get_pcb( child )->sched_state = SCHED_RUNNING;
+    pid_free( child );
+}
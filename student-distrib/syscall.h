@@ -6,6 +6,7 @@
 #include "types.h"
 #include "fops.h"
 #include "paging.h"
+#include "process.h"
 #include "x86_desc.h"
 #include "syscall_wrapper.h"
 #include "keyboard.h"
@@ -19,20 +20,9 @@
                                         /* stdin and stdout. Thus we can only assign    */
                                         /* fd values ( 0-indexed ) 2-7.                 */
 #define MAX_NUM_FILES   8               /* Maximum 8 files open in File Array.          */
-#define MAX_NUM_PROGS   5               /* Maximum 6 programs open (0-indexed).         */
 #define FAILURE         -1              /* Used to return -1 when a function has failed */
-#define EIGHT_MB        0x00800000      /* First PCB starts at 8MB. Since that doesn't  */
-                                        /* translate very nicely in hex, we'll set it   */
-                                        /* to the minimum number of bits needed to      */
-                                        /* represent.                                   */
 #define VIRT_VID_MEM    0x08800000      /* Virtual Video Memory should start at 136 MB. */
 #define FOUR_KB         0x1000          /* Used to adjust video memory addresses        */
-#define EIGHT_KB        0x2000          /* Each PCB starts at 8MB - 8KB * Process Num   */
-                                        /* Process Number is the same as Process ID     */
-                                        /* aka PID. Keep track of the PID for the       */
-                                        /* current process so that we can determine its */
-                                        /* PCB and identify it as needed (for example,  */
-                                        /* in scheduling).                              */
 #define FOUR_MB         0x00400000      /* Used to make sure the screen start address   */
                                         /* is outside the kernel address space          */                                       
 #define MAX_NUM_ARGS    5               /* NOT SURE ABOUT VALUE but used for parsing    */
@@ -49,14 +39,22 @@
 #define IF_ENABLE       0x00000200      /* IF enable for iret context.                  */
 #define BOTTOM          0x083FFFFC      /* The bottom of the memory                     */
 #define EIP_BYTE_OFFSET 24              /* Byte offset for EIP                          */
-#define PID_FREE        0               /* PID Free definition for PID Array searching  */
-#define PID_IN_USE      1               /* PID In Use definition for PID Array search   */
 #define HALT_ERROR      37              /* Error #37 is the halt indicator for error    */
 #define HALT_ERROR_CODE 256             /* due to exception. Return 256 at end of halt  */
                                         /* to indicate such.                            */
+#define SYSENTER_CS_MSR  0x174          /* MSRs read by SYSENTER for the kernel CS, the */
+#define SYSENTER_ESP_MSR 0x175          /* stack pointer to start on and the entry      */
+#define SYSENTER_EIP_MSR 0x176          /* point.                                       */
+#define CPUID_SEP_BIT   0x00000800      /* CPUID.1:EDX bit 11, SYSENTER/SYSEXIT present */
+#define SYSENTER_STACK_SIZE 256         /* Only used until the entry stub loads esp0    */
 #define USER_PAGE       32              /* Page directory index of the user page        */
                                         /* Takes the top 10 bits of user virtual start  */
                                         /* address 0x8000000 */
+#define FORK_FRAME_WORDS 12             /* What int $0x80 and syscall_wrapper leave at  */
+                                        /* the top of the kernel stack: EBX, ECX, EDX,  */
+                                        /* EFLAGS, EDI, ESI, EBP, then EIP, CS, EFLAGS, */
+                                        /* ESP and SS pushed by the processor.          */
+#define WAIT_NO_ZOMBIE  -2              /* Children are running, none has exited        */
 
 /* Struct for Process Control Block (PCB) */
 typedef struct pcb_t {
@@ -74,6 +72,26 @@ typedef struct pcb_t {
         uint32_t        ss0;                             /* SS0 of process, passed down by TSS   */
         /* Also store args and size of for later use (like syscall_getargs)                      */
         uint8_t         saved_command[ BUFFER_SIZE ];    /* Saved command for get_args           */  
+        /* The program image is paged in from the file system on first touch, so keep track   */
+        /* of which file backs it.                                                             */
+        uint32_t        exec_inode;                      /* Inode of the executable              */
+        uint32_t        exec_size;                       /* Size of the executable in bytes      */
+        uint32_t        pages_loaded;                    /* Pages filled in by the fault handler */
+        uint32_t        pages_copied;                    /* Shared pages copied on a write       */
+        /* Scheduling state, see the multilevel feedback queue in scheduling.c                 */
+        int32_t         terminal;                        /* Terminal the process runs in         */
+        uint32_t        sched_state;                     /* Running, ready or sleeping           */
+        uint32_t        sched_level;                     /* MLFQ level, 0 is the highest         */
+        uint32_t        slice_used;                      /* Ticks used of the current time slice */
+        uint32_t        run_ticks;                       /* Ticks spent running in total         */
+        int32_t         nice;                            /* Highest level the process may be on  */
+        uint32_t        vidmap;                          /* Set once the process calls vidmap    */
+        uint32_t        sched_esp;                       /* ESP to resume at when switched to    */
+        uint32_t        sched_ebp;                       /* EBP to resume at when switched to    */
+        /* A forked process has no execute to return to. Its parent collects its status with   */
+        /* wait instead, and until then it stays a zombie.                                      */
+        uint32_t        forked;                          /* Started by fork, not execute         */
+        int32_t         exit_status;                     /* Status given to halt, for wait       */
 
 } pcb_t;
 
@@ -82,9 +100,6 @@ typedef struct pcb_t {
 extern int32_t curr_pid;
 extern int32_t active_pid;
 
-/* Can only have 6 processes open outside of STDIN/OUT   */
-extern int32_t pid_array[MAX_NUM_FILES - 2];
-
 /* Define System Call Functions. Prototypes provided by  */
 /* Appendix B of MP3 Documentation                       */
 int32_t syscall_halt( uint8_t status );
@@ -97,6 +112,11 @@ int32_t syscall_getargs( uint8_t* buf, int32_t nbytes );
 int32_t syscall_vidmap( uint8_t** screen_start );
 int32_t syscall_set_handler( int32_t signum, void* handler_address );
 int32_t syscall_sigreturn( void );
+int32_t syscall_nice( int32_t increment );
+int32_t syscall_gettime( uint64_t* ns );
+int32_t syscall_ioctl( int32_t fd, uint32_t cmd, uint32_t arg );
+int32_t syscall_fork( void );
+int32_t syscall_wait( int32_t* status );
 
 /* Helper functions for our system calls. PCB and map    */
 /* are the most prevalent to all system calls.           */
@@ -105,7 +125,12 @@ int get_args( const uint8_t* command );
 pcb_t* get_pcb(uint32_t pid);
 void switch_context(uint32_t pid);
 void map_prog_to_page( int32_t pid );
+int32_t demand_page_in( uint32_t fault_addr, uint32_t error_code );
 void close_all_files( void );
+void sysenter_init( void );
+
+/* Set to 1 by sysenter_init if the CPU supports SYSENTER/SYSEXIT */
+extern int32_t sysenter_enabled;
 
 /* Arrays for the syscall_execute filename and args.     */
 /* Helper functions will update these arrays as needed.  */
@@ -5,4 +5,10 @@
 /* the wrapper properly.                                         */
 extern void syscall_wrapper( void );
 
+/* Entry point for system calls made with SYSENTER */
+extern void sysenter_entry( void );
+
+/* Where a forked child starts, returning 0 from fork */
+extern void fork_child_entry( void );
+
 #endif
@@ -5,8 +5,9 @@
 #include "scheduling.h"
 
 uint8_t     terminal_buffer[ BUFFER_SIZE ];
-uint32_t    read_ready;
-uint32_t    terminal_vid_mem[ NUM_TERMINALS ][ TERMINAL_MEMORY_SIZE ];
+/* Saved screen of each terminal while it isn't displayed. These are  */
+/* in normal RAM, so the whole VGA text window is free for scrolling. */
+uint8_t     terminal_vid_mem[ NUM_TERMINALS ][ TERMINAL_MEMORY_SIZE ] __attribute__((aligned(TERMINAL_MEMORY_SIZE)));
 
 /* Implemented as a part of the scheduler, initializes  */
 /* the 3 terminal instances with intial bootup method   */
@@ -21,10 +22,12 @@ void terminals_init( void ){
         terminals[i].num_processes = 0;
         terminals[i].initialized = 0;
         terminals[i].pid = -1;
-        terminals[i].saved_esp = 0;
-        terminals[i].saved_ebp = 0;
         /* Set the buffers to null just to be safe      */
         memset(terminals[i].terminal_buffer, '\0', BUFFER_SIZE);
+        wait_queue_init(&terminals[i].read_queue, "terminal read");
+        terminals[i].input.head = 0;
+        terminals[i].input.tail = 0;
+        terminals[i].mode = TERM_MODE_CANON;
     }
 
     sched_terminal = 2;
@@ -79,88 +82,44 @@ int32_t terminal_close( int32_t fd )
 
 
 /*                     terminal_read                    */
-/* Reads data from the keyboard. Read should return the */
-/* data from one line by pressing Enter, or as much as  */
-/* fits in the buffer from one such line. The line read */
-/* SHOULD INCLUDE the line feed ('\n') character.       */
+/* Reads data from the keyboard. In canonical mode,     */
+/* read returns one line, once ENTER has been pressed,  */
+/* or as much of it as fits in the buffer; the rest is  */
+/* left for the next read. The line read SHOULD INCLUDE */
+/* the line feed ('\n') character. In raw mode, read    */
+/* returns whatever keys were pressed since the last    */
+/* read, which may be none, without waiting.            */
+/* Lines typed before the call aren't lost: they wait   */
+/* in the terminal's input ring.                        */
 /* Inputs: fd -> File Descriptor. Unused in terminal    */
 /*               driver.                                */
 /*         buf -> buffer to be filled.                  */
-/*         nbytes -> num of bytes to be read. Unused in */
-/*                   terminal driver.                   */
+/*         nbytes -> most bytes to read.                */
 /* Outputs: Num of bytes read from the keyboard.        */
-/* Side Effects: Fills the Terminal Buffer with the     */
-/* data read from the keyboard.                         */
+/* Side Effects: Takes the bytes read out of the input  */
+/* ring. May sleep until a line is entered.             */
 int32_t terminal_read( int32_t fd, void* buf, int32_t nbytes )
 {
-    /* word_count and keyboard_buffer provided in       */
-    /* keyboard.c. Both are kept track of, and can be   */
-    /* used here to read to the terminal.               */
-
-
-    /* Wait for the signal to read. Will use a global   */
-    /* flag to do so, which will be updated by the      */
-    /* keyboards driver. Set to 0 on start, but wait    */
-    /* for other program to set.                        */
-    read_ready = 0;
-
-    /* Loop while ready flag not raised, or the "Enter" */
-    /* key has not been pressed yet...                  */
-    while( !read_ready ){ }
-
-    /* Reset the read_ready signal in case we try to    */
-    /* run terminal_read again.                         */
-    read_ready = 0;
+    /* Read from the terminal the process runs in, which    */
+    /* need not be the one on screen.                       */
+    terminal_t* terminal = &terminals[ sched_terminal ];
 
     /* Check if the buffer is NULL. If so, then return. */
-    if( buf == NULL )
+    if( buf == NULL || nbytes <= 0 )
     {
-        reset_keyboard_buffer( );
         return 0;
     }
 
-    /* We also need to cast buf as a uint8_t type in    */
-    /* order to function properly, as we cannot do      */
-    /* anything with a void pointer.                    */
-    uint8_t* read_buf = buf;
-
-    /* Reset the terminal buffer so that we can make    */
-    /* sure that commands don't get repeated/input      */
-    /* doesn't get super weird or anything...           */
-    int i;
-    for( i = 0; i < BUFFER_SIZE; i++ )
+    if( terminal->mode == TERM_MODE_RAW )
     {
-        read_buf[ i ] = 0;
+        return input_ring_read( &terminal->input, buf, nbytes, 0 );
     }
 
-    /* Now copy the contents of the keyboard buffer     */
-    /* into the terminal buffer. The buffer should      */
-    /* include the line feed character at the end of    */
-    /* the sequence of characters.                      */
-    int count;
-    count = 0;
-    for( i = 0; i < BUFFER_SIZE; i++ )
-    {
-        /* We have reached the end of the keyboard buffer   */
-        /* if we hit the character '\n'. Thus, we can       */
-        /* keep looping until we get to '\n', in which case */
-        /* we can break the loop and return the number of   */
-        /* characters written.                              */
-        read_buf[ i ] = keyboard_buffer[ display_terminal ][ i ];
-        count++;
-        if( read_buf[ i ] == '\n' )
-        {
-            break;
-        }
-    }
+    /* Sleep until the keyboard handler has put a whole     */
+    /* line in the ring and woken us up.                    */
+    wait_event( &terminal->read_queue, input_ring_has_line( &terminal->input ) );
 
-    /* Clear the keyboard buffer and word_count now that we */
-    /* have taken the data passed through                   */
-    reset_keyboard_buffer( );
-
-    /* Since each character is one byte, we can just return the */
-    /* number of characters written to the buffer!              */
-    return count;
+    return input_ring_read( &terminal->input, buf, nbytes, 1 );
 }
 
 
@@ -203,26 +162,13 @@ int32_t terminal_write( int32_t fd, const void* buf, int32_t nbytes )
     /* the number of bytes is less than the number of           */
     /* characters in the buffer, then the function will only    */
     /* print out as many characters as specified by nbytes.     */
-    int i;
-    uint8_t c;
-    uint32_t num_bytes = 0;
-    for( i = 0; i < nbytes; i++ )
-    {
-        c = write_buf[ i ];
-        /* If character is not valid, then break.   */
-        if( c == '\0' || c == 0 )
-        {
-            break;
-        }
-        keyboard_putc( c );
-        reset_keyboard_buffer( );
-        num_bytes++;
-    }
+    /* Output goes to the terminal the writing process runs in, */
+    /* which is only on screen if it is the displayed one. It   */
+    /* is printed in bulk, without touching the keyboard echo.  */
+    int32_t num_bytes = terminal_puts( sched_terminal, write_buf, nbytes );
 
-    /* Because we used the put_string function, our keyboard    */
-    /* buffer gets filled, thus we need to reset it in order    */
-    /* for our functions to work properly again.                */
-    reset_keyboard_buffer( );
+    /* Put the whole write on screen at once */
+    terminal_flush( sched_terminal );
 
     /* Return the number of bytes read.                         */
     return num_bytes;
@@ -242,18 +188,203 @@ void switch_terminal( uint32_t terminal_target_index )
     }
 
     
-    /* Copy current physical video memory into an alternate     */
-    /* location in virtual memory                               */
-    memcpy((void*) ((VIDEO_ALT_START + display_terminal) * SCHED_FOUR_KB), (void*) VIDEO_MEM_LOC, SCHED_FOUR_KB);  
+    /* Each terminal keeps its screen in its shadow screen and  */
+    /* its own backing page, so nothing has to be read back     */
+    /* from video memory unless a program drew on the screen    */
+    /* through vidmap, which only the screen itself has.        */
+    uint32_t flags;
+    int32_t old_terminal = display_terminal;
+    int32_t old_vidmap = terminal_uses_vidmap( old_terminal );
+    int32_t new_vidmap = terminal_uses_vidmap( terminal_target_index );
+
+    cli_and_save( flags );
+
+    /* Both screens come back live, not scrolled back */
+    scrollback_scroll( old_terminal, -SCROLLBACK_ROWS );
+    scrollback_scroll( terminal_target_index, -SCROLLBACK_ROWS );
+
+    terminal_flush( old_terminal );
+    if( old_vidmap )
+    {
+        memcpy((void*) terminal_vid_mem[ old_terminal ], (void*) terminal_video_page( old_terminal ), SCHED_FOUR_KB);
+    }
+
+    /* A vidmap program in the target drew into its backing     */
+    /* page, so that page is what goes on screen, once any      */
+    /* output still waiting in the shadow has gone into it.     */
+    if( new_vidmap )
+    {
+        terminal_flush( terminal_target_index );
+    }
 
     /* Update the new display terminal */
-    display_terminal = terminal_target_index;     
+    display_terminal = terminal_target_index;
+
+    /* The old terminal's backing page may be behind, since its */
+    /* flushes went to the screen while it was displayed.       */
+    if( !old_vidmap )
+    {
+        terminal_redraw( old_terminal );
+    }
+
+    vga_set_origin( 0 );
+    if( new_vidmap )
+    {
+        memcpy((void*) VIDEO_MEM_LOC, (void*) terminal_vid_mem[ display_terminal ], SCHED_FOUR_KB);
+    }
+    else
+    {
+        terminal_redraw( display_terminal );
+    }
 
-    /* Copy video memory from alternate virtual address to      */
-    /* physical address to be displayed on screen               */
-    memcpy((void*) VIDEO_MEM_LOC, (void*) ((VIDEO_ALT_START + display_terminal) * SCHED_FOUR_KB), SCHED_FOUR_KB);
+    /* The running task may be drawing through vidmap, so move its page */
+    /* to wherever its terminal lives now.                               */
+    set_sched_video_page( );
 
     /* Print the cursor at the corresponding location.*/
     terminal_print_cursor( terminal_y[ display_terminal ], terminal_x[ display_terminal ] );    
+    restore_flags( flags );
 }
 
+
+
+/*                   terminal_ioctl                     */
+/* Controls the terminal the calling process runs in.   */
+/* Inputs: fd -> File Descriptor. Unused in terminal    */
+/*               driver.                                */
+/*         cmd -> TERM_IOCTL_GET_MODE returns the mode, */
+/*                TERM_IOCTL_SET_MODE switches to the   */
+/*                mode in arg, and TERM_IOCTL_FLUSH     */
+/*                throws away unread input.             */
+/*         arg -> argument to cmd.                      */
+/* Outputs: The mode for TERM_IOCTL_GET_MODE, else 0,   */
+/* or -1 for an unknown command or mode.                */
+/* Side Effects: May change how keys are delivered.     */
+int32_t terminal_ioctl( int32_t fd, uint32_t cmd, uint32_t arg )
+{
+    terminal_t* terminal = &terminals[ sched_terminal ];
+
+    switch( cmd )
+    {
+        case TERM_IOCTL_GET_MODE:
+            return terminal->mode;
+
+        case TERM_IOCTL_SET_MODE:
+            if( arg != TERM_MODE_CANON && arg != TERM_MODE_RAW )
+            {
+                return -1;
+            }
+            terminal->mode = arg;
+            return 0;
+
+        case TERM_IOCTL_FLUSH:
+            clear_keyboard_buffer( sched_terminal );
+            return 0;
+
+        default:
+            return -1;
+    }
+}
+
+
+
+/*                   input_ring_put                     */
+/* Adds bytes to an input ring, all of them or, if they */
+/* don't fit, none. Only the keyboard handler calls it, */
+/* so it is the only writer of head.                    */
+/* Inputs: ring -> ring to add to                       */
+/*         data -> bytes to add                         */
+/*         count -> number of bytes                     */
+/* Outputs: count, or 0 if there wasn't room.           */
+/* Side Effects: Publishes the bytes to the reader.     */
+int32_t input_ring_put( input_ring_t* ring, const uint8_t* data, int32_t count )
+{
+    uint32_t head = ring->head;
+    int32_t i;
+
+    if( count <= 0 || INPUT_RING_SIZE - ( head - ring->tail ) < (uint32_t)count )
+    {
+        return 0;
+    }
+
+    for( i = 0; i < count; i++ )
+    {
+        ring->buf[ ( head + i ) & ( INPUT_RING_SIZE - 1 ) ] = data[ i ];
+    }
+
+    /* The bytes have to be in place before the reader can see them */
+    asm volatile( "" : : : "memory" );
+    ring->head = head + count;
+
+    return count;
+}
+
+/*                   input_ring_read                    */
+/* Takes bytes out of an input ring. Only the reader    */
+/* of the terminal calls it, so it is the only writer   */
+/* of tail.                                             */
+/* Inputs: ring -> ring to read from                    */
+/*         buf -> buffer to fill                        */
+/*         nbytes -> most bytes to take                 */
+/*         line -> if set, stop after a '\n'            */
+/* Outputs: Number of bytes taken, 0 if it was empty.   */
+/* Side Effects: Frees the bytes for the handler.       */
+int32_t input_ring_read( input_ring_t* ring, uint8_t* buf, int32_t nbytes, int32_t line )
+{
+    uint32_t tail = ring->tail;
+    uint32_t head = ring->head;
+    int32_t count = 0;
+    uint8_t c;
+
+    /* Don't read bytes before the head that says they're there */
+    asm volatile( "" : : : "memory" );
+
+    while( tail != head && count < nbytes )
+    {
+        c = ring->buf[ tail & ( INPUT_RING_SIZE - 1 ) ];
+        tail++;
+        buf[ count++ ] = c;
+        if( line && c == '\n' )
+        {
+            break;
+        }
+    }
+
+    /* Done with the bytes before handing their space back */
+    asm volatile( "" : : : "memory" );
+    ring->tail = tail;
+
+    return count;
+}
+
+/*                 input_ring_has_line                  */
+/* Checks whether a whole line is waiting in a ring.    */
+/* Inputs: ring -> ring to look in                      */
+/* Outputs: 1 if there is a '\n' to read up to, else 0. */
+/* Side Effects: None.                                  */
+int32_t input_ring_has_line( input_ring_t* ring )
+{
+    uint32_t tail;
+    uint32_t head = ring->head;
+
+    asm volatile( "" : : : "memory" );
+    for( tail = ring->tail; tail != head; tail++ )
+    {
+        if( ring->buf[ tail & ( INPUT_RING_SIZE - 1 ) ] == '\n' )
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*                  input_ring_flush                    */
+/* Throws away everything waiting in a ring. Called on  */
+/* the reader's side, like input_ring_read.             */
+/* Inputs: ring -> ring to empty                        */
+/* Outputs: None.                                       */
+/* Side Effects: Frees all of the ring for the handler. */
+void input_ring_flush( input_ring_t* ring )
+{
+    ring->tail = ring->head;
+}
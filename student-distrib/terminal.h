@@ -1,6 +1,8 @@
 #ifndef _TERMINAL_H
 #define _TERMINAL_H
 
+#include "wait_queue.h"
+
 #define BUFFER_SIZE             128     /* Buffer size and number of terminals      */
 #define NUM_TERMINALS           3       /* outlined by MP3 documentation.           */
 #define SCREEN_SIZE             4096    /* Define the screen size as 4096 to avoid  */
@@ -13,9 +15,32 @@
 #define TERMINAL_MEMORY_START   0xB9000
 #define TERMINAL_MEMORY_SIZE    0x1000
 
+#define INPUT_RING_SIZE         512     /* Typed bytes waiting for a reader. Must   */
+                                        /* be a power of two.                       */
+
+/* Line disciplines a terminal's input can go through */
+#define TERM_MODE_CANON         0       /* Echoed and line edited, read a line at a */
+                                        /* time once ENTER is pressed.              */
+#define TERM_MODE_RAW           1       /* Each key as it is pressed, no echo, and  */
+                                        /* reads never wait.                        */
+
+/* Commands for terminal_ioctl */
+#define TERM_IOCTL_GET_MODE     1       /* Returns the terminal's mode              */
+#define TERM_IOCTL_SET_MODE     2       /* Sets the mode to arg                     */
+#define TERM_IOCTL_FLUSH        3       /* Throws away input not yet read           */
+
 extern uint8_t  terminal_buffer[ BUFFER_SIZE ];
-extern uint32_t terminal_vid_mem[ NUM_TERMINALS ][ TERMINAL_MEMORY_SIZE ];
-extern uint32_t read_ready;
+extern uint8_t  terminal_vid_mem[ NUM_TERMINALS ][ TERMINAL_MEMORY_SIZE ];
+
+/* Keystrokes on their way from the keyboard handler to a reader.   */
+/* Only the handler moves head and only the reader moves tail, so   */
+/* neither side needs a lock or has to turn interrupts off. Both    */
+/* count up forever and are masked to index buf.                    */
+typedef struct input_ring_t {
+    volatile uint32_t head;                   /* Next byte the handler writes         */
+    volatile uint32_t tail;                   /* Next byte the reader takes           */
+    uint8_t  buf[ INPUT_RING_SIZE ];
+} input_ring_t;
 
 /* Struct of terminal and contains necessary info for scheduler  */
 typedef struct terminal_t {
@@ -23,9 +48,10 @@ typedef struct terminal_t {
     uint8_t  terminal_buffer[ TERMINAL_MEMORY_SIZE ];    /* Instance of a terminal buffer for each of the terminals          */
     
     uint32_t initialized;                     /* Flag to determine if a terminal has already been initialized */
-    int32_t  pid;                             /* Process ID # for the current process */
-    uint32_t saved_esp;                       /* ESP of parent to return to           */
-    uint32_t saved_ebp;                       /* EBP of parent to return to           */
+    int32_t  pid;                             /* Process that last ran in the terminal */
+    wait_queue_t read_queue;                  /* terminal_read sleeps here for input  */
+    input_ring_t input;                       /* Typed input not read yet             */
+    uint32_t mode;                            /* TERM_MODE_CANON or TERM_MODE_RAW     */
 } terminal_t;
 
 terminal_t terminals[NUM_TERMINALS];
@@ -38,7 +64,15 @@ extern int32_t terminal_open( const uint8_t* filename );
 extern int32_t terminal_close( int32_t fd );
 extern int32_t terminal_read( int32_t fd, void* buf, int32_t nbytes );
 extern int32_t terminal_write( int32_t fd, const void* buf, int32_t nbytes );
+extern int32_t terminal_ioctl( int32_t fd, uint32_t cmd, uint32_t arg );
 extern  void   switch_terminal( uint32_t terminal_target_index );
+
+/* Input ring helpers. Put is only called by the keyboard handler,  */
+/* read and flush only by the terminal's reader.                    */
+extern int32_t input_ring_put( input_ring_t* ring, const uint8_t* data, int32_t count );
+extern int32_t input_ring_read( input_ring_t* ring, uint8_t* buf, int32_t nbytes, int32_t line );
+extern int32_t input_ring_has_line( input_ring_t* ring );
+extern void    input_ring_flush( input_ring_t* ring );
 extern  void   terminals_init( void );
 
 #endif
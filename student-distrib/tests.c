@@ -8,6 +8,13 @@
 #include "terminal.h"
 #include "syscall.h"
 #include "paging.h"
+#include "serial.h"
+#include "scheduling.h"
+#include "ktime.h"
+#include "klog.h"
+#include "frame.h"
+#include "process.h"
+#include "exec_cache.h"
 
 #define PASS 1
 #define FAIL 0
@@ -159,6 +166,7 @@ void launch_tests( void ){
 	screen_y = 0;
 
 	TEST_OUTPUT("rtc_read_write_test", rtc_read_write_test( ));
+	TEST_OUTPUT("rtc_wait_queue_test", rtc_wait_queue_test( ));
 	
 
 	printf("Testing File Systems Next...\n");
@@ -187,6 +195,38 @@ void launch_tests( void ){
 	printf("\n");
 	TEST_OUTPUT("fs_read_inval_index_test", fs_read_inval_index_test( ));
 	printf("\n");
+	TEST_OUTPUT("fs_dentry_index_test", fs_dentry_index_test( ));
+	printf("\n");
+	TEST_OUTPUT("fops_table_test", fops_table_test( ));
+	printf("\n");
+	TEST_OUTPUT("background_output_test", background_output_test( ));
+	printf("\n");
+	TEST_OUTPUT("shadow_flush_test", shadow_flush_test( ));
+	printf("\n");
+	TEST_OUTPUT("terminal_puts_test", terminal_puts_test( ));
+	printf("\n");
+	TEST_OUTPUT("hw_scroll_test", hw_scroll_test( ));
+	printf("\n");
+	TEST_OUTPUT("scrollback_test", scrollback_test( ));
+	printf("\n");
+	TEST_OUTPUT("input_ring_test", input_ring_test( ));
+	printf("\n");
+	TEST_OUTPUT("serial_test", serial_test( ));
+	printf("\n");
+	TEST_OUTPUT("klog_test", klog_test( ));
+	printf("\n");
+	TEST_OUTPUT("vidmap_remap_test", vidmap_remap_test( ));
+	printf("\n");
+	TEST_OUTPUT("ktime_test", ktime_test( ));
+	printf("\n");
+	TEST_OUTPUT("time_page_test", time_page_test( ));
+	printf("\n");
+	TEST_OUTPUT("rtc_virtual_test", rtc_virtual_test( ));
+	printf("\n");
+	TEST_OUTPUT("frame_alloc_test", frame_alloc_test( ));
+	printf("\n");
+	TEST_OUTPUT("pid_alloc_test", pid_alloc_test( ));
+	printf("\n");
 
 	printf("Continuing...\n");
 	for (i = 0; i < VERY_LARGE_NUM_SLEEP; i++) {}
@@ -211,6 +251,7 @@ void launch_tests( void ){
 	screen_y = 0;
 	
 	TEST_OUTPUT("fs_print_large_file", fs_print_large_file());
+	TEST_OUTPUT("fs_read_data_seek_test", fs_read_data_seek_test());
 	for (i = 0; i < VERY_LARGE_NUM_SLEEP / 2; i++) {}
 	clear_and_reset_screen( );
 	screen_x = 0;
@@ -260,6 +301,11 @@ void launch_tests( void ){
 #if RUN_CHECKPOINT3_TESTS
 	/* Test if the specified system call vector calls properly...	*/
 	syscall_call_test( );
+	TEST_OUTPUT("demand_paging_test", demand_paging_test( ));
+	TEST_OUTPUT("exec_cache_test", exec_cache_test( ));
+	TEST_OUTPUT("fork_cow_test", fork_cow_test( ));
+	TEST_OUTPUT("sched_nice_test", sched_nice_test( ));
+	TEST_OUTPUT("pit_cmdline_test", pit_cmdline_test( ));
 #endif
 
 #if RUN_CHECKPOINT4_TESTS
@@ -801,6 +847,79 @@ int fs_read_inval_index_test( void )
 	}
 }
 
+/* DENTRY HASH INDEX TEST */
+/* Looks up every directory entry by its own name through the  */
+/* hash index and checks that the same entry comes back. Also  */
+/* checks that misses are counted in the lookup statistics.    */
+/* Inputs: None									   			   */
+/* Outputs: Will return PASS if every name resolves correctly  */
+/* Side Effects: Updates fs_lookup_stats			           */
+/* Coverage: dentry_index_init(), read_dentry_by_name() in	   */
+/*			 file_system.c							       	   */
+int fs_dentry_index_test( void )
+{
+	TEST_HEADER;
+	dentry_t by_index;
+	dentry_t by_name;
+	uint8_t name[MAX_FILE_LENGTH + 1];
+	uint32_t i;
+	uint32_t misses;
+
+	for (i = 0; i < p_boot_block_addr->num_dir_entries; i++) {
+		if (read_dentry_by_index(i, &by_index) == -1) {
+			return FAIL;
+		}
+		memset(name, '\0', sizeof(name));
+		strncpy((int8_t*) name, (int8_t*) by_index.file_name, MAX_FILE_LENGTH);
+		if (read_dentry_by_name(name, &by_name) == -1) {
+			return FAIL;
+		}
+		if (by_name.index_node_num != by_index.index_node_num ||
+			by_name.file_type != by_index.file_type) {
+			return FAIL;
+		}
+	}
+
+	misses = fs_lookup_stats.misses;
+	if (read_dentry_by_name((const uint8_t*) "shel", &by_name) != -1 ||
+		read_dentry_by_name((const uint8_t*) "", &by_name) != -1) {
+		return FAIL;
+	}
+	if (fs_lookup_stats.misses != misses + 2) {
+		return FAIL;
+	}
+
+	printf("lookups: %d, hits: %d, last: %d cycles, max: %d cycles\n",
+		   fs_lookup_stats.lookups, fs_lookup_stats.hits,
+		   fs_lookup_stats.last_cycles, fs_lookup_stats.max_cycles);
+	return PASS;
+}
+
+/* FOPS TABLE TEST */
+/* Checks that every file type gets its own table, so binding	*/
+/* one file's table at open can't change another open file's,	*/
+/* and that stdin can't be written and stdout can't be read.	*/
+/* Inputs: None									   			   */
+/* Outputs: Will return PASS if the tables are set up right	   */
+/* Side Effects: None								           */
+/* Coverage: get_*_table() in fops.c						   */
+int fops_table_test( void )
+{
+	TEST_HEADER;
+	fops_table_t* rtc_fops = get_RTC_table( );
+	fops_table_t* file_fops = get_file_table( );
+
+	if (rtc_fops == file_fops || rtc_fops->read != rtc_read ||
+		file_fops->read != file_read || get_dir_table( )->read != dir_read) {
+		return FAIL;
+	}
+	if (get_stdin_table( )->write != NULL || get_stdin_table( )->read != terminal_read ||
+		get_stdout_table( )->read != NULL || get_stdout_table( )->write != terminal_write) {
+		return FAIL;
+	}
+	return PASS;
+}
+
 /* PRINT ALL FILES TEST */
 /* Prints all files in the given directory "."	   			   */ 
 /* Inputs: None									   			   */
@@ -953,6 +1072,60 @@ int fs_print_large_file( void )
 	return PASS;
 }
 
+/* READ DATA SEEK TEST */
+/* Reads the first three blocks of the large text file in one	*/
+/* call, then re-reads windows that start at odd offsets and 	*/
+/* straddle block boundaries, checking they match byte for byte	*/
+/* Inputs: None									   			   */
+/* Outputs: Will return PASS if every window matches			*/
+/* Side Effects: None								           */
+/* Coverage: read_data() in file_system.c	   					*/
+int fs_read_data_seek_test( void )
+{
+	TEST_HEADER;
+	static uint8_t whole_buf[SIZE_DATA_BLOCK * 3];
+	static uint8_t window_buf[SIZE_DATA_BLOCK + 1];
+	uint32_t offsets[] = { 1, SIZE_DATA_BLOCK - 1, SIZE_DATA_BLOCK, SIZE_DATA_BLOCK + 157 };
+	uint32_t file_size;
+	uint32_t i;
+	uint32_t j;
+	dentry_t test_dentry;
+
+	if (read_dentry_by_name((const uint8_t*) "verylargetextwithverylongname.tx", &test_dentry) == -1) {
+		return FAIL;
+	}
+	file_size = (p_inode_addr + test_dentry.index_node_num)->file_size;
+	if (file_size < SIZE_DATA_BLOCK * 3) {
+		return FAIL;
+	}
+
+	if (read_data(test_dentry.index_node_num, 0, whole_buf, SIZE_DATA_BLOCK * 3) != SIZE_DATA_BLOCK * 3) {
+		return FAIL;
+	}
+
+	for (i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+		if (read_data(test_dentry.index_node_num, offsets[i], window_buf, SIZE_DATA_BLOCK + 1) != SIZE_DATA_BLOCK + 1) {
+			return FAIL;
+		}
+		for (j = 0; j < SIZE_DATA_BLOCK + 1; j++) {
+			if (window_buf[j] != whole_buf[offsets[i] + j]) {
+				return FAIL;
+			}
+		}
+	}
+
+	/* Reads at or past the end of the file return nothing, reads that */
+	/* run off the end are cut short at the end of the file            */
+	if (read_data(test_dentry.index_node_num, file_size, window_buf, 1) != 0) {
+		return FAIL;
+	}
+	if (read_data(test_dentry.index_node_num, file_size - 1, window_buf, SIZE_DATA_BLOCK) != 1) {
+		return FAIL;
+	}
+
+	return PASS;
+}
+
 /* TERMINAL OPEN TEST */
 /* Tests if the terminal_open( ) function of the terminal		*/
 /* drivers works as expected. 									*/
@@ -1312,6 +1485,679 @@ int rtc_close_test( void ) {
 	return PASS;
 }
 
+/* rtc_wait_queue_test											*/
+/* Reads the RTC a few times and checks that each read went to	*/
+/* sleep on the RTC wait queue and was woken by the handler.	*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: Leaves the RTC at 2 Hz	after rtc_close			*/
+int rtc_wait_queue_test( void ) {
+	TEST_HEADER;
+
+	uint32_t sleeps;
+	uint32_t wakeups;
+	uint32_t freq = 1024;
+	int i;
+
+	rtc_write(NULL, &freq, 4);
+	enable_irq(RTC_IRQ_NUM);
+
+	sleeps = rtc_wait_queue.sleeps;
+	wakeups = rtc_wait_queue.wakeups;
+	for (i = 0; i < 4; i++) {
+		if (rtc_read(NULL, NULL, 0) != 0) {
+			return FAIL;
+		}
+	}
+	rtc_close(NULL);
+
+	if (rtc_wait_queue.sleeps < sleeps + 4 || rtc_wait_queue.wakeups < wakeups + 4 ||
+		rtc_wait_queue.waiters != 0) {
+		return FAIL;
+	}
+	wait_queue_print_stats(&rtc_wait_queue);
+	return PASS;
+}
+
+/* background_output_test										*/
+/* Prints a character to a terminal that isn't displayed and	*/
+/* checks a flush puts it in that terminal's saved page, not	*/
+/* on screen.													*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: None, restores the terminal afterwards			*/
+int background_output_test( void ) {
+	TEST_HEADER;
+
+	int32_t term = ( display_terminal + 1 ) % NUM_TERMINALS;
+	char* page = terminal_video_page( term );
+	uint8_t saved_char = page[0];
+	uint8_t screen_char = *(uint8_t*) VIDEO_MEM_LOC;
+	int saved_x = terminal_x[term];
+	int saved_y = terminal_y[term];
+	int result = PASS;
+
+	if (terminal_video_page( display_terminal ) != (char*) VIDEO_MEM_LOC ||
+		page == (char*) VIDEO_MEM_LOC) {
+		return FAIL;
+	}
+
+	terminal_x[term] = 0;
+	terminal_y[term] = 0;
+	terminal_putc( term, ( saved_char == 'Z' ) ? 'Y' : 'Z' );
+	terminal_flush( term );
+	if (page[0] == saved_char || *(uint8_t*) VIDEO_MEM_LOC != screen_char ||
+		terminal_x[term] != 1 || terminal_y[term] != 0) {
+		result = FAIL;
+	}
+
+	/* Rub it out of the shadow screen too */
+	terminal_putc( term, BACKSPACE );
+	page[0] = saved_char;
+	terminal_x[term] = saved_x;
+	terminal_y[term] = saved_y;
+	return result;
+}
+
+/* shadow_flush_test											*/
+/* Prints to the displayed terminal and checks video memory	*/
+/* only changes once the terminal is flushed.					*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: Rubs the character out again afterwards		*/
+int shadow_flush_test( void ) {
+	TEST_HEADER;
+
+	int32_t term = display_terminal;
+	int32_t cell = NUM_COLS * terminal_y[term] + terminal_x[term];
+	uint8_t* screen = (uint8_t*) terminal_video_page( term );
+	uint8_t c = ( screen[cell << 1] == 'Q' ) ? 'R' : 'Q';
+	int result = PASS;
+
+	if (terminal_x[term] >= NUM_COLS) {
+		return PASS;
+	}
+
+	terminal_putc( term, c );
+	if (screen[cell << 1] == c) {
+		result = FAIL;
+	}
+	terminal_flush( term );
+	if (screen[cell << 1] != c || screen[(cell << 1) + 1] != ATTRIB) {
+		result = FAIL;
+	}
+
+	terminal_putc( term, BACKSPACE );
+	terminal_flush( term );
+	if (screen[cell << 1] != ' ') {
+		result = FAIL;
+	}
+	return result;
+}
+
+/* terminal_puts_test											*/
+/* Writes 30 numbered lines to a background terminal in one	*/
+/* go, and checks it scrolled the right amount and left the	*/
+/* keyboard buffer alone.										*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: Blanks the background terminal's screen		*/
+int terminal_puts_test( void ) {
+	TEST_HEADER;
+
+	int32_t term = ( display_terminal + 1 ) % NUM_TERMINALS;
+	uint8_t out[30 * 4];
+	uint8_t blank[NUM_ROWS];
+	char* page = terminal_video_page( term );
+	int32_t words = word_count[term];
+	int i;
+	int result = PASS;
+
+	for (i = 0; i < 30; i++) {
+		out[i * 4] = 'L';
+		out[i * 4 + 1] = '0' + i / 10;
+		out[i * 4 + 2] = '0' + i % 10;
+		out[i * 4 + 3] = '\n';
+	}
+	memset( blank, '\n', NUM_ROWS );
+
+	terminal_x[term] = 0;
+	terminal_y[term] = 0;
+	if (terminal_puts( term, out, sizeof( out ) ) != sizeof( out )) {
+		result = FAIL;
+	}
+	terminal_flush( term );
+
+	/* Line 29 ends up second from the bottom, line 6 at the top */
+	if (terminal_x[term] != 0 || terminal_y[term] != NUM_ROWS - 1 ||
+		page[(NUM_ROWS - 2) * NUM_COLS * 2 + 2] != '2' || page[(NUM_ROWS - 2) * NUM_COLS * 2 + 4] != '9' ||
+		page[2] != '0' || page[4] != '6' || word_count[term] != words) {
+		result = FAIL;
+	}
+
+	/* Stops at a NUL */
+	if (terminal_puts( term, (uint8_t*)"ab\0cd", 5 ) != 2 || terminal_x[term] != 2) {
+		result = FAIL;
+	}
+
+	terminal_puts( term, blank, NUM_ROWS );
+	terminal_flush( term );
+	terminal_x[term] = 0;
+	terminal_y[term] = 0;
+	return result;
+}
+
+/* hw_scroll_test												*/
+/* Scrolls the displayed terminal by a line and checks the	*/
+/* screen moved one row down the VGA window (or wrapped to	*/
+/* the top), and that the CRTC start address agrees.			*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: Scrolls the screen by a line					*/
+int hw_scroll_test( void ) {
+	TEST_HEADER;
+
+	int32_t term = display_terminal;
+	char* before = terminal_video_page( term );
+	char* after;
+	uint32_t start;
+
+	terminal_flush( term );
+	terminal_y[term] = NUM_ROWS - 1;
+	terminal_puts( term, (uint8_t*)"\n", 1 );
+	terminal_flush( term );
+	after = terminal_video_page( term );
+
+	if (after != before + NUM_COLS * 2 && after != (char*) VIDEO_MEM_LOC) {
+		return FAIL;
+	}
+
+	outb( VGA_HIGH_BYTE_OFF, VGA_BASE1 );
+	start = inb( VGA_BASE2 ) << HIGH_BYTE_SHIFT;
+	outb( VGA_LOW_BYTE_OFF, VGA_BASE1 );
+	start |= inb( VGA_BASE2 );
+	if ((char*) VIDEO_MEM_LOC + start * 2 != after) {
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* vidmap_remap_test											*/
+/* Points the vidmap page at a background terminal's backing	*/
+/* page and back at the screen, checking the page table entry	*/
+/* each time, for a process that called vidmap. Then checks	*/
+/* one that never did can't reach the page from user space.	*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: Takes a PID for the test and gives it back,	*/
+/*				 restores the entry afterwards				*/
+int vidmap_remap_test( void ) {
+	TEST_HEADER;
+
+	int32_t term = ( display_terminal + 1 ) % NUM_TERMINALS;
+	page_table_entry_t saved = vid_page_table[0];
+	int32_t saved_pid = curr_pid;
+	int32_t pid = pid_alloc( );
+	int result = PASS;
+
+	if (pid < 0) {
+		return FAIL;
+	}
+	curr_pid = pid;
+
+	get_pcb( pid )->vidmap = 1;
+	set_non_displayed_video_page( term );
+	if (!vid_page_table[0].present || !vid_page_table[0].user_supervisor ||
+		vid_page_table[0].virtual_address != (uint32_t) terminal_vid_mem[term] / FOUR_KB) {
+		result = FAIL;
+	}
+	set_video_page_to_reg( );
+	if (!vid_page_table[0].present || !vid_page_table[0].user_supervisor ||
+		vid_page_table[0].virtual_address != VIDEO_MEM_LOC / FOUR_KB) {
+		result = FAIL;
+	}
+
+	/* Switching to a process without vidmap takes the page away */
+	get_pcb( pid )->vidmap = 0;
+	set_video_page_to_reg( );
+	if (vid_page_table[0].present || vid_page_table[0].user_supervisor) {
+		result = FAIL;
+	}
+	set_non_displayed_video_page( term );
+	if (vid_page_table[0].present || vid_page_table[0].user_supervisor) {
+		result = FAIL;
+	}
+
+	curr_pid = saved_pid;
+	pid_free( pid );
+	vid_page_table[0] = saved;
+	flush_tlb_entry( VIRT_VID_MEM );
+	return result;
+}
+
+/* scrollback_test												*/
+/* Prints 30 lines to a background terminal from the top	*/
+/* and checks the 6 that scrolled off are in its history,	*/
+/* newest first. Then scrolls the displayed terminal back a	*/
+/* row and checks the history shows at the top of the		*/
+/* screen, and that coming back puts the live screen back.	*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: Prints to a background terminal			*/
+int scrollback_test( void ) {
+	TEST_HEADER;
+
+	int32_t term = ( display_terminal + 1 ) % NUM_TERMINALS;
+	uint8_t out[30 * 4];
+	uint8_t blank[NUM_ROWS];
+	uint16_t live[NUM_COLS];
+	const uint16_t* row;
+	int i;
+	int result = PASS;
+
+	for (i = 0; i < 30; i++) {
+		out[i * 4] = 'L';
+		out[i * 4 + 1] = '0' + i / 10;
+		out[i * 4 + 2] = '0' + i % 10;
+		out[i * 4 + 3] = '\n';
+	}
+	memset( blank, '\n', NUM_ROWS );
+
+	terminal_x[term] = 0;
+	terminal_y[term] = 0;
+	terminal_puts( term, out, sizeof( out ) );
+	for (i = 1; i <= 6; i++) {
+		row = scrollback_row( term, i );
+		if (row == NULL || row[0] != SHADOW_CELL( 'L' ) || row[1] != SHADOW_CELL( '0' ) ||
+			row[2] != SHADOW_CELL( '0' + 6 - i )) {
+			result = FAIL;
+		}
+	}
+	terminal_puts( term, blank, NUM_ROWS );
+	terminal_flush( term );
+	terminal_x[term] = 0;
+	terminal_y[term] = 0;
+
+	/* Look one row back on the displayed terminal */
+	term = display_terminal;
+	row = scrollback_row( term, 1 );
+	if (row != NULL) {
+		terminal_flush( term );
+		memcpy( live, terminal_video_page( term ), sizeof( live ) );
+		scrollback_scroll( term, 1 );
+		for (i = 0; i < NUM_COLS; i++) {
+			if (((uint16_t*)VIDEO_MEM_LOC)[i] != row[i]) {
+				result = FAIL;
+			}
+		}
+		scrollback_scroll( term, -SCROLLBACK_ROWS );
+		for (i = 0; i < NUM_COLS; i++) {
+			if (((uint16_t*)terminal_video_page( term ))[i] != live[i]) {
+				result = FAIL;
+			}
+		}
+	}
+	return result;
+}
+
+/* input_ring_test												*/
+/* Checks the input ring hands lines over whole or in		*/
+/* pieces, keeps typeahead, refuses what doesn't fit, and	*/
+/* that a terminal in raw mode reads without waiting.		*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: Flushes the input of the running terminal	*/
+int input_ring_test( void ) {
+	TEST_HEADER;
+
+	static input_ring_t ring;
+	uint8_t buf[INPUT_RING_SIZE];
+	int32_t mode;
+	int result = PASS;
+
+	ring.head = ring.tail = 0;
+	if (input_ring_has_line( &ring ) || input_ring_read( &ring, buf, sizeof( buf ), 1 ) != 0) {
+		result = FAIL;
+	}
+
+	/* Two lines typed ahead, the first read in two pieces */
+	input_ring_put( &ring, (uint8_t*)"ab\n", 3 );
+	input_ring_put( &ring, (uint8_t*)"cd", 2 );
+	if (!input_ring_has_line( &ring ) || input_ring_read( &ring, buf, 1, 1 ) != 1 || buf[0] != 'a' ||
+		input_ring_read( &ring, buf, sizeof( buf ), 1 ) != 2 || buf[0] != 'b' || buf[1] != '\n' ||
+		input_ring_has_line( &ring )) {
+		result = FAIL;
+	}
+	input_ring_put( &ring, (uint8_t*)"\n", 1 );
+	if (input_ring_read( &ring, buf, sizeof( buf ), 0 ) != 3 || buf[0] != 'c' || buf[2] != '\n') {
+		result = FAIL;
+	}
+
+	/* All or nothing once it fills, across the wrap */
+	memset( buf, 'x', sizeof( buf ) );
+	if (input_ring_put( &ring, buf, INPUT_RING_SIZE ) != INPUT_RING_SIZE ||
+		input_ring_put( &ring, buf, 1 ) != 0) {
+		result = FAIL;
+	}
+	input_ring_flush( &ring );
+
+	/* Raw mode reads nothing right away instead of sleeping */
+	mode = terminal_ioctl( 0, TERM_IOCTL_GET_MODE, 0 );
+	terminal_ioctl( 0, TERM_IOCTL_FLUSH, 0 );
+	if (terminal_ioctl( 0, TERM_IOCTL_SET_MODE, TERM_MODE_RAW ) != 0 ||
+		terminal_read( 0, buf, sizeof( buf ) ) != 0 ||
+		terminal_ioctl( 0, TERM_IOCTL_SET_MODE, 7 ) != -1) {
+		result = FAIL;
+	}
+	terminal_ioctl( 0, TERM_IOCTL_SET_MODE, mode );
+	return result;
+}
+
+/* serial_test													*/
+/* Checks "serial" opens by name without a file system		*/
+/* entry, and if COM1 is there, that a write is queued and	*/
+/* goes out.													*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: Writes a line to COM1						*/
+int serial_test( void ) {
+	TEST_HEADER;
+
+	uint8_t line[] = "serial_test\n";
+	int result = PASS;
+
+	if (get_device_table( (uint8_t*)"serial" ) == NULL || get_device_table( (uint8_t*)"seria" ) != NULL ||
+		get_device_table( (uint8_t*)"serial0" ) != NULL) {
+		result = FAIL;
+	}
+
+	if (serial_present) {
+		if (serial_open( (uint8_t*)"serial" ) != 0 ||
+			serial_write( 0, line, sizeof( line ) - 1 ) != sizeof( line ) - 1 ||
+			serial_write( 0, NULL, 1 ) != -1) {
+			result = FAIL;
+		}
+		serial_drain( );
+	}
+	return result;
+}
+
+/* klog_test														*/
+/* Logs a line and reads it back from the end of the log,		*/
+/* checking the timestamp in front, the newline added after,	*/
+/* and that "dmesg" opens by name.								*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: Adds a line to the kernel log					*/
+int klog_test( void ) {
+	TEST_HEADER;
+
+	uint8_t buf[ KLOG_LINE_MAX ];
+	int8_t expect[] = "klog_test 42\n";
+	uint32_t pos = 0;
+	int32_t count, len, i;
+	int result = PASS;
+
+	/* Skip whatever was logged before */
+	while (klog_read( &pos, buf, sizeof( buf ) ) != 0) {}
+
+	klog( "klog_test %d", 42 );
+	count = klog_read( &pos, buf, sizeof( buf ) );
+	len = strlen( expect );
+	if (count <= len || buf[ 0 ] != '[' || klog_read( &pos, buf, sizeof( buf ) ) != 0) {
+		return FAIL;
+	}
+	for (i = 0; i < len; i++) {
+		if (buf[ count - len + i ] != expect[ i ]) {
+			result = FAIL;
+		}
+	}
+
+	if (get_device_table( (uint8_t*)"dmesg" ) == NULL || dmesg_write( 0, buf, 1 ) != -1) {
+		result = FAIL;
+	}
+	return result;
+}
+
+/* ktime_test													*/
+/* Checks the 64-bit divide helper, that ktime_ns doesn't go	*/
+/* backwards, and that it agrees with the RTC over two 64 Hz	*/
+/* periods. gettime must refuse a kernel pointer.				*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: Sets the RTC to 64 Hz							*/
+int ktime_test( void ) {
+	TEST_HEADER;
+
+	uint32_t rem;
+	uint64_t start, elapsed, ns;
+	int32_t freq = 64;
+
+	if (div_u64_u32( 1000000000007ULL, 1000, &rem ) != 1000000000ULL || rem != 7) {
+		return FAIL;
+	}
+	if (syscall_gettime( &ns ) != -1) {
+		return FAIL;
+	}
+
+	start = ktime_ns( );
+	if (ktime_ns( ) < start) {
+		return FAIL;
+	}
+
+	/* Without the TSC there's no PIT running in tests to count with */
+	if (tsc_khz == 0) {
+		return PASS;
+	}
+	printf("TSC: %u kHz\n", tsc_khz);
+
+	rtc_write(NULL, &freq, 4);
+	rtc_read(NULL, NULL, 0);
+	start = ktime_ns( );
+	rtc_read(NULL, NULL, 0);
+	rtc_read(NULL, NULL, 0);
+	elapsed = ktime_ns( ) - start;
+
+	/* Two periods are 31.25ms */
+	if (elapsed < 20 * NSEC_PER_MSEC || elapsed > 45 * NSEC_PER_MSEC) {
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* time_page_test												*/
+/* Checks the time page is mapped read-only for user space at	*/
+/* VIRT_TIME_PAGE, and that RTC interrupts show up in it.		*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: Sets the RTC to 64 Hz							*/
+int time_page_test( void ) {
+	TEST_HEADER;
+
+	uint32_t pde = VIRT_TIME_PAGE >> PDE_SHIFT;
+	uint32_t pte = ( VIRT_TIME_PAGE >> SHIFT_12_VIRTUAL_ADDR ) & PTE_INDEX_MASK;
+	volatile time_page_t* user_view = (volatile time_page_t*) VIRT_TIME_PAGE;
+	uint32_t rtc_ticks;
+	int32_t freq = 64;
+
+	if (!page_directory[pde].present || !page_directory[pde].user_supervisor ||
+		!vid_page_table[pte].present || !vid_page_table[pte].user_supervisor ||
+		vid_page_table[pte].read_write) {
+		return FAIL;
+	}
+	if (user_view->tsc_khz != tsc_khz || user_view->tsc_shift != KTIME_SHIFT) {
+		return FAIL;
+	}
+
+	rtc_write(NULL, &freq, 4);
+	rtc_ticks = user_view->rtc_ticks;
+	rtc_read(NULL, NULL, 0);
+	if (user_view->rtc_ticks == rtc_ticks || user_view->rtc_hz != freq) {
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* rtc_virtual_test												*/
+/* Gives two open files different rates and checks the chip	*/
+/* runs at the faster one, the slower file still ticks at its	*/
+/* own rate, and closing the fast file slows the chip again.	*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: None, restores the kernel's open files		*/
+int rtc_virtual_test( void ) {
+	TEST_HEADER;
+
+	open_file_t saved_fast = file_array[2];
+	open_file_t saved_slow = file_array[3];
+	int32_t fast = 512;
+	int32_t slow = 8;
+	int32_t bad = 3;
+	uint32_t ticks;
+	int result = PASS;
+
+	file_array[2].rtc_divider = 0;
+	file_array[3].rtc_divider = 0;
+	enable_irq(RTC_IRQ_NUM);
+
+	if (rtc_write(2, &fast, 4) != 0 || rtc_write(3, &slow, 4) != 0 ||
+		rtc_write(3, &bad, 4) != -1 || time_page->rtc_hz != fast) {
+		result = FAIL;
+	}
+
+	/* Once in step, each 8 Hz tick is 64 ticks of the chip. One may	*/
+	/* slip in before ticks is read.									*/
+	rtc_read(3, NULL, 0);
+	ticks = time_page->rtc_ticks;
+	rtc_read(3, NULL, 0);
+	ticks = time_page->rtc_ticks - ticks;
+	if (ticks > fast / slow || ticks < fast / slow - 2) {
+		result = FAIL;
+	}
+
+	rtc_close(2);
+	if (time_page->rtc_hz >= fast || time_page->rtc_hz < slow) {
+		result = FAIL;
+	}
+	rtc_close(3);
+
+	file_array[2] = saved_fast;
+	file_array[3] = saved_slow;
+	return result;
+}
+
+/* frame_alloc_test												*/
+/* Allocates blocks of a few sizes, checks they are aligned to	*/
+/* their size and don't overlap, and that freeing them merges	*/
+/* the free lists back to how they were. A second free of the	*/
+/* same block must be refused.									*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: None											*/
+int frame_alloc_test( void ) {
+	TEST_HEADER;
+
+	frame_stats_t before, after;
+	uint32_t small, other, big;
+	int k;
+	int result = PASS;
+
+	frame_get_stats( &before );
+	if (before.total_frames == 0 || frame_alloc( FRAME_MAX_ORDER + 1 ) != 0) {
+		return FAIL;
+	}
+
+	small = frame_alloc( 0 );
+	other = frame_alloc( 0 );
+	big = frame_alloc( 3 );
+	if (small == 0 || other == 0 || big == 0 || small == other ||
+		( big & ( ( FRAME_SIZE << 3 ) - 1 ) ) != 0 ||
+		( small >= big && small < big + ( FRAME_SIZE << 3 ) )) {
+		result = FAIL;
+	}
+
+	frame_get_stats( &after );
+	if (after.free_frames != before.free_frames - 10) {
+		result = FAIL;
+	}
+
+	frame_free( small, 0 );
+	frame_free( other, 0 );
+	frame_free( big, 3 );
+	frame_free( big, 3 );
+	frame_get_stats( &after );
+	if (after.free_frames != before.free_frames || after.frees != before.frees + 3) {
+		result = FAIL;
+	}
+	for (k = 0; k < FRAME_NUM_ORDERS; k++) {
+		if (after.free_blocks[k] != before.free_blocks[k]) {
+			result = FAIL;
+		}
+	}
+	return result;
+}
+
+/* pid_alloc_test												*/
+/* Hands out PIDs until none are left, checking each is the	*/
+/* lowest free one and that its PCB is where get_pcb says,		*/
+/* aligned to a cache line and writable. A PID given back		*/
+/* comes out again next, reusing its pooled slot.				*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: Backs every free slot it can, which stay in	*/
+/* the pool. Gives back every PID it took.						*/
+int pid_alloc_test( void ) {
+	TEST_HEADER;
+
+	static int32_t pids[ PROC_MAX ];
+	proc_stats_t before, after;
+	int32_t num_pids = 0;
+	int32_t pid;
+	int i;
+	int result = PASS;
+
+	proc_get_stats( &before );
+	while ((pid = pid_alloc( )) >= 0) {
+		if (( num_pids > 0 && pid <= pids[num_pids - 1] ) || !pid_in_use( pid ) ||
+			( (uint32_t)get_pcb( pid ) & ( CACHE_LINE_SIZE - 1 ) ) != 0 ||
+			proc_kernel_stack( pid ) != (uint32_t)get_pcb( pid ) + PROC_KSTACK_SIZE) {
+			result = FAIL;
+		}
+		get_pcb( pid )->pid = pid;
+		pids[num_pids++] = pid;
+	}
+	if (num_pids == 0) {
+		return FAIL;
+	}
+
+	/* Every PCB kept what was written to it */
+	for (i = 0; i < num_pids; i++) {
+		if (get_pcb( pids[i] )->pid != pids[i] || pid_next( pids[i] ) != pids[i]) {
+			result = FAIL;
+		}
+	}
+
+	/* A freed PID is the lowest free one again, and needs no new slot */
+	proc_get_stats( &after );
+	pid_free( pids[num_pids / 2] );
+	if (pid_in_use( pids[num_pids / 2] ) || pid_alloc( ) != pids[num_pids / 2]) {
+		result = FAIL;
+	}
+	proc_get_stats( &before );
+	if (before.pooled != after.pooled) {
+		result = FAIL;
+	}
+
+	for (i = 0; i < num_pids; i++) {
+		pid_free( pids[i] );
+	}
+	proc_get_stats( &after );
+	if (after.in_use != before.in_use - num_pids) {
+		result = FAIL;
+	}
+	return result;
+}
+
 /* rtc_read_write_test											*/
 /* Tests the read_write functionality of the rtc driver 		*/
 /* Inputs:None										  			*/
@@ -1390,7 +2236,7 @@ void syscall_call_test( void )
 
 	/* Set up a PCB to simulate a program, also map to page.	*/
 	curr_pid = 0;
-    pcb_t* program_pcb = (pcb_t*)( EIGHT_MB - EIGHT_KB * ( curr_pid + 1 ) );
+    pcb_t* program_pcb = get_pcb( curr_pid );
 
 	/* Declare a vector for syscalls.	*/
 	uint32_t vector;
@@ -1707,5 +2553,425 @@ void syscall_call_test( void )
 }
 #endif
 
+/* test_restore_address_space									*/
+/* Puts back the process a paging test found running, and its	*/
+/* page directory, or the kernel's if nothing was running.		*/
+/* Inputs: saved_pid - curr_pid when the test started			*/
+/* Outputs: none												*/
+/* Side Effects: Loads CR3 and sets curr_pid					*/
+static void test_restore_address_space( int32_t saved_pid )
+{
+	uint32_t directory = (uint32_t)page_directory;
+
+	if( saved_pid < 0 )
+	{
+		loadPageDirectory( (unsigned int*)directory );
+	}
+	else
+	{
+		map_prog_to_page( saved_pid );
+	}
+	curr_pid = saved_pid;
+}
+
+/* demand_paging_test											*/
+/* Points the user page at an empty page table for a new PID		*/
+/* backed by "shell", then touches the first page of the image	*/
+/* and the page holding the user stack. The first should be		*/
+/* read in from the file system, the second zero filled.		*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: Takes a PID for the test and gives it back,	*/
+/* and switches back to the caller's page directory.			*/
+int demand_paging_test( void )
+{
+	TEST_HEADER;
+	int32_t saved_pid = curr_pid;
+	int32_t test_pid;
+	pcb_t* test_pcb;
+	dentry_t test_dentry;
+	uint8_t header[ 4 ];
+	volatile uint8_t* image = (volatile uint8_t*)PROG_IMG_START;
+	volatile uint8_t* stack = (volatile uint8_t*)BOTTOM;
+	frame_stats_t before, after;
+	int result = PASS;
+
+	if( read_dentry_by_name( (const uint8_t*)"shell", &test_dentry ) == FAILURE )
+	{
+		return FAIL;
+	}
+	read_data( test_dentry.index_node_num, 0, header, sizeof( header ) );
+
+	test_pid = pid_alloc( );
+	if( test_pid < 0 )
+	{
+		return FAIL;
+	}
+	test_pcb = get_pcb( test_pid );
+	curr_pid = test_pid;
+	test_pcb->exec_inode = test_dentry.index_node_num;
+	test_pcb->exec_size = get_file_size( test_dentry.index_node_num );
+	test_pcb->pages_loaded = 0;
+	user_page_table_reset( test_pid );
+	process_page_directory_init( test_pid );
+	map_prog_to_page( test_pid );
+	exec_cache_reclaim( );
+	frame_get_stats( &before );
+
+	/* Nothing is loaded until the program image is touched 		*/
+	if( proc_user_page_table( test_pid )[ ( PROG_IMG_START - USER_START_ADDR ) / FOUR_KB ].present )
+	{
+		result = FAIL;
+	}
+	if( image[ 0 ] != header[ 0 ] || image[ 1 ] != header[ 1 ] ||
+		image[ 2 ] != header[ 2 ] || image[ 3 ] != header[ 3 ] ||
+		test_pcb->pages_loaded != 1 )
+	{
+		result = FAIL;
+	}
+	if( stack[ 0 ] != 0 || test_pcb->pages_loaded != 2 )
+	{
+		result = FAIL;
+	}
+
+	/* Both pages came from the frame allocator and go back to it,	*/
+	/* the image page once the exec cache lets go of it				*/
+	frame_get_stats( &after );
+	if( after.free_frames != before.free_frames - 2 )
+	{
+		result = FAIL;
+	}
+	user_page_table_reset( test_pid );
+	frame_get_stats( &after );
+	if( after.free_frames != before.free_frames - 1 )
+	{
+		result = FAIL;
+	}
+	exec_cache_reclaim( );
+	frame_get_stats( &after );
+	if( after.free_frames != before.free_frames )
+	{
+		result = FAIL;
+	}
+
+	/* The kernel's page directory never maps the user page */
+	if( page_directory[ USER_PAGE ].present ||
+		!proc_page_directory( test_pid )[ 1 ].global )
+	{
+		result = FAIL;
+	}
+
+	test_restore_address_space( saved_pid );
+	pid_free( test_pid );
+	return result;
+}
+
+/* exec_cache_test												*/
+/* Runs "shell" in two new PIDs and touches the first page of	*/
+/* the image in both. They should share one read-only frame	*/
+/* from the exec cache. A write in the second should give it	*/
+/* its own copy without the first seeing the write.			*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: Takes two PIDs for the test and gives them	*/
+/* back, and switches back to the caller's page directory.		*/
+int exec_cache_test( void )
+{
+	TEST_HEADER;
+	int32_t saved_pid = curr_pid;
+	int32_t pids[ 2 ];
+	uint32_t frames[ 2 ];
+	page_table_entry_t* pte;
+	dentry_t test_dentry;
+	uint8_t header[ 2 ];
+	volatile uint8_t* image = (volatile uint8_t*)PROG_IMG_START;
+	frame_stats_t before, after;
+	exec_cache_stats_t cache_before, cache_after;
+	int i;
+	int result = PASS;
+
+	if( read_dentry_by_name( (const uint8_t*)"shell", &test_dentry ) == FAILURE )
+	{
+		return FAIL;
+	}
+	read_data( test_dentry.index_node_num, 0, header, sizeof( header ) );
+
+	pids[ 0 ] = pid_alloc( );
+	pids[ 1 ] = pid_alloc( );
+	if( pids[ 0 ] < 0 || pids[ 1 ] < 0 )
+	{
+		pid_free( pids[ 0 ] );
+		return FAIL;
+	}
+	exec_cache_reclaim( );
+	frame_get_stats( &before );
+	exec_cache_get_stats( &cache_before );
+
+	for( i = 0; i < 2; i++ )
+	{
+		get_pcb( pids[ i ] )->exec_inode = test_dentry.index_node_num;
+		get_pcb( pids[ i ] )->exec_size = get_file_size( test_dentry.index_node_num );
+		get_pcb( pids[ i ] )->pages_copied = 0;
+		user_page_table_reset( pids[ i ] );
+		process_page_directory_init( pids[ i ] );
+
+		curr_pid = pids[ i ];
+		map_prog_to_page( pids[ i ] );
+		if( image[ 0 ] != header[ 0 ] )
+		{
+			result = FAIL;
+		}
+		pte = &proc_user_page_table( pids[ i ] )[ ( PROG_IMG_START - USER_START_ADDR ) / FOUR_KB ];
+		frames[ i ] = pte->virtual_address;
+		if( pte->read_write || !( pte->available_3 & PTE_AVL_COW ) )
+		{
+			result = FAIL;
+		}
+	}
+
+	/* One frame, read once, held by the cache and both processes	*/
+	exec_cache_get_stats( &cache_after );
+	if( frames[ 0 ] != frames[ 1 ] ||
+		frame_refcount( frames[ 0 ] << SHIFT_12_VIRTUAL_ADDR ) != 3 ||
+		cache_after.misses != cache_before.misses + 1 ||
+		cache_after.hits != cache_before.hits + 1 )
+	{
+		result = FAIL;
+	}
+
+	/* The second process writes and gets its own copy				*/
+	image[ 0 ] = header[ 0 ] + 1;
+	pte = &proc_user_page_table( pids[ 1 ] )[ ( PROG_IMG_START - USER_START_ADDR ) / FOUR_KB ];
+	if( pte->virtual_address == frames[ 0 ] || !pte->read_write ||
+		get_pcb( pids[ 1 ] )->pages_copied != 1 ||
+		image[ 0 ] != (uint8_t)( header[ 0 ] + 1 ) || image[ 1 ] != header[ 1 ] ||
+		frame_refcount( frames[ 0 ] << SHIFT_12_VIRTUAL_ADDR ) != 2 )
+	{
+		result = FAIL;
+	}
+
+	/* The first still sees the program as it is on disk			*/
+	curr_pid = pids[ 0 ];
+	map_prog_to_page( pids[ 0 ] );
+	if( image[ 0 ] != header[ 0 ] )
+	{
+		result = FAIL;
+	}
+
+	test_restore_address_space( saved_pid );
+
+	for( i = 0; i < 2; i++ )
+	{
+		user_page_table_reset( pids[ i ] );
+		pid_free( pids[ i ] );
+	}
+	exec_cache_reclaim( );
+	frame_get_stats( &after );
+	if( after.free_frames != before.free_frames )
+	{
+		result = FAIL;
+	}
+	return result;
+}
+
+/* fork_cow_test												*/
+/* Gives a spare PID a stack page and shares its user page	*/
+/* with a second PID the way fork does. Both should map the	*/
+/* same read-only frame. A write in the child should give it	*/
+/* its own copy without the parent seeing it, and the parent's	*/
+/* next write should only make its page writable again, since	*/
+/* nobody else uses the frame by then.							*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: Takes two PIDs for the test and gives them	*/
+/* back, and switches back to the caller's page directory.		*/
+int fork_cow_test( void )
+{
+	TEST_HEADER;
+	int32_t saved_pid = curr_pid;
+	int32_t parent;
+	int32_t child;
+	page_table_entry_t* parent_pte;
+	page_table_entry_t* child_pte;
+	volatile uint32_t* stack = (volatile uint32_t*)BOTTOM;
+	uint32_t frame;
+	frame_stats_t before, after;
+	int result = PASS;
+
+	parent = pid_alloc( );
+	child = pid_alloc( );
+	if( parent < 0 || child < 0 )
+	{
+		pid_free( parent );
+		return FAIL;
+	}
+	frame_get_stats( &before );
+
+	/* No program image, so every page is zero-filled				*/
+	get_pcb( parent )->exec_size = 0;
+	get_pcb( parent )->pages_copied = 0;
+	get_pcb( child )->exec_size = 0;
+	get_pcb( child )->pages_copied = 0;
+	user_page_table_reset( parent );
+	user_page_table_reset( child );
+	process_page_directory_init( parent );
+	process_page_directory_init( child );
+	parent_pte = &proc_user_page_table( parent )[ ( BOTTOM - USER_START_ADDR ) / FOUR_KB ];
+	child_pte = &proc_user_page_table( child )[ ( BOTTOM - USER_START_ADDR ) / FOUR_KB ];
+
+	curr_pid = parent;
+	map_prog_to_page( parent );
+	stack[ 0 ] = 1;
+
+	/* Both map the parent's frame read-only						*/
+	user_page_table_share( parent, child );
+	map_prog_to_page( parent );
+	frame = parent_pte->virtual_address;
+	if( child_pte->virtual_address != frame ||
+		parent_pte->read_write || !( parent_pte->available_3 & PTE_AVL_COW ) ||
+		child_pte->read_write || !( child_pte->available_3 & PTE_AVL_COW ) ||
+		frame_refcount( frame << SHIFT_12_VIRTUAL_ADDR ) != 2 )
+	{
+		result = FAIL;
+	}
+
+	/* The child writes and gets its own copy						*/
+	curr_pid = child;
+	map_prog_to_page( child );
+	if( stack[ 0 ] != 1 )
+	{
+		result = FAIL;
+	}
+	stack[ 0 ] = 2;
+	if( child_pte->virtual_address == frame || !child_pte->read_write ||
+		get_pcb( child )->pages_copied != 1 || stack[ 0 ] != 2 ||
+		frame_refcount( frame << SHIFT_12_VIRTUAL_ADDR ) != 1 )
+	{
+		result = FAIL;
+	}
+
+	/* The parent doesn't see it, and its write copies nothing		*/
+	curr_pid = parent;
+	map_prog_to_page( parent );
+	if( stack[ 0 ] != 1 )
+	{
+		result = FAIL;
+	}
+	stack[ 0 ] = 3;
+	if( parent_pte->virtual_address != frame || !parent_pte->read_write ||
+		( parent_pte->available_3 & PTE_AVL_COW ) ||
+		get_pcb( parent )->pages_copied != 0 )
+	{
+		result = FAIL;
+	}
+
+	test_restore_address_space( saved_pid );
+
+	user_page_table_reset( parent );
+	user_page_table_reset( child );
+	pid_free( parent );
+	pid_free( child );
+	frame_get_stats( &after );
+	if( after.free_frames != before.free_frames )
+	{
+		result = FAIL;
+	}
+	return result;
+}
+
+/* sched_nice_test												*/
+/* Nices a spare PCB past both ends of the range and checks	*/
+/* the value is clamped, that the process' level never sits	*/
+/* above its nice value, and that waking it returns it to its	*/
+/* top level.													*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: Takes a PID for the test and gives it back	*/
+int sched_nice_test( void )
+{
+	TEST_HEADER;
+
+	int32_t pid = pid_alloc( );
+	pcb_t* pcb;
+	int result = PASS;
+
+	if( pid < 0 )
+	{
+		return FAIL;
+	}
+	pcb = get_pcb( pid );
+	pcb->nice = 0;
+	pcb->sched_level = 0;
+	pcb->sched_state = SCHED_RUNNING;
+
+	if( scheduler_nice( pid, SCHED_LEVELS + 5 ) != SCHED_LEVELS - 1 ||
+		pcb->sched_level != SCHED_LEVELS - 1 )
+	{
+		result = FAIL;
+	}
+	if( scheduler_nice( pid, -( SCHED_LEVELS + 5 ) ) != 0 ||
+		pcb->sched_level != SCHED_LEVELS - 1 )
+	{
+		result = FAIL;
+	}
+
+	/* Waking only does anything to a sleeping process */
+	scheduler_wake( pid );
+	if( pcb->sched_level != SCHED_LEVELS - 1 )
+	{
+		result = FAIL;
+	}
+
+	/* Pretend it is the running process so the wake doesn't queue it */
+	pcb->sched_state = SCHED_SLEEPING;
+	curr_pid = pid;
+	scheduler_wake( pid );
+	curr_pid = -1;
+	if( pcb->sched_level != 0 || pcb->sched_state != SCHED_RUNNING )
+	{
+		result = FAIL;
+	}
+
+	pid_free( pid );
+	return result;
+}
+
+/* pit_cmdline_test												*/
+/* Parses a few command lines and checks the tick rate is		*/
+/* picked up and clamped, and that "notickless" only matches	*/
+/* the whole word.												*/
+/* Inputs: none. 												*/
+/* Outputs: PASS/FAIL											*/
+/* Side Effects: None, restores the timer options afterwards	*/
+int pit_cmdline_test( void )
+{
+	TEST_HEADER;
+
+	uint32_t saved_hz = pit_hz;
+	uint32_t saved_tickless = tickless_enabled;
+	int result = PASS;
+
+	tickless_enabled = 1;
+	PIT_parse_cmdline( (int8_t*)"root=hd0 hz=1000 noticklessly" );
+	if( pit_hz != 1000 || tickless_enabled != 1 )
+	{
+		result = FAIL;
+	}
+	PIT_parse_cmdline( (int8_t*)"hz=1  notickless" );
+	if( pit_hz != PIT_MIN_HZ || tickless_enabled != 0 )
+	{
+		result = FAIL;
+	}
+	PIT_parse_cmdline( (int8_t*)"hz=99999" );
+	if( pit_hz != PIT_MAX_HZ )
+	{
+		result = FAIL;
+	}
+
+	pit_hz = saved_hz;
+	tickless_enabled = saved_tickless;
+	return result;
+}
+
 /* Checkpoint 4 tests */
 /* Checkpoint 5 tests */
@@ -129,6 +129,54 @@ int fs_read_val_index_test( void );
 /* Tests read_dentry_by_index for an invalid index */
 int fs_read_inval_index_test( void );
 
+/* Tests that every file name resolves through the dentry hash index */
+int fs_dentry_index_test( void );
+
+/* Tests that each file type has its own fops table */
+int fops_table_test( void );
+
+/* Checks that output to a background terminal goes to its saved page */
+int background_output_test( void );
+
+/* Checks terminal output reaches the screen only when flushed */
+int shadow_flush_test( void );
+
+/* Checks a bulk write scrolls by the right number of lines at once */
+int terminal_puts_test( void );
+
+/* Checks scrolling the displayed terminal moves the VGA start address */
+int hw_scroll_test( void );
+
+/* Checks scrolled-off rows land in the scrollback and can be viewed */
+int scrollback_test( void );
+
+/* Checks the keyboard input ring and the terminal's raw mode */
+int input_ring_test( void );
+
+/* Checks the serial device opens by name and can be written */
+int serial_test( void );
+
+/* Checks a kernel log line can be read back with its timestamp */
+int klog_test( void );
+
+/* Checks the vidmap page follows a terminal between the screen and its backing page */
+int vidmap_remap_test( void );
+
+/* Checks ktime_ns against the RTC and the divide helper it relies on */
+int ktime_test( void );
+
+/* Checks the read-only time page mapping and its RTC counter */
+int time_page_test( void );
+
+/* Checks two open rtc files tick at their own rates */
+int rtc_virtual_test( void );
+
+/* Checks the buddy allocator aligns, splits and merges blocks */
+int frame_alloc_test( void );
+
+/* Checks PIDs come out lowest first and their PCBs are pooled */
+int pid_alloc_test( void );
+
 /* Prints out the contents of "frame0.txt" */
 /* Tests file_open, file_close, file_read, and file_write */
 int fs_print_small_file( void );
@@ -141,6 +189,9 @@ int fs_print_executable_file( void );
 /* Tests file_open, file_close, file_read, and file_write */
 int fs_print_large_file( void );
 
+/* Checks read_data at offsets that straddle data block boundaries */
+int fs_read_data_seek_test( void );
+
 /* Tests change frequency function of RTC with different inputs */
 int rtc_frequency_change_test( void );
 
@@ -183,7 +234,25 @@ int rtc_close_test( void );
 /* then tests read                                              */
 int rtc_read_write_test( void );
 
+/* Tests that rtc_read sleeps on the RTC wait queue */
+int rtc_wait_queue_test( void );
+
 void syscall_call_test( void );
 
+/* Checks that user pages are filled in on first touch */
+int demand_paging_test( void );
+
+/* Checks two processes share a program page until one writes it */
+int exec_cache_test( void );
+
+/* Checks a forked address space is shared until either side writes */
+int fork_cow_test( void );
+
+/* Checks nice clamping and the wakeup boost of the scheduler */
+int sched_nice_test( void );
+
+/* Checks the timer options read off the multiboot command line */
+int pit_cmdline_test( void );
+
 
 #endif /* _TESTS_H */
@@ -0,0 +1,106 @@
+/* wait_queue.c - Sleeping on an event until an interrupt handler wakes us
+ * vim:ts=4 noexpandtab
+ */
+
+#include "wait_queue.h"
+#include "scheduling.h"
+#include "syscall.h"
+
+/* void wait_queue_init( wait_queue_t* queue, const char* name );
+ *   Inputs: wait_queue_t* queue --> Queue to set up
+ *           const char* name --> Name printed with the queue's stats
+ *   Return Value: none
+ *   Function: Clears the queue and its counters */
+void wait_queue_init( wait_queue_t* queue, const char* name )
+{
+    memset( queue, 0, sizeof( wait_queue_t ) );
+    queue->name = name;
+}
+
+/* void wait_queue_sleep( wait_queue_t* queue );
+ *   Inputs: wait_queue_t* queue --> Queue to sleep on
+ *   Return Value: none
+ *   Function: Sleeps until the next wake_up on the queue. Must be called
+ *             with interrupts off, and returns with them off again. While
+ *             asleep the other processes get the CPU, and if none of them
+ *             has anything to do the CPU halts in scheduler_idle instead of
+ *             spinning. That halt can't miss a wake_up, since interrupts
+ *             only come back on once hlt has started. */
+void wait_queue_sleep( wait_queue_t* queue )
+{
+    uint32_t generation = queue->generation;
+    uint32_t latency;
+
+    queue->waiters++;
+    queue->sleeps++;
+
+    while( queue->generation == generation )
+    {
+        /* Let wake_up know which process to make runnable */
+        if( curr_pid >= 0 )
+        {
+            queue->sleeper_pids[ curr_pid / PID_MAP_BITS ] |= 1 << ( curr_pid % PID_MAP_BITS );
+        }
+        if( !scheduler_yield( ) )
+        {
+            scheduler_idle( );
+        }
+    }
+
+    queue->waiters--;
+
+    /* How long it took from the interrupt waking us to running again */
+    latency = (uint32_t)( rdtsc( ) - queue->wake_tsc );
+    queue->last_latency = latency;
+    queue->total_latency += latency;
+    if( latency > queue->max_latency )
+    {
+        queue->max_latency = latency;
+    }
+}
+
+/* void wake_up( wait_queue_t* queue );
+ *   Inputs: wait_queue_t* queue --> Queue to wake
+ *   Return Value: none
+ *   Function: Wakes every sleeper on the queue and makes their processes
+ *             runnable. Does nothing if nothing is asleep, so wakeups aren't
+ *             saved up for later sleepers. Interrupt handlers should call
+ *             scheduler_preempt after their EOI so a woken process gets the
+ *             CPU right away. */
+void wake_up( wait_queue_t* queue )
+{
+    uint32_t word;
+    uint32_t bit;
+
+    if( queue->waiters == 0 )
+    {
+        return;
+    }
+
+    queue->wake_tsc = rdtsc( );
+    queue->wakeups++;
+    queue->generation++;
+
+    /* Hand the sleepers back to the scheduler */
+    for( word = 0; word < PID_MAP_WORDS; word++ )
+    {
+        while( queue->sleeper_pids[ word ] )
+        {
+            bit = pid_map_ffs( queue->sleeper_pids[ word ] );
+            queue->sleeper_pids[ word ] &= ~( 1 << bit );
+            scheduler_wake( word * PID_MAP_BITS + bit );
+        }
+    }
+}
+
+/* void wait_queue_print_stats( wait_queue_t* queue );
+ *   Inputs: wait_queue_t* queue --> Queue to print
+ *   Return Value: none
+ *   Function: Prints how often the queue was slept on and woken, and the
+ *             last and worst wake latency in cycles */
+void wait_queue_print_stats( wait_queue_t* queue )
+{
+    printf( "%s: sleeps %d, wakeups %d, last %d cycles, max %d cycles\n",
+            queue->name, queue->sleeps, queue->wakeups,
+            queue->last_latency, queue->max_latency );
+}
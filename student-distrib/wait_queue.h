@@ -0,0 +1,51 @@
+#ifndef _WAIT_QUEUE_H
+#define _WAIT_QUEUE_H
+
+#include "types.h"
+#include "lib.h"
+#include "process.h"
+
+/* A wait queue lets kernel code sleep until an interrupt handler   */
+/* tells it something happened, instead of spinning on a flag. The  */
+/* sleeper checks its condition with interrupts off, so a wake_up   */
+/* from an IRQ can't slip in between the check and going to sleep.  */
+typedef struct wait_queue_t {
+    const char*       name;           /* Shown when printing stats                   */
+    volatile uint32_t generation;     /* Bumped by every wake_up that had a sleeper  */
+    volatile uint32_t waiters;        /* Number of sleepers on the queue right now   */
+    volatile uint32_t sleeper_pids[ PID_MAP_WORDS ]; /* Bit per PID asleep here  */
+    uint32_t          sleeps;         /* Times something went to sleep on the queue  */
+    uint32_t          wakeups;        /* wake_up calls that found a sleeper          */
+    uint64_t          wake_tsc;       /* Time stamp of the last wake_up              */
+    uint32_t          last_latency;   /* Cycles from wake_up until the sleeper ran   */
+    uint32_t          max_latency;    /* Largest wake latency seen                   */
+    uint64_t          total_latency;  /* Sum of wake latencies, for averaging        */
+} wait_queue_t;
+
+/* Sets up an empty wait queue */
+extern void wait_queue_init( wait_queue_t* queue, const char* name );
+
+/* Sleeps until the next wake_up. Interrupts must already be off. */
+extern void wait_queue_sleep( wait_queue_t* queue );
+
+/* Wakes everything sleeping on the queue. Safe to call from an IRQ. */
+extern void wake_up( wait_queue_t* queue );
+
+/* Prints the sleep/wake counters of a queue */
+extern void wait_queue_print_stats( wait_queue_t* queue );
+
+/* Sleeps on QUEUE until CONDITION is true. CONDITION is only ever  */
+/* checked with interrupts off, and interrupts are put back the way */
+/* they were afterwards.                                            */
+#define wait_event( queue, condition )          \
+do {                                            \
+    uint32_t _wait_flags;                       \
+    cli_and_save( _wait_flags );                \
+    while( !( condition ) )                     \
+    {                                           \
+        wait_queue_sleep( queue );              \
+    }                                           \
+    restore_flags( _wait_flags );               \
+} while (0)
+
+#endif /* _WAIT_QUEUE_H */
@@ -0,0 +1,150 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 64
+#define ROUNDS 32
+#define WORKERS 8
+#define SPIN 100000
+
+/*
+ * Checks fork and wait, and times them against execute.
+ *
+ *   forktest         runs every check, then the timings
+ *   forktest leaf    exits right away; what execute is timed with
+ *
+ * The checks are that a child sees the memory its parent had when it
+ * forked, that writes by either one stay private, that WORKERS children
+ * run at once and each status comes back from wait, and that wait fails
+ * once there are no children left. The timings are ROUNDS fork/wait
+ * round trips of a child that halts right away, and ROUNDS execute/halt
+ * round trips of a leaf.
+ */
+
+static volatile uint32_t shared = 1;
+static uint8_t big[4 * 4096];
+
+static void report (const char* name, uint32_t value, const char* units)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_itoa (value, buf, 10);
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)units);
+}
+
+static int32_t check_private (void)
+{
+    volatile uint32_t on_stack = 2;
+    int32_t pid, status;
+    uint32_t i;
+
+    for (i = 0; i < sizeof (big); i++)
+        big[i] = i;
+
+    pid = ece391_fork ();
+    if (pid < 0) {
+        ece391_fdputs (1, (uint8_t*)"fork failed\n");
+        return -1;
+    }
+    if (pid == 0) {
+        /* What the parent had, then our own copy */
+        if (shared != 1 || on_stack != 2 || big[sizeof (big) - 1] != (uint8_t)(sizeof (big) - 1))
+            ece391_halt (1);
+        shared = 10;
+        on_stack = 20;
+        big[0] = 0xFF;
+        if (shared != 10 || on_stack != 20)
+            ece391_halt (2);
+        ece391_halt (0);
+    }
+
+    /* The child's writes must not show up here */
+    if (pid != ece391_wait (&status) || status != 0) {
+        report ("child didn't see our memory, status ", status, "\n");
+        return -1;
+    }
+    if (shared != 1 || on_stack != 2 || big[0] != 0) {
+        ece391_fdputs (1, (uint8_t*)"child's writes showed up in the parent\n");
+        return -1;
+    }
+    ece391_fdputs (1, (uint8_t*)"private copies: ok\n");
+    return 0;
+}
+
+static int32_t check_workers (void)
+{
+    int32_t pid, status;
+    uint32_t seen = 0;
+    uint32_t i, j;
+
+    for (i = 0; i < WORKERS; i++) {
+        pid = ece391_fork ();
+        if (pid < 0) {
+            report ("fork failed after ", i, " workers\n");
+            return -1;
+        }
+        if (pid == 0) {
+            /* Worker i spins a while, so they all overlap */
+            for (j = 0; j < SPIN; j++)
+                shared += j;
+            ece391_halt (i);
+        }
+    }
+
+    for (i = 0; i < WORKERS; i++) {
+        pid = ece391_wait (&status);
+        if (pid < 0 || status < 0 || status >= WORKERS || (seen & (1 << status))) {
+            report ("bad wait for worker ", i, "\n");
+            return -1;
+        }
+        seen |= 1 << status;
+    }
+
+    if (-1 != ece391_wait (&status)) {
+        ece391_fdputs (1, (uint8_t*)"wait didn't fail with no children\n");
+        return -1;
+    }
+    report ("", WORKERS, " workers: ok\n");
+    return 0;
+}
+
+static void time_fork (void)
+{
+    uint32_t start, elapsed, i;
+    int32_t status;
+
+    start = ece391_time_us ();
+    for (i = 0; i < ROUNDS; i++) {
+        if (0 == ece391_fork ())
+            ece391_halt (0);
+        ece391_wait (&status);
+    }
+    elapsed = ece391_time_us () - start;
+    report ("fork+wait: ", elapsed / ROUNDS, " us\n");
+
+    start = ece391_time_us ();
+    for (i = 0; i < ROUNDS; i++)
+        ece391_execute ((uint8_t*)"forktest leaf");
+    elapsed = ece391_time_us () - start;
+    report ("execute+halt: ", elapsed / ROUNDS, " us\n");
+}
+
+int main ()
+{
+    uint8_t args[BUFSIZE];
+
+    if (0 != ece391_getargs (args, BUFSIZE))
+        args[0] = '\0';
+
+    if (0 == ece391_strcmp (args, (uint8_t*)"leaf"))
+        return 0;
+
+    if (0 != check_private () || 0 != check_workers ())
+        return 1;
+
+    time_fork ();
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 64
+#define RTC_FREQ 256
+#define SAMPLES 128
+#define SPIN_US 5000000
+#define MAX_NICE 3
+
+/*
+ * Measures how quickly a process that sleeps on input gets the CPU back
+ * while other terminals are busy. Typed keys can't be scripted, so this
+ * uses RTC interrupts instead; they wake readers through the same wait
+ * queues and scheduler boost as a line typed at the terminal.
+ *
+ *   latbench spin   burns CPU for a while, to load another terminal
+ *   latbench        times RTC_FREQ Hz reads and prints the gaps between them
+ *   latbench nice   the same, after dropping to the lowest priority
+ *
+ * With nothing else running, every gap is one RTC period. Under load, a
+ * gap longer than that is time the reader spent waiting for the CPU.
+ */
+
+static void report (const char* name, uint32_t value)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_itoa (value, buf, 10);
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+/* Spins for SPIN_US microseconds */
+static void spin ()
+{
+    uint32_t start = ece391_time_us ();
+
+    while (ece391_time_us () - start < SPIN_US)
+        ;
+}
+
+int main ()
+{
+    uint8_t args[BUFSIZE];
+    int32_t rtc_fd, freq = RTC_FREQ, garbage;
+    uint32_t i, prev, now, gap, min_gap, max_gap, total;
+
+    if (0 != ece391_getargs (args, BUFSIZE))
+        args[0] = '\0';
+
+    if (0 == ece391_strcmp (args, (uint8_t*)"spin")) {
+        ece391_fdputs (1, (uint8_t*)"spinning...\n");
+        spin ();
+        ece391_fdputs (1, (uint8_t*)"done\n");
+        return 0;
+    }
+    if (0 == ece391_strcmp (args, (uint8_t*)"nice"))
+        ece391_nice (MAX_NICE);
+
+    if (-1 == (rtc_fd = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"can't open rtc\n");
+        return 3;
+    }
+    ece391_write (rtc_fd, &freq, 4);
+
+    /* Line up with an interrupt before timing */
+    ece391_read (rtc_fd, &garbage, 4);
+    prev = ece391_time_us ();
+    min_gap = 0xFFFFFFFF;
+    max_gap = 0;
+    total = 0;
+    for (i = 0; i < SAMPLES; i++) {
+        ece391_read (rtc_fd, &garbage, 4);
+        now = ece391_time_us ();
+        gap = now - prev;
+        prev = now;
+        total += gap;
+        if (gap < min_gap)
+            min_gap = gap;
+        if (gap > max_gap)
+            max_gap = gap;
+    }
+    ece391_close (rtc_fd);
+
+    report ("nice:            ", ece391_nice (0));
+    report ("min gap (us):    ", min_gap);
+    report ("avg gap (us):    ", total / SAMPLES);
+    report ("max gap (us):    ", max_gap);
+    report ("worst wait (us): ", max_gap - min_gap);
+
+    return 0;
+}
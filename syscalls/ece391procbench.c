@@ -0,0 +1,90 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 64
+#define ROUNDS 32
+#define MAX_DEPTH 250
+
+/*
+ * Piles up processes the way a fork bomb would, and times how quickly
+ * processes start and exit as the pile grows. Each level executes the
+ * next one and waits for it, so the pile is one chain of processes;
+ * forktest times fork and wait.
+ *
+ *   procbench        starts the pile at depth 1
+ *   procbench N      one level of the pile, N processes deep
+ *   procbench leaf   exits right away; what each level times
+ *
+ * Every level times ROUNDS execute/halt round trips of a leaf, printing
+ * the average at each power of two, then executes the next level. The
+ * pile stops at MAX_DEPTH, or when the kernel runs out of PIDs or
+ * memory, and the deepest level reached is printed at the top.
+ */
+
+static void report (const char* name, uint32_t value, const char* units)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_itoa (value, buf, 10);
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)units);
+}
+
+static uint32_t parse_depth (const uint8_t* s)
+{
+    uint32_t depth = 0;
+
+    for (; *s >= '0' && *s <= '9'; s++)
+        depth = depth * 10 + (*s - '0');
+    return depth;
+}
+
+int main ()
+{
+    uint8_t args[BUFSIZE];
+    uint8_t next[BUFSIZE];
+    uint32_t depth, start, elapsed, i;
+    int32_t deepest;
+
+    if (0 != ece391_getargs (args, BUFSIZE))
+        args[0] = '\0';
+
+    if (0 == ece391_strcmp (args, (uint8_t*)"leaf"))
+        return 0;
+
+    depth = parse_depth (args);
+    if (depth == 0)
+        depth = 1;
+
+    start = ece391_time_us ();
+    for (i = 0; i < ROUNDS; i++) {
+        if (0 != ece391_execute ((uint8_t*)"procbench leaf")) {
+            report ("can't execute a leaf at depth ", depth, "\n");
+            return depth - 1;
+        }
+    }
+    elapsed = ece391_time_us () - start;
+
+    if (0 == (depth & (depth - 1))) {
+        report ("depth ", depth, ": ");
+        report ("", elapsed / ROUNDS, " us per execute+halt\n");
+    }
+
+    /* Go one level deeper. A level that can't start leaves us deepest. */
+    deepest = depth;
+    if (depth < MAX_DEPTH) {
+        ece391_strcpy (next, (uint8_t*)"procbench ");
+        ece391_itoa (depth + 1, next + ece391_strlen (next), 10);
+        deepest = ece391_execute (next);
+        if (deepest <= 0 || deepest > MAX_DEPTH)
+            deepest = depth;
+    }
+
+    if (depth == 1)
+        report ("deepest: ", deepest, " processes\n");
+
+    return deepest;
+}
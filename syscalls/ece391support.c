@@ -3,6 +3,10 @@
 #include "ece391support.h"
 #include "ece391syscall.h"
 
+/* ece391syscall.S finds the sysenter flag by its offset */
+typedef char ece391_time_page_sysenter_check[
+    __builtin_offsetof(ece391_time_page_t, sysenter) == ECE391_TIME_PAGE_SYSENTER ? 1 : -1];
+
 uint32_t ece391_strlen(const uint8_t* s)
 {
     uint32_t len;
@@ -102,3 +106,52 @@ uint8_t* ece391_strrev(uint8_t* s)
    return s;
 }
 
+
+/*
+ * Nanoseconds since boot, read from the time page without entering the
+ * kernel. Scales the TSC the same way the kernel's ktime_ns does, or
+ * counts scheduler ticks if the TSC wasn't calibrated. ece391_gettime
+ * gives the same answer through a system call.
+ */
+uint64_t ece391_time_ns(void)
+{
+    const ece391_time_page_t* tp = ece391_time_page;
+    uint32_t lo, hi;
+    uint64_t cycles;
+
+    if (0 == tp->tsc_khz)
+        return (uint64_t)tp->pit_ticks * (1000000000 / tp->pit_hz);
+
+    asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    cycles = (((uint64_t)hi << 32) | lo) -
+             (((uint64_t)tp->tsc_boot_hi << 32) | tp->tsc_boot_lo);
+    return (((uint64_t)(uint32_t)(cycles >> 32) * tp->tsc_mult) << (32 - tp->tsc_shift)) +
+           (((uint64_t)(uint32_t)cycles * tp->tsc_mult) >> tp->tsc_shift);
+}
+
+/* Scheduler ticks since boot, from the time page */
+uint32_t ece391_ticks(void)
+{
+    return ece391_time_page->pit_ticks;
+}
+
+/* RTC interrupts since boot, from the time page */
+uint32_t ece391_rtc_ticks(void)
+{
+    return ece391_time_page->rtc_ticks;
+}
+
+/*
+ * Microseconds since boot. Wraps after about 71 minutes, which is fine
+ * for timing things by subtracting two readings. There is no libgcc to
+ * do 64-bit division, so divide the two halves with divl ourselves.
+ */
+uint32_t ece391_time_us(void)
+{
+    uint64_t ns = ece391_time_ns ();
+    uint32_t hi = (uint32_t)(ns >> 32), lo = (uint32_t)ns, rem, us;
+
+    rem = hi % 1000;
+    asm ("divl %2" : "=a" (us), "+d" (rem) : "rm" (1000), "a" (lo));
+    return us;
+}
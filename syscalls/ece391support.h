@@ -1,6 +1,17 @@
 #if !defined(ECE391SUPPORT_H)
 #define ECE391SUPPORT_H
 
+/*
+ * Read-only page the kernel maps into every program and keeps up to
+ * date. Reading it costs no system call. The layout must match
+ * time_page_t in the kernel's ktime.h, and so must the field offsets
+ * below, which ece391syscall.S reads the page with.
+ */
+#define ECE391_TIME_PAGE 0x08801000
+#define ECE391_TIME_PAGE_SYSENTER 36    /* offset of sysenter */
+
+#if !defined(__ASSEMBLER__)
+
 extern uint32_t ece391_strlen(const uint8_t* s);
 extern void ece391_strcpy(uint8_t* dst, const uint8_t* src);
 extern void ece391_fdputs(int32_t fd, const uint8_t* s);
@@ -8,6 +19,28 @@ extern int32_t ece391_strcmp(const uint8_t* s1, const uint8_t* s2);
 extern int32_t ece391_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n);
 extern uint8_t *ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix);
 extern uint8_t *ece391_strrev(uint8_t* s);
+extern uint64_t ece391_time_ns(void);
+extern uint32_t ece391_time_us(void);
+
+typedef struct ece391_time_page_t {
+    volatile uint32_t pit_ticks;    /* scheduler ticks since boot */
+    volatile uint32_t pit_hz;
+    volatile uint32_t rtc_ticks;    /* RTC interrupts since boot */
+    volatile uint32_t rtc_hz;
+    uint32_t tsc_khz;               /* 0 if the TSC isn't usable */
+    uint32_t tsc_mult;              /* ns = cycles * tsc_mult >> tsc_shift */
+    uint32_t tsc_shift;
+    uint32_t tsc_boot_lo;
+    uint32_t tsc_boot_hi;
+    uint32_t sysenter;              /* 1 if the ece391_fast_ calls use SYSENTER */
+} ece391_time_page_t;
+
+#define ece391_time_page ((const ece391_time_page_t*)ECE391_TIME_PAGE)
+
+extern uint32_t ece391_ticks(void);
+extern uint32_t ece391_rtc_ticks(void);
+
+#endif /* !__ASSEMBLER__ */
 
 #endif /* ECE391SUPPORT_H */
 
@@ -0,0 +1,54 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 64
+#define ITERATIONS 10000
+
+/*
+ * Measures the round trip cost of a system call through INT $0x80 and
+ * through SYSENTER/SYSEXIT. Closing stdout is refused right after the
+ * kernel checks the descriptor, so the time is almost all entry and exit.
+ */
+
+static uint32_t rdtsc_low ()
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    return lo;
+}
+
+static void report (const char* name, uint32_t cycles)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_itoa (cycles / ITERATIONS, buf, 10);
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)" cycles per call\n");
+}
+
+int main ()
+{
+    uint32_t i, start, int80_cycles, sysenter_cycles;
+
+    /* Warm up both paths so neither pays for cold caches */
+    ece391_close (1);
+    ece391_fast_close (1);
+
+    start = rdtsc_low ();
+    for (i = 0; i < ITERATIONS; i++)
+        ece391_close (1);
+    int80_cycles = rdtsc_low () - start;
+
+    start = rdtsc_low ();
+    for (i = 0; i < ITERATIONS; i++)
+        ece391_fast_close (1);
+    sysenter_cycles = rdtsc_low () - start;
+
+    report ("int $0x80:         ", int80_cycles);
+    report ("sysenter/sysexit:  ", sysenter_cycles);
+
+    return 0;
+}
@@ -22,6 +22,67 @@ extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
 
+/*
+ * Adds increment to the caller's nice value and returns the new one.
+ * The nice value (0 to 3) is the highest scheduler priority level the
+ * process can reach, so a niced process never outranks a normal one
+ * that is waiting on input.
+ */
+extern int32_t ece391_nice (int32_t increment);
+
+/*
+ * Stores the time since boot in *ns, in nanoseconds. The clock never
+ * goes backwards; it counts TSC cycles when the kernel could calibrate
+ * the TSC and timer ticks otherwise.
+ */
+extern int32_t ece391_gettime (uint64_t* ns);
+
+/*
+ * Sends a control command to the driver behind fd. The terminal (fd 0
+ * or 1) takes the commands below. In raw mode, keys are read one byte
+ * each as they are pressed, without echo, and a read with nothing
+ * typed returns 0 instead of waiting. Keys typed before a read are
+ * kept in either mode. Halting puts the terminal back in canonical
+ * mode.
+ */
+#define TERM_IOCTL_GET_MODE 1
+#define TERM_IOCTL_SET_MODE 2
+#define TERM_IOCTL_FLUSH    3
+#define TERM_MODE_CANON     0
+#define TERM_MODE_RAW       1
+extern int32_t ece391_ioctl (int32_t fd, uint32_t cmd, uint32_t arg);
+
+/*
+ * Starts a copy of the caller, with the same memory and open files,
+ * that runs alongside it instead of in its place. Returns the child's
+ * PID to the parent and 0 to the child, or -1 if no PID was free. The
+ * memory is shared until one of them writes to it, so forking is cheap
+ * however big the program is. A forked child that halts is kept until
+ * its parent waits for it.
+ */
+extern int32_t ece391_fork (void);
+
+/*
+ * Waits for a forked child to halt and puts its status, as execute
+ * would have returned it, in *status unless status is NULL. Returns
+ * the child's PID, or -1 if the caller has no forked children.
+ */
+extern int32_t ece391_wait (int32_t* status);
+
+/*
+ * The same calls made with SYSENTER/SYSEXIT instead of INT $0x80.
+ * They skip the interrupt gate and IRET, so they are cheaper, but
+ * need a CPU with SYSENTER support.
+ */
+extern int32_t ece391_fast_halt (uint8_t status);
+extern int32_t ece391_fast_execute (const uint8_t* command);
+extern int32_t ece391_fast_read (int32_t fd, void* buf, int32_t nbytes);
+extern int32_t ece391_fast_write (int32_t fd, const void* buf, int32_t nbytes);
+extern int32_t ece391_fast_open (const uint8_t* filename);
+extern int32_t ece391_fast_close (int32_t fd);
+extern int32_t ece391_fast_getargs (uint8_t* buf, int32_t nbytes);
+extern int32_t ece391_fast_vidmap (uint8_t** screen_start);
+
 enum signums {
 	DIV_ZERO = 0,
 	SEGFAULT,
@@ -11,5 +11,10 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_NICE    11
+#define SYS_GETTIME 12
+#define SYS_IOCTL   13
+#define SYS_FORK    14
+#define SYS_WAIT    15
 
 #endif /* ECE391SYSNUM_H */